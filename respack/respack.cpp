@@ -0,0 +1,75 @@
+// respack: packs the resources under a directory into one archive the engine maps at startup in
+// place of the loose files, see VirtualFileSystem.
+//
+// usage: respack <directory> <archive>
+//   Shaders, images, transcoded .dds files and mesh files are packed. An image whose .dds is up
+//   to date and BC4 or BC5 is left out, those are core RGTC and the engine always loads the .dds.
+//   BC1, BC3 and BC7 need S3TC or BPTC, which not every driver has, so their source image is
+//   packed as well for the engine to fall back on.
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "DDSFile.h"
+#include "ResourceArchive.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	std::string lowerExtension(const fs::path& path)
+	{
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return extension;
+	}
+
+	bool isImage(const std::string& extension)
+	{
+		return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+	}
+
+	bool isResource(const fs::path& path)
+	{
+		std::string extension = lowerExtension(path);
+		if (extension == ".vs" || extension == ".fs" || extension == ".gs" || extension == ".glsl" || extension == ".dds" || extension == ".mesh")
+			return true;
+		if (!isImage(extension))
+			return false;
+
+		fs::path compressed = fs::path(path).replace_extension(".dds");
+		std::error_code error;
+		if (!fs::exists(compressed, error) || fs::last_write_time(compressed, error) < fs::last_write_time(path, error))
+			return true;
+
+		//Only drop the source when every GL 3.3 driver can upload the .dds
+		DDSImage image;
+		if (!LoadDDS(compressed.string(), image))
+			return true;
+		return image.format != BlockFormat::BC4 && image.format != BlockFormat::BC5;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		std::cout << "usage: respack <directory> <archive>" << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	if (!ResourceArchive::Write(argv[1], argv[2], isResource))
+		return 1;
+
+	ResourceArchive archive;
+	if (!archive.Open(argv[2]))
+		return 1;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << argv[1] << " -> " << argv[2] << ": " << archive.Count() << " files, " << archive.Mapping()->Size() / 1024
+		<< " KB in " << ms << " ms" << std::endl;
+	return 0;
+}
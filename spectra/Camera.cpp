@@ -53,16 +53,15 @@ void Camera::ProcessMouseScroll(float yoffset)
 		Zoom = 45.0f;
 }
 
-void Camera::UpdateCameraMatrix(Shader& shader)
+void Camera::UpdateCameraMatrix(FrameBlock& frame)
 {
-	//Update Model, view and projection here
-	// pass projection matrix to shader (note that in this case it could change every frame)
-	glm::mat4 projection = GetProjectionMatrix();
-	shader.setMat4("projection", projection);
+	//Update view and projection once per frame, every program reads them from the FrameData block
+	// projection matrix (note that in this case it could change every frame)
+	frame.projection = GetProjectionMatrix();
 
 	// camera/view transformation
-	glm::mat4 view = GetViewMatrix();
-	shader.setMat4("view", view);
+	frame.view = GetViewMatrix();
+	frame.viewPos = Position;
 }
 
 void Camera::SetScreenDimensions(unsigned int width, unsigned int height)
@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "Shader.h"
+#include "UniformBlocks.h"
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
 enum Camera_Movement {
@@ -75,7 +76,8 @@ class Camera
 		void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true);
 		void ProcessMouseScroll(float yoffset);
 
-		void UpdateCameraMatrix(Shader& shader);
+		// Writes view, projection and position into the per-frame uniform block
+		void UpdateCameraMatrix(FrameBlock& frame);
 		void SetScreenDimensions(unsigned int width, unsigned int height);
 
 		void FollowModel(glm::vec3& modPos, float dt);
@@ -0,0 +1,126 @@
+#include "CascadedShadowMap.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+CascadedShadowMap::CascadedShadowMap(GLsizei size, unsigned int count)
+	: Count(std::min(count, MAX_SHADOW_CASCADES)), Size(size)
+{
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; ++i)
+	{
+		Matrices[i] = glm::mat4(1.0f);
+		Splits[i] = 0.0f;
+		TexelSizes[i] = 0.0f;
+	}
+
+	//Only ever read through a comparison sampler, linear filtering makes each fetch 2x2 PCF
+	glGenTextures(1, &depthArray);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16, size, size, MAX_SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	//Outside a cascade counts as lit
+	float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CascadedShadowMap::Update(Camera& camera, const glm::vec3& lightDirection, float maxDistance, float lambda,
+	const glm::vec3& castersCenter, const glm::vec3& castersExtent)
+{
+	Count = std::min(std::max(Count, 1u), MAX_SHADOW_CASCADES);
+	float nearPlane = camera.NearPlane;
+	float farPlane = std::max(std::min(maxDistance, camera.FarPlane), nearPlane * 2.0f);
+	float aspect = (float)camera.Width / (float)camera.Height;
+	glm::mat4 view = camera.GetViewMatrix();
+
+	//Rotation only, the cascades are placed and snapped in this space
+	glm::vec3 direction = glm::normalize(lightDirection);
+	glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+	//The light looks down -z, the corner of the casters' box with the largest z is the closest to it
+	float castersTop = -FLT_MAX;
+	if (castersExtent.x >= 0.0f)
+	{
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			glm::vec3 sign((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+			glm::vec4 point = lightView * glm::vec4(castersCenter + sign * castersExtent, 1.0f);
+			castersTop = std::max(castersTop, point.z);
+		}
+	}
+
+	float sliceNear = nearPlane;
+	for (unsigned int i = 0; i < Count; ++i)
+	{
+		float ratio = (float)(i + 1) / (float)Count;
+		float logSplit = nearPlane * std::pow(farPlane / nearPlane, ratio);
+		float evenSplit = nearPlane + (farPlane - nearPlane) * ratio;
+		float sliceFar = lambda * logSplit + (1.0f - lambda) * evenSplit;
+
+		//The sphere around the slice turns with the camera without changing size, so the texel size stays put too
+		glm::mat4 toWorld = glm::inverse(glm::perspective(glm::radians(camera.Zoom), aspect, sliceNear, sliceFar) * view);
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			glm::vec4 point = toWorld * glm::vec4((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f, 1.0f);
+			corners[corner] = glm::vec3(point) / point.w;
+			center += corners[corner] / 8.0f;
+		}
+		float radius = 0.0f;
+		for (const glm::vec3& corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+		//Rounded up so float noise in the corners can't change the size frame to frame
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		//Moving the camera slides the cascade by whole texels, so the shadow edges don't crawl
+		float texel = 2.0f * radius / (float)Size;
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+		lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+		float top = std::max(castersTop, lightCenter.z + radius);
+		glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+			-top, -(lightCenter.z - radius));
+
+		Matrices[i] = projection * lightView;
+		Splits[i] = sliceFar;
+		TexelSizes[i] = texel;
+		sliceNear = sliceFar;
+	}
+}
+
+void CascadedShadowMap::BeginCascade(unsigned int cascade)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, cascade);
+	glViewport(0, 0, Size, Size);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void CascadedShadowMap::Bind(GLuint unit)
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+}
+
+void CascadedShadowMap::Delete()
+{
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &depthArray);
+	fbo = 0;
+	depthArray = 0;
+}
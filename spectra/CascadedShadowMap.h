@@ -0,0 +1,49 @@
+#ifndef CASCADED_SHADOW_MAP_CLASS_H
+#define CASCADED_SHADOW_MAP_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "UniformBlocks.h"
+
+// Most cascades the map holds, the size of the cascade arrays in LightData
+const unsigned int MAX_SHADOW_CASCADES = LIGHT_BLOCK_MAX_CASCADES;
+
+// The directional light's shadow over the camera's view range, split along the view depth into
+// cascades. Each cascade is an orthographic shadow map around one slice of the view frustum, the
+// near slices are short so their texels are small, and they all share one depth texture array, so
+// shadows stay sharp close to the camera without one huge map covering everything
+class CascadedShadowMap
+{
+public:
+	// cascades in use, at most MAX_SHADOW_CASCADES
+	unsigned int Count;
+	GLsizei Size;
+	// per cascade: light projection * view, the view depth where it ends, and the world size of one of its texels
+	glm::mat4 Matrices[MAX_SHADOW_CASCADES];
+	float Splits[MAX_SHADOW_CASCADES];
+	float TexelSizes[MAX_SHADOW_CASCADES];
+
+	CascadedShadowMap(GLsizei size, unsigned int count);
+
+	CascadedShadowMap(const CascadedShadowMap&) = delete;
+	CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+	// Splits the camera's view from its near plane to maxDistance into Count slices, lambda blending
+	// logarithmic splits (1) with even ones (0), and fits a cascade around each. The depth range reaches
+	// back to the casters' box, center/half extent, so casters between the light and a slice still shadow it
+	void Update(Camera& camera, const glm::vec3& lightDirection, float maxDistance, float lambda,
+		const glm::vec3& castersCenter, const glm::vec3& castersExtent);
+
+	// Clears cascade's layer and binds it for drawing
+	void BeginCascade(unsigned int cascade);
+	// Binds the array to unit, for a sampler2DArrayShadow
+	void Bind(GLuint unit);
+	void Delete();
+
+private:
+	GLuint depthArray = 0;
+	GLuint fbo = 0;
+};
+#endif
@@ -0,0 +1,251 @@
+#include "DDSFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+	const uint32_t DDSD_CAPS = 0x1;
+	const uint32_t DDSD_HEIGHT = 0x2;
+	const uint32_t DDSD_WIDTH = 0x4;
+	const uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDSD_LINEARSIZE = 0x80000;
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+	// DXGI_FORMAT values used by the DX10 header
+	const uint32_t DXGI_BC1_UNORM = 71;
+	const uint32_t DXGI_BC3_UNORM = 77;
+	const uint32_t DXGI_BC4_UNORM = 80;
+	const uint32_t DXGI_BC5_UNORM = 83;
+	const uint32_t DXGI_BC7_UNORM = 98;
+	const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+	struct DDSPixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t masks[4];
+	};
+
+	struct DDSHeader
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		DDSPixelFormat pixelFormat;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	struct DDSHeaderDX10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+
+	constexpr uint32_t fourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+	}
+
+	bool formatFromFourCC(uint32_t code, BlockFormat& format)
+	{
+		switch (code)
+		{
+			case fourCC('D', 'X', 'T', '1'): format = BlockFormat::BC1; return true;
+			case fourCC('D', 'X', 'T', '5'): format = BlockFormat::BC3; return true;
+			case fourCC('A', 'T', 'I', '1'):
+			case fourCC('B', 'C', '4', 'U'): format = BlockFormat::BC4; return true;
+			case fourCC('A', 'T', 'I', '2'):
+			case fourCC('B', 'C', '5', 'U'): format = BlockFormat::BC5; return true;
+			default: return false;
+		}
+	}
+
+	bool formatFromDXGI(uint32_t dxgiFormat, BlockFormat& format)
+	{
+		switch (dxgiFormat)
+		{
+			case DXGI_BC1_UNORM: format = BlockFormat::BC1; return true;
+			case DXGI_BC3_UNORM: format = BlockFormat::BC3; return true;
+			case DXGI_BC4_UNORM: format = BlockFormat::BC4; return true;
+			case DXGI_BC5_UNORM: format = BlockFormat::BC5; return true;
+			case DXGI_BC7_UNORM: format = BlockFormat::BC7; return true;
+			default: return false;
+		}
+	}
+}
+
+void DDSImage::AddLevel(uint32_t levelWidth, uint32_t levelHeight, const std::vector<uint8_t>& blocks)
+{
+	Level level = { levelWidth, levelHeight, data.size(), blocks.size() };
+	levels.push_back(level);
+	data.insert(data.end(), blocks.begin(), blocks.end());
+}
+
+size_t DDSImage::BlockBytes(BlockFormat format)
+{
+	return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+}
+
+size_t DDSImage::LevelBytes(BlockFormat format, uint32_t width, uint32_t height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+const char* DDSImage::Name(BlockFormat format)
+{
+	switch (format)
+	{
+		case BlockFormat::BC1: return "BC1";
+		case BlockFormat::BC3: return "BC3";
+		case BlockFormat::BC4: return "BC4";
+		case BlockFormat::BC5: return "BC5";
+		case BlockFormat::BC7: return "BC7";
+	}
+	return "?";
+}
+
+bool LoadDDS(const std::string& path, DDSImage& image)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	std::vector<uint8_t> contents((size_t)file.tellg());
+	file.seekg(0);
+	if (!file.read((char*)contents.data(), (std::streamsize)contents.size()) || !ParseDDS(contents.data(), contents.size(), image, path))
+		return false;
+
+	// keep the blocks, contents goes away
+	image.data.assign(image.view, image.view + image.viewSize);
+	image.view = nullptr;
+	image.viewSize = 0;
+	return true;
+}
+
+bool ParseDDS(const uint8_t* file, size_t fileSize, DDSImage& image, const std::string& name)
+{
+	size_t position = 0;
+	auto read = [&](void* out, size_t bytes)
+	{
+		if (position + bytes > fileSize)
+			return false;
+		memcpy(out, file + position, bytes);
+		position += bytes;
+		return true;
+	};
+
+	uint32_t magic = 0;
+	DDSHeader header = {};
+	if (!read(&magic, sizeof(magic)) || magic != DDS_MAGIC ||
+		!read(&header, sizeof(header)) || header.size != sizeof(DDSHeader))
+	{
+		std::cout << "ERROR::DDS::NOT_A_DDS_FILE " << name << std::endl;
+		return false;
+	}
+
+	bool known = false;
+	if (header.pixelFormat.flags & DDPF_FOURCC)
+	{
+		if (header.pixelFormat.fourCC == fourCC('D', 'X', '1', '0'))
+		{
+			DDSHeaderDX10 dx10 = {};
+			known = read(&dx10, sizeof(dx10)) && dx10.resourceDimension == D3D10_RESOURCE_DIMENSION_TEXTURE2D &&
+				dx10.arraySize <= 1 && formatFromDXGI(dx10.dxgiFormat, image.format);
+		}
+		else
+			known = formatFromFourCC(header.pixelFormat.fourCC, image.format);
+	}
+	if (!known)
+	{
+		std::cout << "ERROR::DDS::UNSUPPORTED_FORMAT " << name << std::endl;
+		return false;
+	}
+
+	image.width = header.width;
+	image.height = header.height;
+	image.levels.clear();
+	image.data.clear();
+	image.view = file + position;
+	image.viewSize = fileSize - position;
+
+	uint32_t levelCount = (header.flags & DDSD_MIPMAPCOUNT) ? std::max(1u, header.mipMapCount) : 1;
+	size_t offset = 0;
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		uint32_t width = std::max(1u, image.width >> i);
+		uint32_t height = std::max(1u, image.height >> i);
+		size_t size = DDSImage::LevelBytes(image.format, width, height);
+		if (offset + size > image.viewSize)
+		{
+			std::cout << "ERROR::DDS::TRUNCATED " << name << std::endl;
+			return false;
+		}
+		image.levels.push_back({ width, height, offset, size });
+		offset += size;
+	}
+	return true;
+}
+
+bool SaveDDS(const std::string& path, const DDSImage& image)
+{
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.height = image.height;
+	header.width = image.width;
+	header.pitchOrLinearSize = (uint32_t)DDSImage::LevelBytes(image.format, image.width, image.height);
+	header.mipMapCount = (uint32_t)image.levels.size();
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.caps = DDSCAPS_TEXTURE | (image.levels.size() > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+	DDSHeaderDX10 dx10 = {};
+	switch (image.format)
+	{
+		case BlockFormat::BC1: header.pixelFormat.fourCC = fourCC('D', 'X', 'T', '1'); break;
+		case BlockFormat::BC3: header.pixelFormat.fourCC = fourCC('D', 'X', 'T', '5'); break;
+		case BlockFormat::BC4: header.pixelFormat.fourCC = fourCC('A', 'T', 'I', '1'); break;
+		case BlockFormat::BC5: header.pixelFormat.fourCC = fourCC('A', 'T', 'I', '2'); break;
+		case BlockFormat::BC7:
+			header.pixelFormat.fourCC = fourCC('D', 'X', '1', '0');
+			dx10.dxgiFormat = DXGI_BC7_UNORM;
+			dx10.resourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+			dx10.arraySize = 1;
+			break;
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::DDS::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+	file.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+	file.write((const char*)&header, sizeof(header));
+	if (image.format == BlockFormat::BC7)
+		file.write((const char*)&dx10, sizeof(dx10));
+	file.write((const char*)image.Blocks(), image.BlocksSize());
+	return (bool)file;
+}
@@ -0,0 +1,58 @@
+#ifndef DDS_FILE_CLASS_H
+#define DDS_FILE_CLASS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Block compressed formats, each 4x4 texel block is 8 (BC1, BC4) or 16 bytes
+enum class BlockFormat
+{
+	BC1,	// RGB, 4 bits per texel
+	BC3,	// RGBA, BC1 colour plus a BC4 alpha block, 8 bits per texel
+	BC4,	// one channel, 4 bits per texel
+	BC5,	// two channels, two BC4 blocks, 8 bits per texel
+	BC7		// RGBA, 8 bits per texel at much higher quality than BC3
+};
+
+// A block compressed image with its complete mip chain, as read from or written to a DDS file.
+// Rows are stored bottom-up, the order GL and the stb_image path use, so the texture needs no
+// flip on upload. Files written by texconv follow that, DDS files from other tools come out upside down
+struct DDSImage
+{
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+		size_t offset;
+		size_t size;
+	};
+
+	BlockFormat format = BlockFormat::BC1;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<Level> levels;
+	std::vector<uint8_t> data;
+	// Set instead of data when the blocks are read in place from memory owned elsewhere, see ParseDDS
+	const uint8_t* view = nullptr;
+	size_t viewSize = 0;
+
+	// The block data of all levels, wherever it lives
+	const uint8_t* Blocks() const { return view != nullptr ? view : data.data(); }
+	size_t BlocksSize() const { return view != nullptr ? viewSize : data.size(); }
+
+	// Appends a level after the existing ones, blocks holds its compressed data
+	void AddLevel(uint32_t levelWidth, uint32_t levelHeight, const std::vector<uint8_t>& blocks);
+
+	static size_t BlockBytes(BlockFormat format);
+	static size_t LevelBytes(BlockFormat format, uint32_t width, uint32_t height);
+	static const char* Name(BlockFormat format);
+};
+
+// Reads BC1/3/4/5 files with a FourCC header and BC1/3/4/5/7 files with the DX10 header
+bool LoadDDS(const std::string& path, DDSImage& image);
+// Same for a file already in memory. The image views the blocks in place, file has to outlive it
+bool ParseDDS(const uint8_t* file, size_t fileSize, DDSImage& image, const std::string& name);
+// Writes BC7 with the DX10 header and everything else with the widely read FourCC one
+bool SaveDDS(const std::string& path, const DDSImage& image);
+#endif
@@ -9,6 +9,34 @@ EBO::EBO(std::vector<GLuint>& indices)
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
 }
 
+EBO::EBO(const void* data, GLsizeiptr size)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+}
+
+EBO::~EBO()
+{
+	Delete();
+}
+
+EBO::EBO(EBO&& other) noexcept : ID(other.ID)
+{
+	other.ID = 0;
+}
+
+EBO& EBO::operator=(EBO&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
+}
+
 void EBO::Bind()
 {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
@@ -21,5 +49,7 @@ void EBO::Unbind()
 
 void EBO::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	if (ID != 0)
+		glDeleteBuffers(1, &ID);
+	ID = 0;
 }
@@ -7,8 +7,19 @@
 class EBO
 {
 public:
-	GLuint ID;
+	GLuint ID = 0;
+	// Empty handle that owns nothing until a buffer is moved into it
+	EBO() = default;
 	EBO(std::vector<GLuint>& indices);
+	// Indices of any type uploaded from memory the caller keeps, such as a mapped file
+	EBO(const void* data, GLsizeiptr size);
+	~EBO();
+
+	// Owns the buffer, moves hand it over and copies are not allowed
+	EBO(const EBO&) = delete;
+	EBO& operator=(const EBO&) = delete;
+	EBO(EBO&& other) noexcept;
+	EBO& operator=(EBO&& other) noexcept;
 
 	void Bind();
 	void Unbind();
@@ -1,11 +1,19 @@
 #version 330 core
+#ifdef POINT_SHADOWS
+#extension GL_ARB_texture_cube_map_array : require
+#endif
 
 struct Material {    
+#ifndef MATERIAL_ARRAY
+    //The arrays take units 0 and 1, these would default to the same units with a different sampler type
     sampler2D diffuse;
     sampler2D specular;
+#endif
     float shininess;
 };
 
+//Light structs are laid out so each vec3 shares its 16 byte std140 slot with a scalar,
+//the C++ mirrors live in UniformBlocks.h, PointLightData in LightClusters.h for point lights
 struct DirectionLight 
 {
     vec3 direction;
@@ -18,61 +26,146 @@ struct DirectionLight
 struct PointLight
 {
     vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;  
-
+    //nothing past it is lit
+    float radius;
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular;
+    float quadratic;
+    //-1 without a shadow map, otherwise its atlas tier + 4 * its cube in the tier's array
+    int shadow;
 };
 
 struct SpotLight 
 {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
-  
-    float constant;
-    float linear;
-    float quadratic;
-  
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular; 
+    float quadratic;
 };
 
-#define NR_POINT_LIGHTS 1  
-
+//Features are switched by defines that ShaderPermutations inserts for each variant,
+//so a variant only contains the lighting and shadow code it actually uses
+//  INSTANCED           model matrix comes from the per-instance attribute (vertex stage only)
+//  POINT_SHADOWS       point lights may have a shadow cubemap in the atlas, picked by PointLight.shadow
+//  DIR_LIGHT           directional light
+//  SPOT_LIGHT          spot light
+//  DIR_LIGHT_SHADOW    cascaded shadow maps for the directional light, layers of one depth array
+//  POINT_SHADOW_TAPS   point shadows through comparison samplers, this many hardware filtered taps on a rotated
+//                      Poisson disk. Without it the depth is read raw by the 64 tap PCF cube, or POINT_SHADOW_GRID
+//  POINT_SHADOW_GRID   20 tap grid disk instead of the 64 tap PCF cube for point shadows
+//  MATERIAL_ARRAY      diffuse and specular come from texture array layers picked by MaterialLayer
+//  DEFERRED            lighting pass of the deferred path over a full screen triangle, the surface
+//                      comes out of the G-buffer GBufferShader.fs wrote instead of the varyings
+#ifdef DEFERRED
+//Stand-ins for the varyings, ReadGBuffer fills them for the pixel
+vec3 FragPos;
+vec3 Normal;
+vec3 gbufferAlbedo;
+float gbufferSpecular;
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+//Clip space back to world space, for the position under each pixel
+uniform mat4 inverseViewProjection;
+#else
 in vec3 FragPos;
 in vec3 Normal;
 in vec3 ourColor;
 in vec2 TexCoord;
-in vec4 FragPosLightSpace;
+#ifdef MATERIAL_ARRAY
+flat in int MaterialLayer;
+#endif
+#endif
 
 out vec4 FragColor;
 
-//Light
-uniform vec3 viewPos;
-uniform DirectionLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+//Shared per-frame camera data
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float far_plane;
+};
+
+//Shared per-frame light data, the point lights are in the buffer textures below
+layout (std140) uniform LightData
+{
+    DirectionLight dirLight;
+    SpotLight spotLight;
+    int num_cascades;
+    mat4 cascadeMatrices[4];
+    vec4 cascadeSplits;
+    vec4 cascadeTexelSizes;
+    ivec4 clusterSize;
+    vec4 clusterScale;
+};
+
+//Point lights, five texels each, and their lists per froxel: where the froxel's run of
+//clusterLightIndices starts and how long it is. LightClusters bins them every frame
+uniform samplerBuffer pointLightTexels;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLightIndices;
 
 uniform Material material;
 
 //Tex
+#ifdef DEFERRED
+vec3 DiffuseTexel() { return gbufferAlbedo; }
+vec3 SpecularTexel() { return vec3(gbufferSpecular); }
+#elif defined(MATERIAL_ARRAY)
+uniform sampler2DArray diffuseArray;
+uniform sampler2DArray specularArray;
+
+vec3 DiffuseTexel() { return vec3(texture(diffuseArray, vec3(TexCoord, MaterialLayer))); }
+vec3 SpecularTexel() { return vec3(texture(specularArray, vec3(TexCoord, MaterialLayer))); }
+#else
 uniform sampler2D diffuse0; 
 uniform sampler2D specular0; 
 
-//Total Point Lights
-uniform int num_pointLights;
-
-uniform sampler2D shadowMap;
-uniform samplerCube depthMap[NR_POINT_LIGHTS];
-uniform float far_plane;
+vec3 DiffuseTexel() { return vec3(texture(diffuse0, TexCoord)); }
+vec3 SpecularTexel() { return vec3(texture(specular0, TexCoord)); }
+#endif
+
+#ifdef DIR_LIGHT_SHADOW
+uniform sampler2DArrayShadow dirShadowCascades;
+#endif
+#ifdef POINT_SHADOWS
+//The shadow atlas, one cube map array per resolution tier
+#ifdef POINT_SHADOW_TAPS
+//Named apart from the depth samplers, they are bound to other units whose sampler compares
+uniform samplerCubeArrayShadow pointShadowCompareTier0;
+uniform samplerCubeArrayShadow pointShadowCompareTier1;
+uniform samplerCubeArrayShadow pointShadowCompareTier2;
+#else
+uniform samplerCubeArray pointShadowTier0;
+uniform samplerCubeArray pointShadowTier1;
+uniform samplerCubeArray pointShadowTier2;
+#endif
+#endif
+
+#ifdef POINT_SHADOW_TAPS
+//Taps on the unit disk, the first four spread over all of it, they decide the early out
+const vec2 poissonDisk[16] = vec2[]
+(
+   vec2(-0.94201624, -0.39906216), vec2( 0.94558609, -0.76890725), vec2(-0.24188840,  0.99706507), vec2( 0.79197514,  0.19090188),
+   vec2(-0.09418410, -0.92938870), vec2( 0.34495938,  0.29387760), vec2(-0.91588581,  0.45771432), vec2( 0.44323325, -0.97511554),
+   vec2(-0.38277543,  0.27676845), vec2( 0.53742981, -0.47373420), vec2(-0.26496911, -0.41893023), vec2( 0.97484398,  0.75648379),
+   vec2(-0.81544232, -0.87912464), vec2(-0.81409955,  0.91437590), vec2( 0.19984126,  0.78641367), vec2( 0.14383161, -0.14100790)
+);
+#endif
 
+#ifdef POINT_SHADOW_GRID
 // array of offset direction for sampling
 vec3 gridSamplingDisk[20] = vec3[]
 (
@@ -82,12 +175,18 @@ vec3 gridSamplingDisk[20] = vec3[]
    vec3(1, 0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1, 0, -1),
    vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
 );
-
-vec3 CalculateDirectionLights(DirectionLight light, vec3 normal, vec3 viewDir);
+#endif
+
+#ifdef DEFERRED
+bool ReadGBuffer();
+#endif
+PointLight FetchPointLight(int index);
+int ClusterIndex(vec3 fragPos);
+vec3 CalculateDirectionLights(DirectionLight light, vec3 normal, vec3 viewDir, float shadow);
 vec3 CalculatePointLights(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalculateSpotLights(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-float ShadowCalculation(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir);
-float PointLightShadowCalculation(int pointLightIndex, vec3 fragPos);
+float ShadowCalculation(vec3 fragPos, vec3 normal, vec3 lightDir);
+float PointLightShadowCalculation(int shadowMap, vec3 lightPos, vec3 fragPos);
 
 /* //COMMENTED CODE START - 1
 //To visualize depth buffer
@@ -105,33 +204,46 @@ float LinearizeDepth(float depth)
 
 void main()
 {
+#ifdef DEFERRED
+    if (!ReadGBuffer())
+        discard;
+#endif
     //Get Normal
     vec3 norm = normalize(Normal);
     //Get View Direction
     vec3 viewDir =  normalize(viewPos - FragPos);
 
-    float shadow = 0.0f;
+    vec3 result = vec3(0.0);
 
-    //Direction Light
-    vec3 result = CalculateDirectionLights(dirLight, norm, viewDir);
+    //Direction Light, its shadow only takes away the direct light
+#ifdef DIR_LIGHT
+    float dirShadow = 0.0;
+#ifdef DIR_LIGHT_SHADOW
+    dirShadow = ShadowCalculation(FragPos, norm, normalize(-dirLight.direction));
+#endif
+    result += CalculateDirectionLights(dirLight, norm, viewDir, dirShadow);
+#endif
     
-    //Point Lights 
-    for(int i = 0; i < num_pointLights; ++i)
+    //Point Lights, only the ones binned into this fragment's froxel
+    uvec2 lightRange = texelFetch(clusterRanges, ClusterIndex(FragPos)).xy;
+    for(uint i = 0u; i < lightRange.y; ++i)
     {
-        result += CalculatePointLights(pointLights[i],norm, FragPos, viewDir);
-        shadow = PointLightShadowCalculation(i, FragPos);
+        PointLight light = FetchPointLight(int(texelFetch(clusterLightIndices, int(lightRange.x + i)).x));
+        vec3 pointLight = CalculatePointLights(light, norm, FragPos, viewDir);
+#ifdef POINT_SHADOWS
+        //Each light is only darkened by its own shadow
+        if (light.shadow >= 0)
+            pointLight *= 1.0 - PointLightShadowCalculation(light.shadow, light.position, FragPos);
+#endif
+        result += pointLight;
     }
 
     //Spot Light
-    //result += CalculateSpotLights(spotLight,norm, FragPos, viewDir);    
+#ifdef SPOT_LIGHT
+    result += CalculateSpotLights(spotLight,norm, FragPos, viewDir);    
+#endif
         
-    // Shadow calculation
-    //float shadow = ShadowCalculation(FragPosLightSpace, norm, -dirLight.direction);
-
-    // Combine results
-    vec3 lighting = (1.0 - shadow) * result;
-    
-    FragColor = vec4(lighting, 1.0);
+    FragColor = vec4(result, 1.0);
 
     //FragColor = vec4(result, 1.0);
 
@@ -143,11 +255,70 @@ void main()
     */ //COMMENTED CODE END - 2
 }
 
-vec3 CalculateDirectionLights(DirectionLight light, vec3 normal, vec3 viewDir)
+#ifdef DEFERRED
+vec3 OctahedronDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+//Fills the stand-ins for the varyings from the pixel's texels, false where nothing was drawn
+bool ReadGBuffer()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth == 1.0)
+        return false;
+
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    gbufferAlbedo = albedoSpecular.rgb;
+    gbufferSpecular = albedoSpecular.a;
+    Normal = OctahedronDecode(texelFetch(gNormal, pixel, 0).xy * 2.0 - 1.0);
+
+    vec2 ndc = gl_FragCoord.xy / vec2(textureSize(gDepth, 0)) * 2.0 - 1.0;
+    vec4 world = inverseViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    FragPos = world.xyz / world.w;
+    return true;
+}
+#endif
+
+PointLight FetchPointLight(int index)
+{
+    int texel = index * 5;
+    vec4 positionRadius = texelFetch(pointLightTexels, texel);
+    vec4 ambientConstant = texelFetch(pointLightTexels, texel + 1);
+    vec4 diffuseLinear = texelFetch(pointLightTexels, texel + 2);
+    vec4 specularQuadratic = texelFetch(pointLightTexels, texel + 3);
+
+    PointLight light;
+    light.position = positionRadius.xyz;
+    light.radius = positionRadius.w;
+    light.ambient = ambientConstant.xyz;
+    light.constant = ambientConstant.w;
+    light.diffuse = diffuseLinear.xyz;
+    light.linear = diffuseLinear.w;
+    light.specular = specularQuadratic.xyz;
+    light.quadratic = specularQuadratic.w;
+    light.shadow = int(texelFetch(pointLightTexels, texel + 4).x);
+    return light;
+}
+
+//The froxel fragPos is in, screen tile from the pixel and depth slice from the log of the view depth
+int ClusterIndex(vec3 fragPos)
+{
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScale.xy), clusterSize.xy - 1);
+    int slice = clamp(int(log(max(viewDepth, 1e-4)) * clusterScale.z - clusterScale.w), 0, clusterSize.z - 1);
+    return (slice * clusterSize.y + tile.y) * clusterSize.x + tile.x;
+}
+
+vec3 CalculateDirectionLights(DirectionLight light, vec3 normal, vec3 viewDir, float shadow)
 {
-    vec3 tex = vec3(texture(diffuse0, TexCoord)); //tex ambient and tex diffuse have same values
+    vec3 tex = DiffuseTexel(); //tex ambient and tex diffuse have same values
     
-    vec3 texSpecular = vec3(texture(specular0, TexCoord));
+    vec3 texSpecular = SpecularTexel();
 
     //Set light direction. 
     //Remember to reverse the direction. Users set the direction from the light source. OpenGl reads it the other way
@@ -165,15 +336,15 @@ vec3 CalculateDirectionLights(DirectionLight light, vec3 normal, vec3 viewDir)
     vec3 diffuse = light.diffuse * (diff * tex);
     vec3 specular = light.specular * (spec * texSpecular); 
 
-    vec3 result = ambient + diffuse + specular;
+    vec3 result = ambient + (1.0 - shadow) * (diffuse + specular);
     return result;
 }
 
 vec3 CalculatePointLights(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 tex = vec3(texture(diffuse0, TexCoord)); //tex ambient and tex diffuse have same values
+    vec3 tex = DiffuseTexel(); //tex ambient and tex diffuse have same values
     
-    vec3 texSpecular = vec3(texture(specular0, TexCoord));
+    vec3 texSpecular = SpecularTexel();
     
     //Get light direction
     vec3 lightDir = normalize(light.position - fragPos);
@@ -189,6 +360,9 @@ vec3 CalculatePointLights(PointLight light, vec3 normal, vec3 fragPos, vec3 view
     float distance    = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + 
   			     light.quadratic * (distance * distance)); 
+    //Faded to 0 at the radius the light was binned with, so its froxels end without a seam
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
     
     //Ambient, diffuse, specular
     vec3 ambient = light.ambient  * tex;
@@ -207,9 +381,9 @@ vec3 CalculatePointLights(PointLight light, vec3 normal, vec3 fragPos, vec3 view
 
 vec3 CalculateSpotLights(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 tex = vec3(texture(diffuse0, TexCoord)); //tex ambient and tex diffuse have same values
+    vec3 tex = DiffuseTexel(); //tex ambient and tex diffuse have same values
     
-    vec3 texSpecular = vec3(texture(specular0, TexCoord));
+    vec3 texSpecular = SpecularTexel();
 
     //Get light direction
     vec3 lightDir = normalize(light.position - fragPos);
@@ -245,58 +419,126 @@ vec3 CalculateSpotLights(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDi
     return result;
 }
 
-float ShadowCalculation(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
+#ifdef DIR_LIGHT_SHADOW
+float ShadowCalculation(vec3 fragPos, vec3 normal, vec3 lightDir)
 {
-     // perform perspective divide
-    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    // transform to [0,1] range
-    projCoords = projCoords * 0.5 + 0.5;
-    // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
-    // get depth of current fragment from light's perspective
-    float currentDepth = projCoords.z;
-    // calculate bias (based on depth map resolution and slope)
-    float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-    // check whether current frag pos is in shadow
-     //float shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
-    // PCF
-    
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-    for(int x = -1; x <= 1; ++x)
+    // pick the cascade by view depth, the first one whose slice reaches past the fragment
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    if (num_cascades == 0 || viewDepth > cascadeSplits[num_cascades - 1])
+        return 0.0;
+    int cascade = 0;
+    while (cascade < num_cascades - 1 && viewDepth > cascadeSplits[cascade])
+        ++cascade;
+
+    // push the lookup off the surface by about a texel of this cascade, more where the light grazes it,
+    // so the surface doesn't shadow itself however large the cascade's texels are
+    float grazing = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec3 offsetPos = fragPos + normal * cascadeTexelSizes[cascade] * (1.0 + 2.0 * grazing);
+    // orthographic, w stays 1, so only the transform to [0,1] range is left
+    vec3 projCoords = vec3(cascadeMatrices[cascade] * vec4(offsetPos, 1.0)) * 0.5 + 0.5;
+    // keep the shadow at 0.0 beyond the far side of the cascade
+    if (projCoords.z > 1.0)
+        return 0.0;
+
+    // PCF, 3x3 comparison taps that each blend 2x2 texels
+    float lit = 0.0;
+    vec2 texelSize = 1.0 / vec2(textureSize(dirShadowCascades, 0));
+    for (int x = -1; x <= 1; ++x)
     {
-        for(int y = -1; y <= 1; ++y)
-        {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r; 
-            shadow += currentDepth - bias > pcfDepth  ? 1.0 : 0.0;        
-        }    
+        for (int y = -1; y <= 1; ++y)
+            lit += texture(dirShadowCascades, vec4(projCoords.xy + vec2(x, y) * texelSize, float(cascade), projCoords.z));
     }
-    shadow /= 9.0;
-    
-    // keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
-    if(projCoords.z > 1.0)
-        shadow = 0.0;
-        
-    return shadow;
+    return 1.0 - lit / 9.0;
+}
+
+#endif
+
+#ifdef POINT_SHADOWS
+//Sampler arrays may only be indexed with constants, so the tier is a branch. Each light has its own tier,
+//so neighbouring fragments may take different sides; that is only safe because the atlas samplers
+//have no mips and so need no implicit derivatives
+#ifdef POINT_SHADOW_TAPS
+//How lit direction is in cube of tier's array for a fragment at reference * far_plane, 0 to 1
+//over the 2x2 texels the comparison sampler blends
+float PointShadowLit(int tier, float cube, vec3 direction, float reference)
+{
+    vec4 coord = vec4(direction, cube);
+    if (tier == 0)
+        return texture(pointShadowCompareTier0, coord, reference);
+    if (tier == 1)
+        return texture(pointShadowCompareTier1, coord, reference);
+    return texture(pointShadowCompareTier2, coord, reference);
+}
+#else
+//Stored distance / far_plane toward direction in cube of tier's array
+float PointShadowDepth(int tier, float cube, vec3 direction)
+{
+    vec4 coord = vec4(direction, cube);
+    if (tier == 0)
+        return texture(pointShadowTier0, coord).r;
+    if (tier == 1)
+        return texture(pointShadowTier1, coord).r;
+    return texture(pointShadowTier2, coord).r;
 }
+#endif
 
-float PointLightShadowCalculation(int pointLightIndex, vec3 fragPos)
+float PointLightShadowCalculation(int shadowMap, vec3 lightPos, vec3 fragPos)
 {
+    int tier = shadowMap & 3;
+    float cube = float(shadowMap >> 2);
+
     // get vector between fragment position and light position
-    vec3 fragToLight = fragPos - pointLights[pointLightIndex].position;
+    vec3 fragToLight = fragPos - lightPos;
     // ise the fragment to light vector to sample from the depth map    
-    //float closestDepth = texture(depthMap[pointLightIndex], fragToLight).r;
+    //float closestDepth = texture(depthCubemap, fragToLight).r;
     // it is currently in linear range between [0,1], let's re-transform it back to original depth value
     //closestDepth *= far_plane;
     // now get current linear depth as the length between the fragment and light position
     float currentDepth = length(fragToLight);
+    // nothing beyond the far plane was drawn into the map
+    if (currentDepth >= far_plane)
+        return 0.0;
     // test for shadows
     //float bias = 0.05; // we use a much larger bias since depth is now in [near_plane, far_plane] range
     //float shadow = currentDepth -  bias > closestDepth ? 1.0 : 0.0;        
     // display closestDepth as debug (to visualize depth cubemap)
     // FragColor = vec4(vec3(closestDepth / far_plane), 1.0);    
 
-    /*
+#if defined(POINT_SHADOW_TAPS)
+    //Hardware PCF: each tap already blends four depth comparisons
+    float bias = 0.05;
+    float reference = (currentDepth - bias) / far_plane;
+#if POINT_SHADOW_TAPS == 1
+    float shadow = 1.0 - PointShadowLit(tier, cube, fragToLight, reference);
+#else
+    //The disk lies across the direction to the light, as wide as the 64 tap cube, and turned by a
+    //per pixel angle so the kernel's pattern becomes noise instead of banding
+    vec3 direction = fragToLight / currentDepth;
+    vec3 tangent = normalize(cross(abs(direction.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), direction));
+    vec3 bitangent = cross(direction, tangent);
+    float angle = 6.2831853 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+    float diskRadius = 0.1;
+
+    float lit = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 offset = rotation * poissonDisk[i] * diskRadius;
+        lit += PointShadowLit(tier, cube, fragToLight + tangent * offset.x + bitangent * offset.y, reference);
+    }
+    //Fully lit or fully shadowed across the disk, the remaining taps would agree
+    if (lit > 3.999)
+        return 0.0;
+    if (lit < 0.001)
+        return 1.0;
+    for (int i = 4; i < POINT_SHADOW_TAPS; ++i)
+    {
+        vec2 offset = rotation * poissonDisk[i] * diskRadius;
+        lit += PointShadowLit(tier, cube, fragToLight + tangent * offset.x + bitangent * offset.y, reference);
+    }
+    float shadow = 1.0 - lit / float(POINT_SHADOW_TAPS);
+#endif
+#elif defined(POINT_SHADOW_GRID)
     //Grid Sampling
     float shadow = 0.0;
     float bias = 0.15;
@@ -305,14 +547,13 @@ float PointLightShadowCalculation(int pointLightIndex, vec3 fragPos)
     float diskRadius = (1.0 + (viewDistance / far_plane)) / 25.0;
     for(int i = 0; i < samples; ++i)
     {
-        float closestDepth = texture(depthMap[pointLightIndex], fragToLight + gridSamplingDisk[i] * diskRadius).r;
+        float closestDepth = PointShadowDepth(tier, cube, fragToLight + gridSamplingDisk[i] * diskRadius);
         closestDepth *= far_plane;   // undo mapping [0;1]
         if(currentDepth - bias > closestDepth)
             shadow += 1.0;
     }
     shadow /= float(samples);
-    */
-
+#else
     // PCF
     float shadow = 0.0;
     float bias = 0.05; 
@@ -324,7 +565,7 @@ float PointLightShadowCalculation(int pointLightIndex, vec3 fragPos)
         {
             for(float z = -offset; z < offset; z += offset / (samples * 0.5))
             {
-                float closestDepth = texture(depthMap[pointLightIndex], fragToLight + vec3(x, y, z)).r; // use lightdir to lookup cubemap
+                float closestDepth = PointShadowDepth(tier, cube, fragToLight + vec3(x, y, z)); // use lightdir to lookup cubemap
                 closestDepth *= far_plane;   // Undo mapping [0;1]
                 if(currentDepth - bias > closestDepth)
                     shadow += 1.0;
@@ -332,8 +573,8 @@ float PointLightShadowCalculation(int pointLightIndex, vec3 fragPos)
         }
      }
      shadow /= (samples * samples * samples);
-
-
+#endif
         
     return shadow;
 }
+#endif
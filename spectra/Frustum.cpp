@@ -0,0 +1,150 @@
+#include "Frustum.h"
+
+#include <cmath>
+
+//SSE is always there on x64 and on x86 builds targeting it, anything else takes the scalar path
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+void BoundsSoA::Clear()
+{
+	centerX.clear(); centerY.clear(); centerZ.clear();
+	extentX.clear(); extentY.clear(); extentZ.clear();
+}
+
+void BoundsSoA::Reserve(size_t count)
+{
+	centerX.reserve(count); centerY.reserve(count); centerZ.reserve(count);
+	extentX.reserve(count); extentY.reserve(count); extentZ.reserve(count);
+}
+
+void BoundsSoA::Add(const glm::vec3& center, const glm::vec3& extent)
+{
+	centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+	extentX.push_back(extent.x); extentY.push_back(extent.y); extentZ.push_back(extent.z);
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	//Gribb/Hartmann, each plane is the last row of the matrix plus or minus one of the others
+	const glm::mat4& m = viewProjection;
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Planes[0] = row3 + row0;
+	Planes[1] = row3 - row0;
+	Planes[2] = row3 + row1;
+	Planes[3] = row3 - row1;
+	Planes[4] = row3 + row2;
+	Planes[5] = row3 - row2;
+
+	for (glm::vec4& plane : Planes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::IsVisible(const glm::vec3& center, const glm::vec3& extent) const
+{
+	for (const glm::vec4& plane : Planes)
+	{
+		//Distance of the box corner furthest along the plane normal
+		float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+		if (distance + radius < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void Frustum::Cull(const BoundsSoA& bounds, std::vector<uint32_t>& visible) const
+{
+	size_t count = bounds.Size();
+	size_t i = 0;
+
+#ifdef FRUSTUM_USE_SSE
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	__m128 absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(Planes[p].x);
+		planeY[p] = _mm_set1_ps(Planes[p].y);
+		planeZ[p] = _mm_set1_ps(Planes[p].z);
+		planeW[p] = _mm_set1_ps(Planes[p].w);
+		absX[p] = _mm_set1_ps(fabsf(Planes[p].x));
+		absY[p] = _mm_set1_ps(fabsf(Planes[p].y));
+		absZ[p] = _mm_set1_ps(fabsf(Planes[p].z));
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+		__m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+		__m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+		__m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+		__m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+		int inside = 0xF;
+		for (int p = 0; p < 6 && inside != 0; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+			inside &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (inside & (1 << lane))
+				visible.push_back((uint32_t)(i + lane));
+		}
+	}
+#endif
+
+	//Whatever doesn't fill a whole group of four
+	for (; i < count; ++i)
+	{
+		glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+		glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+		if (IsVisible(center, extent))
+			visible.push_back((uint32_t)i);
+	}
+}
+
+void Frustum::TransformBounds(BoundingBox& box, const glm::mat4& model, glm::vec3& center, glm::vec3& extent)
+{
+	glm::vec3 localCenter((box.getMinX() + box.getMaxX()) * 0.5f, (box.getMinY() + box.getMaxY()) * 0.5f, (box.getMinZ() + box.getMaxZ()) * 0.5f);
+	glm::vec3 localExtent((box.getMaxX() - box.getMinX()) * 0.5f, (box.getMaxY() - box.getMinY()) * 0.5f, (box.getMaxZ() - box.getMinZ()) * 0.5f);
+
+	center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+	//Arvo's method, the rotated box's extent along each world axis is the abs of the matrix times the local extent
+	glm::mat3 absolute(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+	extent = absolute * localExtent;
+}
+
+CubeFrustum::CubeFrustum(const glm::mat4 faceViewProjections[6])
+{
+	for (int face = 0; face < 6; ++face)
+		Faces[face] = Frustum(faceViewProjections[face]);
+}
+
+unsigned int CubeFrustum::FaceMask(const glm::vec3& center, const glm::vec3& extent) const
+{
+	unsigned int mask = 0;
+	for (int face = 0; face < 6; ++face)
+	{
+		if (Faces[face].IsVisible(center, extent))
+			mask |= 1u << face;
+	}
+	return mask;
+}
+
+void CubeFrustum::Cull(const BoundsSoA& bounds, std::vector<uint32_t> visible[6]) const
+{
+	for (int face = 0; face < 6; ++face)
+		Faces[face].Cull(bounds, visible[face]);
+}
@@ -0,0 +1,63 @@
+#ifndef FRUSTUM_CLASS_H
+#define FRUSTUM_CLASS_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "BoundingBox.h"
+
+// World space boxes as center/half extent, one array per component, so the cull loop can
+// load four boxes into a single SSE register per component
+struct BoundsSoA
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	void Clear();
+	void Reserve(size_t count);
+	void Add(const glm::vec3& center, const glm::vec3& extent);
+	size_t Size() const { return centerX.size(); }
+};
+
+// Objects that passed and failed culling this frame
+struct CullStats
+{
+	unsigned int Submitted = 0;
+	unsigned int Culled = 0;
+};
+
+class Frustum
+{
+public:
+	// left, right, bottom, top, near, far. xyz is the inward facing normal, w the distance
+	glm::vec4 Planes[6];
+
+	Frustum() {}
+	// Extracts the planes from projection * view, boxes are then tested in world space
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	bool IsVisible(const glm::vec3& center, const glm::vec3& extent) const;
+	// Appends the index of every box that touches the frustum to visible, four boxes at a time
+	void Cull(const BoundsSoA& bounds, std::vector<uint32_t>& visible) const;
+
+	// World space center/extent of a local box under a model matrix, still an axis aligned box
+	static void TransformBounds(BoundingBox& box, const glm::mat4& model, glm::vec3& center, glm::vec3& extent);
+};
+
+// The six faces of a cube map seen from one point, each its own 90 degree frustum, so the
+// point shadow pass only sends a caster to the faces it lands on
+class CubeFrustum
+{
+public:
+	Frustum Faces[6];
+
+	// One projection * view per face, in cube map face order
+	explicit CubeFrustum(const glm::mat4 faceViewProjections[6]);
+
+	// One bit per face the box touches, bit i for face i
+	unsigned int FaceMask(const glm::vec3& center, const glm::vec3& extent) const;
+	// Appends the index of every box touching face i to visible[i]
+	void Cull(const BoundsSoA& bounds, std::vector<uint32_t> visible[6]) const;
+};
+#endif
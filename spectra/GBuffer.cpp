@@ -0,0 +1,109 @@
+#include "GBuffer.h"
+
+#include <iostream>
+
+GBuffer::GBuffer(GLsizei width, GLsizei height) : Width(width), Height(height)
+{
+	glGenFramebuffers(1, &fbo);
+	createTargets();
+
+	//Core profile draws need a vertex array bound even when the vertex shader makes up the positions
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+void GBuffer::Resize(GLsizei width, GLsizei height)
+{
+	if (width == Width && height == Height)
+		return;
+	Width = width;
+	Height = height;
+	deleteTargets();
+	createTargets();
+}
+
+void GBuffer::createTargets()
+{
+	albedoSpecular = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, Width, Height);
+	normal = createTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, Width, Height);
+	depth = createTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, Width, Height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::GBUFFER::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::deleteTargets()
+{
+	glDeleteTextures(1, &albedoSpecular);
+	glDeleteTextures(1, &normal);
+	glDeleteTextures(1, &depth);
+	albedoSpecular = normal = depth = 0;
+}
+
+GLuint GBuffer::createTarget(GLint internalFormat, GLenum format, GLenum type, GLsizei width, GLsizei height)
+{
+	//Read with texelFetch, one texel per pixel
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+void GBuffer::BeginGeometry()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, Width, Height);
+	//The colour targets keep last frame's values, the lighting pass skips every pixel left at the far plane
+	glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+void GBuffer::BeginLighting()
+{
+	//Both depth formats have to match for the blit, GLFW's default framebuffer is D24S8 as well
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, Width, Height, 0, 0, Width, Height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glActiveTexture(GL_TEXTURE0 + ALBEDO_SPECULAR_UNIT);
+	glBindTexture(GL_TEXTURE_2D, albedoSpecular);
+	glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D, normal);
+	glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depth);
+}
+
+void GBuffer::DrawFullscreen(Shader& shader)
+{
+	shader.Activate();
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+}
+
+void GBuffer::SetSamplers(Shader& shader)
+{
+	shader.setInt("gAlbedoSpecular", ALBEDO_SPECULAR_UNIT);
+	shader.setInt("gNormal", NORMAL_UNIT);
+	shader.setInt("gDepth", DEPTH_UNIT);
+}
+
+void GBuffer::Delete()
+{
+	glDeleteFramebuffers(1, &fbo);
+	deleteTargets();
+	glDeleteVertexArrays(1, &emptyVAO);
+	fbo = emptyVAO = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef GBUFFER_CLASS_H
+#define GBUFFER_CLASS_H
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+
+// Geometry buffer of the deferred path, 12 bytes a pixel: albedo with the specular intensity in
+// RGBA8, the normal octahedron encoded in RG16 and depth, which the lighting pass rebuilds the
+// world position from. Depth is D24S8 so it can be blitted into the default framebuffer for
+// whatever is still drawn forward after the lighting
+class GBuffer
+{
+public:
+	// Units the lighting pass reads the targets from
+	static const GLuint ALBEDO_SPECULAR_UNIT = 12;
+	static const GLuint NORMAL_UNIT = 13;
+	static const GLuint DEPTH_UNIT = 14;
+
+	GLsizei Width;
+	GLsizei Height;
+
+	GBuffer(GLsizei width, GLsizei height);
+
+	GBuffer(const GBuffer&) = delete;
+	GBuffer& operator=(const GBuffer&) = delete;
+
+	size_t ResidentBytes() const { return (size_t)Width * Height * (4 + 4 + 4); }
+
+	// Recreates the targets at the new size, e.g. after the window was resized. Does nothing when the
+	// size didn't change
+	void Resize(GLsizei width, GLsizei height);
+	// Binds the buffer for the geometry pass and clears it
+	void BeginGeometry();
+	// Copies depth into the default framebuffer, binds it and the targets for the lighting pass
+	void BeginLighting();
+	// One triangle over the whole screen, with no vertex data
+	void DrawFullscreen(Shader& shader);
+	// Points the G-buffer samplers of shader at the units of BeginLighting, once per program
+	static void SetSamplers(Shader& shader);
+	void Delete();
+
+private:
+	GLuint fbo = 0;
+	GLuint albedoSpecular = 0;
+	GLuint normal = 0;
+	GLuint depth = 0;
+	GLuint emptyVAO = 0;
+
+	void createTargets();
+	void deleteTargets();
+	static GLuint createTarget(GLint internalFormat, GLenum format, GLenum type, GLsizei width, GLsizei height);
+};
+#endif
@@ -0,0 +1,44 @@
+#version 330 core
+//Geometry pass of the deferred path, VertexShader.vs feeds it. Writes what FragmentShader.fs
+//reads back under DEFERRED, see GBuffer.h for the layout
+//  INSTANCED           model matrix comes from the per-instance attribute (vertex stage only)
+//  MATERIAL_ARRAY      diffuse and specular come from texture array layers picked by MaterialLayer
+
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec2 gNormal;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec3 ourColor;
+in vec2 TexCoord;
+#ifdef MATERIAL_ARRAY
+flat in int MaterialLayer;
+
+uniform sampler2DArray diffuseArray;
+uniform sampler2DArray specularArray;
+
+vec3 DiffuseTexel() { return vec3(texture(diffuseArray, vec3(TexCoord, MaterialLayer))); }
+vec3 SpecularTexel() { return vec3(texture(specularArray, vec3(TexCoord, MaterialLayer))); }
+#else
+uniform sampler2D diffuse0; 
+uniform sampler2D specular0; 
+
+vec3 DiffuseTexel() { return vec3(texture(diffuse0, TexCoord)); }
+vec3 SpecularTexel() { return vec3(texture(specular0, TexCoord)); }
+#endif
+
+//Unit normal folded onto the octahedron and flattened to [-1, 1]^2, the lower half mirrored over the diagonals
+vec2 OctahedronEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : folded;
+}
+
+void main()
+{
+    //Specular maps are grey, one channel of intensity is all the lighting needs
+    vec3 specular = SpecularTexel();
+    gAlbedoSpecular = vec4(DiffuseTexel(), (specular.r + specular.g + specular.b) / 3.0);
+    gNormal = OctahedronEncode(normalize(Normal)) * 0.5 + 0.5;
+}
\ No newline at end of file
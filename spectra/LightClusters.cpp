@@ -0,0 +1,261 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+//Same test as Frustum.cpp for whether SSE can be assumed
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CLUSTERS_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+LightClusters::LightClusters(ThreadPool& pool) : pool(pool), lists(CLUSTER_COUNT), ranges(CLUSTER_COUNT)
+{
+	createBufferTexture(GL_RGBA32F, lightBuffer, lightTexture);
+	createBufferTexture(GL_RG32UI, rangeBuffer, rangeTexture);
+	createBufferTexture(GL_R16UI, indexBuffer, indexTexture);
+	//GL 3.3 only promises 65536 texels, the index list is the one that can outgrow that
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxIndices);
+}
+
+LightClusters::~LightClusters()
+{
+	finishBinning();
+}
+
+void LightClusters::createBufferTexture(GLenum format, GLuint& buffer, GLuint& texture)
+{
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::buildBounds(Camera& camera)
+{
+	float nearPlane = camera.NearPlane;
+	float farPlane = camera.FarPlane;
+	if (camera.Zoom == boundsZoom && nearPlane == boundsNear && farPlane == boundsFar && camera.Width == boundsWidth && camera.Height == boundsHeight)
+		return;
+	boundsZoom = camera.Zoom;
+	boundsNear = nearPlane;
+	boundsFar = farPlane;
+	boundsWidth = camera.Width;
+	boundsHeight = camera.Height;
+
+	//Slice k starts at near * (far / near)^(k / GRID_Z), the shader inverts that with one log
+	float logRatio = std::log(farPlane / nearPlane);
+	sliceScale = GRID_Z / logRatio;
+	sliceBias = GRID_Z * std::log(nearPlane) / logRatio;
+	sliceDepths.resize(GRID_Z + 1);
+	for (unsigned int k = 0; k <= GRID_Z; ++k)
+		sliceDepths[k] = nearPlane * std::pow(farPlane / nearPlane, (float)k / GRID_Z);
+
+	//Tiles are whole pixels, the last column and row may reach past the screen
+	float tileWidth = std::ceil((float)camera.Width / GRID_X);
+	float tileHeight = std::ceil((float)camera.Height / GRID_Y);
+	tileScale = glm::vec2(1.0f / tileWidth, 1.0f / tileHeight);
+	float tanHalf = std::tan(glm::radians(camera.Zoom) * 0.5f);
+	float aspect = (float)camera.Width / (float)camera.Height;
+
+	//Padding lanes get an inverted box no sphere touches
+	size_t count = (size_t)GRID_Z * PADDED_TILES;
+	minX.assign(count, FLT_MAX); minY.assign(count, FLT_MAX); minZ.assign(count, FLT_MAX);
+	maxX.assign(count, -FLT_MAX); maxY.assign(count, -FLT_MAX); maxZ.assign(count, -FLT_MAX);
+	for (unsigned int k = 0; k < GRID_Z; ++k)
+	{
+		float nearDepth = sliceDepths[k], farDepth = sliceDepths[k + 1];
+		for (unsigned int y = 0; y < GRID_Y; ++y)
+		{
+			for (unsigned int x = 0; x < GRID_X; ++x)
+			{
+				//The tile's edges as the slope of the view ray, the box holds the rays between both depths
+				float left = (2.0f * x * tileWidth / camera.Width - 1.0f) * tanHalf * aspect;
+				float right = (2.0f * (x + 1) * tileWidth / camera.Width - 1.0f) * tanHalf * aspect;
+				float bottom = (2.0f * y * tileHeight / camera.Height - 1.0f) * tanHalf;
+				float top = (2.0f * (y + 1) * tileHeight / camera.Height - 1.0f) * tanHalf;
+
+				size_t i = (size_t)k * PADDED_TILES + y * GRID_X + x;
+				minX[i] = std::min(left * nearDepth, left * farDepth);
+				maxX[i] = std::max(right * nearDepth, right * farDepth);
+				minY[i] = std::min(bottom * nearDepth, bottom * farDepth);
+				maxY[i] = std::max(top * nearDepth, top * farDepth);
+				minZ[i] = nearDepth;
+				maxZ[i] = farDepth;
+			}
+		}
+	}
+}
+
+void LightClusters::Bin(Camera& camera, const std::vector<glm::vec4>& spheres)
+{
+	//The lists can't change under tasks of the last frame that are still binning
+	finishBinning();
+	buildBounds(camera);
+
+	glm::mat4 view = camera.GetViewMatrix();
+	size_t count = std::min(spheres.size(), (size_t)MAX_CLUSTERED_LIGHTS);
+	sphereX.resize(count); sphereY.resize(count); sphereZ.resize(count); sphereRadius.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		glm::vec4 center = view * glm::vec4(glm::vec3(spheres[i]), 1.0f);
+		sphereX[i] = center.x;
+		sphereY[i] = center.y;
+		sphereZ[i] = -center.z;
+		sphereRadius[i] = spheres[i].w;
+	}
+
+	//One task per thread pulling slices, the render thread takes whatever is left on Upload
+	job = std::make_shared<BinJob>();
+	job->owner = this;
+	std::shared_ptr<BinJob> current = job;
+	unsigned int taskCount = pool.Size() < GRID_Z ? pool.Size() : GRID_Z;
+	for (unsigned int t = 0; t < taskCount; ++t)
+		pool.Submit([current]() { binSlices(*current); });
+}
+
+void LightClusters::binSlices(BinJob& work)
+{
+	for (unsigned int slice = work.next++; slice < GRID_Z; slice = work.next++)
+	{
+		work.owner->binSlice(slice);
+		work.done++;
+	}
+}
+
+void LightClusters::binSlice(unsigned int slice)
+{
+	std::vector<uint16_t>* sliceLists = &lists[(size_t)slice * SLICE_TILES];
+	for (unsigned int tile = 0; tile < SLICE_TILES; ++tile)
+		sliceLists[tile].clear();
+
+	float nearDepth = sliceDepths[slice], farDepth = sliceDepths[slice + 1];
+	size_t first = (size_t)slice * PADDED_TILES;
+	for (size_t light = 0; light < sphereX.size(); ++light)
+	{
+		float x = sphereX[light], y = sphereY[light], z = sphereZ[light], radius = sphereRadius[light];
+		if (radius <= 0.0f || z + radius < nearDepth || z - radius > farDepth)
+			continue;
+		float radiusSquared = radius * radius;
+		unsigned int tile = 0;
+
+#ifdef CLUSTERS_USE_SSE
+		//Squared distance from the center to each of four boxes, per axis the larger of the two
+		//outside distances and zero
+		const __m128 zero = _mm_setzero_ps();
+		__m128 cx = _mm_set1_ps(x), cy = _mm_set1_ps(y), cz = _mm_set1_ps(z);
+		__m128 r2 = _mm_set1_ps(radiusSquared);
+		for (; tile < PADDED_TILES; tile += 4)
+		{
+			size_t i = first + tile;
+			__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[i]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&maxX[i]))), zero);
+			__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[i]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&maxY[i]))), zero);
+			__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[i]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&maxZ[i]))), zero);
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			int inside = _mm_movemask_ps(_mm_cmple_ps(distance, r2));
+			for (int lane = 0; lane < 4 && inside != 0; ++lane)
+			{
+				if ((inside & (1 << lane)) && tile + lane < SLICE_TILES)
+					sliceLists[tile + lane].push_back((uint16_t)light);
+			}
+		}
+#endif
+
+		for (; tile < SLICE_TILES; ++tile)
+		{
+			size_t i = first + tile;
+			float dx = std::max(std::max(minX[i] - x, x - maxX[i]), 0.0f);
+			float dy = std::max(std::max(minY[i] - y, y - maxY[i]), 0.0f);
+			float dz = std::max(std::max(minZ[i] - z, z - maxZ[i]), 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= radiusSquared)
+				sliceLists[tile].push_back((uint16_t)light);
+		}
+	}
+}
+
+void LightClusters::finishBinning()
+{
+	if (!job)
+		return;
+	binSlices(*job);
+	//Slices claimed by a task are only a short way from done
+	while (job->done < GRID_Z)
+		std::this_thread::yield();
+	job.reset();
+}
+
+void LightClusters::Upload(const std::vector<PointLightData>& lights)
+{
+	auto start = std::chrono::steady_clock::now();
+	finishBinning();
+	BinMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	Lights = (unsigned int)std::min(lights.size(), sphereX.size());
+	References = 0;
+	LongestList = 0;
+	Dropped = 0;
+	indices.clear();
+	for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+	{
+		const std::vector<uint16_t>& list = lists[cluster];
+		size_t room = (size_t)maxIndices - indices.size();
+		size_t count = std::min(list.size(), room);
+		ranges[cluster] = glm::uvec2((unsigned int)indices.size(), (unsigned int)count);
+		indices.insert(indices.end(), list.begin(), list.begin() + count);
+		LongestList = std::max(LongestList, (unsigned int)list.size());
+		Dropped += (unsigned int)(list.size() - count);
+	}
+	References = (unsigned int)indices.size();
+
+	//Sizes change every frame, each upload orphans the last one
+	glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max<GLsizeiptr>(Lights, 1) * sizeof(PointLightData), Lights > 0 ? lights.data() : nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, rangeBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, ranges.size() * sizeof(glm::uvec2), ranges.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max<GLsizeiptr>(indices.size(), 1) * sizeof(uint16_t), indices.empty() ? nullptr : indices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::FillBlock(LightBlock& block) const
+{
+	block.clusterSize = glm::ivec4(GRID_X, GRID_Y, GRID_Z, 0);
+	block.clusterScale = glm::vec4(tileScale, sliceScale, sliceBias);
+}
+
+void LightClusters::Bind()
+{
+	glActiveTexture(GL_TEXTURE0 + LIGHTS_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+	glActiveTexture(GL_TEXTURE0 + RANGES_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, rangeTexture);
+	glActiveTexture(GL_TEXTURE0 + INDICES_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+}
+
+void LightClusters::SetSamplers(Shader& shader)
+{
+	shader.setInt("pointLightTexels", LIGHTS_UNIT);
+	shader.setInt("clusterRanges", RANGES_UNIT);
+	shader.setInt("clusterLightIndices", INDICES_UNIT);
+}
+
+void LightClusters::Delete()
+{
+	finishBinning();
+	glDeleteTextures(1, &lightTexture);
+	glDeleteTextures(1, &rangeTexture);
+	glDeleteTextures(1, &indexTexture);
+	glDeleteBuffers(1, &lightBuffer);
+	glDeleteBuffers(1, &rangeBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	lightTexture = rangeTexture = indexTexture = 0;
+	lightBuffer = rangeBuffer = indexBuffer = 0;
+}
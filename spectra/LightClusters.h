@@ -0,0 +1,131 @@
+#ifndef LIGHT_CLUSTERS_CLASS_H
+#define LIGHT_CLUSTERS_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Camera.h"
+#include "Shader.h"
+#include "ThreadPool.h"
+#include "UniformBlocks.h"
+
+// Most point lights the clusters take, the lists index them with 16 bits
+const unsigned int MAX_CLUSTERED_LIGHTS = 4096;
+
+// One point light as five RGBA32F texels of the light buffer, FetchPointLight in FragmentShader.fs
+// reads them back. Nothing past radius is lit, the shader fades the light out before it
+struct PointLightData
+{
+	glm::vec3 position;
+	float radius;
+	glm::vec3 ambient;
+	float constant;
+	glm::vec3 diffuse;
+	float linear;
+	glm::vec3 specular;
+	float quadratic;
+	// -1 without a shadow map, otherwise tier + 4 * slot in the PointShadowAtlas
+	float shadow;
+	float pad0[3];
+};
+
+static_assert(sizeof(PointLightData) == 5 * sizeof(glm::vec4), "PointLightData is five texels of the light buffer");
+
+// Clustered forward light lists. The view frustum is cut into froxels, GRID_X by GRID_Y screen tiles
+// and GRID_Z slices spaced exponentially in view depth, and every light's sphere is tested against the
+// froxels of the slices it reaches. The lists go up in buffer textures, so a fragment walks the lights
+// binned into its froxel instead of every light in the scene.
+// Slices are binned on the pool's threads between Bin and Upload, the render thread joins in on Upload
+// and never waits on a task that hasn't started, the pool may be busy decoding textures
+class LightClusters
+{
+public:
+	static const unsigned int GRID_X = 16;
+	static const unsigned int GRID_Y = 9;
+	static const unsigned int GRID_Z = 24;
+	static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+	// Texture units of the light buffer, the per froxel ranges and the light indices
+	static const GLuint LIGHTS_UNIT = 9;
+	static const GLuint RANGES_UNIT = 10;
+	static const GLuint INDICES_UNIT = 11;
+
+	// Lights binned by the last Upload, light references over all lists, the longest list and the
+	// references that didn't fit the index buffer texture
+	unsigned int Lights = 0;
+	unsigned int References = 0;
+	unsigned int LongestList = 0;
+	unsigned int Dropped = 0;
+	// Time the render thread spent in Upload until every slice was binned
+	double BinMilliseconds = 0.0;
+
+	explicit LightClusters(ThreadPool& pool);
+
+	// Waits for slices still being binned, the pool's threads may outlive the clusters
+	~LightClusters();
+
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	// Starts binning the world space spheres, xyz center and w radius, against the froxels of camera's
+	// view out to its far plane. Returns straight away, the spheres are copied
+	void Bin(Camera& camera, const std::vector<glm::vec4>& spheres);
+	// Finishes the binning and uploads the lists with lights, which have to be in the order of the spheres
+	void Upload(const std::vector<PointLightData>& lights);
+	// Grid size and slice constants the fragment shader finds its froxel with
+	void FillBlock(LightBlock& block) const;
+	void Bind();
+	// Points the buffer samplers of shader at the units of Bind, once per program
+	static void SetSamplers(Shader& shader);
+	void Delete();
+
+private:
+	// Tiles of a slice, padded to whole groups of four for the SSE test
+	static const unsigned int SLICE_TILES = GRID_X * GRID_Y;
+	static const unsigned int PADDED_TILES = (SLICE_TILES + 3) & ~3u;
+
+	// State the tasks share, they reach the clusters only through a slice they claimed, and the
+	// owner waits for every claimed slice before it moves on or goes away
+	struct BinJob
+	{
+		LightClusters* owner = nullptr;
+		std::atomic<unsigned int> next{ 0 };
+		std::atomic<unsigned int> done{ 0 };
+	};
+
+	ThreadPool& pool;
+	// the view the froxel bounds were built for, rebuilt when any of it changes
+	float boundsZoom = 0.0f, boundsNear = 0.0f, boundsFar = 0.0f;
+	unsigned int boundsWidth = 0, boundsHeight = 0;
+	// view space froxel boxes with depth positive into the screen, PADDED_TILES per slice
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	std::vector<float> sliceDepths;
+	float sliceScale = 0.0f, sliceBias = 0.0f;
+	glm::vec2 tileScale = glm::vec2(0.0f);
+
+	// view space spheres being binned, depth positive into the screen
+	std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	// per froxel light lists, each slice is written by whichever thread claimed it
+	std::vector<std::vector<uint16_t>> lists;
+	// shared with the tasks, a task that only starts after Upload or destruction finds nothing left
+	// to claim
+	std::shared_ptr<BinJob> job;
+
+	std::vector<glm::uvec2> ranges;
+	std::vector<uint16_t> indices;
+	GLint maxIndices = 0;
+	GLuint lightBuffer = 0, lightTexture = 0;
+	GLuint rangeBuffer = 0, rangeTexture = 0;
+	GLuint indexBuffer = 0, indexTexture = 0;
+
+	void buildBounds(Camera& camera);
+	static void binSlices(BinJob& work);
+	void binSlice(unsigned int slice);
+	void finishBinning();
+	static void createBufferTexture(GLenum format, GLuint& buffer, GLuint& texture);
+};
+#endif
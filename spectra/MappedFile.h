@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_CLASS_H
+#define MAPPED_FILE_CLASS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// A file mapped read-only into the address space. Pages are read in by the OS as they are
+// touched, so handing Data() to the driver uploads straight from the page cache with no copy
+// into a buffer of our own
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	// Owns the mapping, moves hand it over and copies are not allowed
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// Maps the whole file, false when it can't be opened or is empty
+	bool Open(const std::string& path);
+	void Close();
+
+	const uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	// HANDLEs of the file and of its mapping object
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
+#endif
@@ -0,0 +1,382 @@
+#include "MaterialLibrary.h"
+#include "TextureManager.h"
+#include "VirtualFileSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+MaterialLibrary::MaterialLibrary(ThreadPool* pool, TextureStreamer* streamer) : pool(pool), streamer(streamer)
+{
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+	Delete();
+}
+
+unsigned int MaterialLibrary::Add(const std::string& dir, const char* diffuseImage, const char* specularImage)
+{
+	std::string diffusePath = diffuseImage != nullptr ? TextureManager::CanonicalPath(dir + '/' + diffuseImage) : std::string();
+	std::string specularPath = specularImage != nullptr ? TextureManager::CanonicalPath(dir + '/' + specularImage) : std::string();
+
+	//Models reference the same pair of maps from many materials, they all get one layer
+	std::string key = diffusePath + '|' + specularPath;
+	auto existing = materialKeys.find(key);
+	if (existing != materialKeys.end())
+	{
+		Hits++;
+		return existing->second;
+	}
+	Misses++;
+
+	//An absent diffuse map shows grey and an absent specular map no highlights
+	PendingMaterial entry;
+	entry.material = (unsigned int)materials.size();
+	entry.diffuse = addMap("diffuse", diffusePath, glm::u8vec4(128, 128, 128, 255));
+	entry.specular = addMap("specular", specularPath, glm::u8vec4(0, 0, 0, 255));
+	pending.push_back(std::move(entry));
+	materials.push_back(Material());
+	materialKeys[key] = (unsigned int)materials.size() - 1;
+	return (unsigned int)materials.size() - 1;
+}
+
+std::shared_ptr<const MaterialLibrary::Map> MaterialLibrary::addMap(const std::string& role, const std::string& path, glm::u8vec4 fallback)
+{
+	//The fallback colour depends on the role, so a file used both ways is two entries
+	std::string key = role + '|' + path;
+	auto existing = maps.find(key);
+	if (existing != maps.end())
+		return existing->second;
+
+	std::shared_ptr<Map> map = std::make_shared<Map>();
+	map->info = probe(path, fallback);
+	//Blocks of a .dds and one texel maps need no work, without a pool the decode waits for Build
+	MapInfo info = map->info;
+	if (pool != nullptr && info.compressedFormat == 0 && !info.path.empty())
+		map->image = pool->Submit([info]() { return prepare(info); }).share();
+	else
+		map->image = std::async(std::launch::deferred, [info]() { return prepare(info); }).share();
+	maps[key] = map;
+	return map;
+}
+
+MaterialLibrary::MapInfo MaterialLibrary::probe(const std::string& path, glm::u8vec4 fallback)
+{
+	MapInfo info;
+	info.fallback = fallback;
+	if (path.empty())
+		return info;
+
+	std::string compressedPath = TextureManager::CompressedPath(path);
+	if (!compressedPath.empty())
+	{
+		info.file = VirtualFileSystem::Open(compressedPath);
+		if (info.file.Valid() && ParseDDS(info.file.Data(), info.file.Size(), info.compressed, compressedPath))
+		{
+			info.compressedFormat = TextureManager::CompressedFormat(info.compressed.format);
+			if (info.compressedFormat != 0)
+			{
+				info.path = path;
+				info.width = info.compressed.width;
+				info.height = info.compressed.height;
+				info.levels = (GLsizei)info.compressed.levels.size();
+				return info;
+			}
+		}
+		info.file = ResourceFile();
+		info.compressed = DDSImage();
+	}
+
+	//Only the header, the pixels are decoded on a worker
+	ResourceFile file = VirtualFileSystem::Open(path);
+	int width = 0, height = 0, channels = 0;
+	if (!file.Valid() || !stbi_info_from_memory(file.Data(), (int)file.Size(), &width, &height, &channels))
+	{
+		std::cout << "Failed to load texture " << path << std::endl;
+		return info;
+	}
+	info.path = path;
+	info.width = width;
+	info.height = height;
+	int size = std::max(width, height);
+	while (size > 1)
+	{
+		size >>= 1;
+		info.levels++;
+	}
+	return info;
+}
+
+LayerImage MaterialLibrary::prepare(const MapInfo& info)
+{
+	LayerImage image;
+	if (info.compressedFormat != 0)
+	{
+		//The levels view the mapped file, which the image keeps open
+		image.compressedFormat = info.compressedFormat;
+		image.storage = std::make_shared<ResourceFile>(info.file);
+		for (const DDSImage::Level& level : info.compressed.levels)
+			image.levels.push_back({ (GLsizei)level.width, (GLsizei)level.height, info.compressed.Blocks() + level.offset, (GLsizeiptr)level.size });
+		return image;
+	}
+
+	//Every level goes into one allocation, the chain is built here instead of with glGenerateMipmap
+	//so a finished layer doesn't regenerate the mips of the whole array
+	std::vector<size_t> offsets;
+	size_t total = 0;
+	for (GLsizei level = 0; level < info.levels; ++level)
+	{
+		offsets.push_back(total);
+		total += (size_t)std::max(1, info.width >> level) * std::max(1, info.height >> level) * 4;
+	}
+	std::shared_ptr<std::vector<unsigned char>> pixels = std::make_shared<std::vector<unsigned char>>(total);
+	unsigned char* base = pixels->data();
+
+	DecodedImage decoded;
+	if (!info.path.empty())
+		decoded = TextureStreamer::Decode(info.path);
+	size_t texels = (size_t)info.width * info.height;
+	if (decoded.pixels && decoded.width == info.width && decoded.height == info.height)
+	{
+		//Layers of one array share a format, so everything goes to RGBA the same way GL widens
+		//a GL_RED or GL_RGB upload: missing colour channels read 0 and missing alpha reads 1
+		const unsigned char* source = decoded.pixels.get();
+		for (size_t i = 0; i < texels; ++i, source += decoded.channels)
+		{
+			unsigned char* texel = base + i * 4;
+			for (int c = 0; c < 4; ++c)
+				texel[c] = c < decoded.channels ? source[c] : (c == 3 ? 255 : 0);
+		}
+	}
+	else
+	{
+		if (!info.path.empty())
+			std::cout << "Failed to load texture " << info.path << std::endl;
+		for (size_t i = 0; i < texels; ++i)
+			memcpy(base + i * 4, &info.fallback[0], 4);
+	}
+	decoded.pixels.reset();
+
+	//Box filter, an odd edge reuses its last row or column
+	GLsizei width = info.width, height = info.height;
+	for (GLsizei level = 1; level < info.levels; ++level)
+	{
+		const unsigned char* source = base + offsets[level - 1];
+		unsigned char* target = base + offsets[level];
+		GLsizei newWidth = std::max(1, width / 2), newHeight = std::max(1, height / 2);
+		for (GLsizei y = 0; y < newHeight; ++y)
+		{
+			GLsizei y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			for (GLsizei x = 0; x < newWidth; ++x)
+			{
+				GLsizei x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; ++c)
+				{
+					int sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c] +
+						source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+					target[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		width = newWidth;
+		height = newHeight;
+	}
+
+	width = info.width;
+	height = info.height;
+	for (GLsizei level = 0; level < info.levels; ++level)
+	{
+		GLsizei levelWidth = std::max(1, width >> level), levelHeight = std::max(1, height >> level);
+		image.levels.push_back({ levelWidth, levelHeight, base + offsets[level], (GLsizeiptr)levelWidth * levelHeight * 4 });
+	}
+	image.storage = pixels;
+	return image;
+}
+
+void MaterialLibrary::Build()
+{
+	if (pending.empty())
+		return;
+
+	//Null pointers below are data, not offsets into a bound unpack buffer
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTexture);
+
+	if (arrays.empty())
+		createPlaceholder();
+
+	//Materials whose maps match in size and format become layers of the same array pair, the
+	//headers are all it takes to know
+	std::map<std::array<GLint, 8>, std::vector<size_t>> groups;
+	for (size_t i = 0; i < pending.size(); ++i)
+	{
+		const MapInfo& diffuse = pending[i].diffuse->info;
+		const MapInfo& specular = pending[i].specular->info;
+		std::array<GLint, 8> key = { (GLint)diffuse.compressedFormat, diffuse.width, diffuse.height, diffuse.levels,
+			(GLint)specular.compressedFormat, specular.width, specular.height, specular.levels };
+		groups[key].push_back(i);
+	}
+
+	for (auto& group : groups)
+	{
+		const PendingMaterial& first = pending[group.second.front()];
+		MaterialArray array;
+		array.layers = (GLsizei)group.second.size();
+		array.diffuse = createArray(first.diffuse->info, array.layers);
+		array.specular = createArray(first.specular->info, array.layers);
+		unsigned int arrayIndex = (unsigned int)arrays.size();
+		arrays.push_back(array);
+
+		for (size_t layer = 0; layer < group.second.size(); ++layer)
+		{
+			const PendingMaterial& entry = pending[group.second[layer]];
+			Material resident;
+			resident.array = arrayIndex;
+			resident.layer = (GLint)layer;
+			if (streamer != nullptr)
+			{
+				//The material moves off the placeholder once both of its layers have arrived
+				std::shared_ptr<int> layersLeft = std::make_shared<int>(2);
+				unsigned int material = entry.material;
+				auto onResident = [this, material, resident, layersLeft]()
+				{
+					if (--*layersLeft > 0)
+						return;
+					materials[material] = resident;
+					streaming--;
+				};
+				streamer->LoadLayer(array.diffuse, resident.layer, entry.diffuse->image, onResident);
+				streamer->LoadLayer(array.specular, resident.layer, entry.specular->image, onResident);
+				streaming++;
+			}
+			else
+			{
+				uploadLayer(array.diffuse, resident.layer, entry.diffuse->image.get());
+				uploadLayer(array.specular, resident.layer, entry.specular->image.get());
+				materials[entry.material] = resident;
+			}
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, previousTexture);
+	boundArray = -1;
+	pending.clear();
+	maps.clear();
+}
+
+GLuint MaterialLibrary::createArray(const MapInfo& info, GLsizei layers)
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	//Storage for every level of every layer, the layers fill in as their images arrive
+	for (GLsizei level = 0; level < info.levels; ++level)
+	{
+		GLsizei width = std::max(1, info.width >> level), height = std::max(1, info.height >> level);
+		if (info.compressedFormat != 0)
+		{
+			GLsizei levelSize = (GLsizei)info.compressed.levels[level].size;
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, info.compressedFormat, width, height, layers, 0,
+				levelSize * layers, nullptr);
+			residentBytes += (size_t)levelSize * layers;
+		}
+		else
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			residentBytes += (size_t)width * height * 4 * layers;
+		}
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, info.levels - 1);
+	return texture;
+}
+
+void MaterialLibrary::uploadLayer(GLuint texture, GLint layer, const LayerImage& image)
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	for (size_t level = 0; level < image.levels.size(); ++level)
+	{
+		const LayerImage::Level& data = image.levels[level];
+		if (image.compressedFormat != 0)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, layer, data.width, data.height, 1,
+				image.compressedFormat, (GLsizei)data.size, data.data);
+		else
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, layer, data.width, data.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data.data);
+	}
+}
+
+void MaterialLibrary::createPlaceholder()
+{
+	MapInfo grey, black;
+	grey.fallback = glm::u8vec4(128, 128, 128, 255);
+	MaterialArray placeholder;
+	placeholder.layers = 1;
+	placeholder.diffuse = createArray(grey, 1);
+	uploadLayer(placeholder.diffuse, 0, prepare(grey));
+	placeholder.specular = createArray(black, 1);
+	uploadLayer(placeholder.specular, 0, prepare(black));
+	arrays.push_back(placeholder);
+}
+
+void MaterialLibrary::SetSamplers(Shader& shader)
+{
+	shader.setInt("diffuseArray", DIFFUSE_UNIT);
+	shader.setInt("specularArray", SPECULAR_UNIT);
+}
+
+void MaterialLibrary::Bind(unsigned int material)
+{
+	const Material& entry = materials[material];
+	if (entry.array >= arrays.size())
+		return;
+
+	if (boundArray != (int)entry.array)
+	{
+		const MaterialArray& array = arrays[entry.array];
+		glActiveTexture(GL_TEXTURE0 + DIFFUSE_UNIT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array.diffuse);
+		glActiveTexture(GL_TEXTURE0 + SPECULAR_UNIT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array.specular);
+		boundArray = (int)entry.array;
+		Binds++;
+	}
+	// with its array disabled the attribute reads this value for every vertex and instance
+	glVertexAttribI4i(LAYER_ATTRIBUTE, entry.layer, 0, 0, 0);
+}
+
+void MaterialLibrary::BeginFrame()
+{
+	boundArray = -1;
+	Binds = 0;
+}
+
+void MaterialLibrary::Delete()
+{
+	for (MaterialArray& array : arrays)
+	{
+		//Layers still streaming would otherwise land in recycled texture names
+		if (streamer != nullptr)
+		{
+			streamer->Cancel(array.diffuse);
+			streamer->Cancel(array.specular);
+		}
+		glDeleteTextures(1, &array.diffuse);
+		glDeleteTextures(1, &array.specular);
+	}
+	arrays.clear();
+	pending.clear();
+	maps.clear();
+	materials.clear();
+	materialKeys.clear();
+	residentBytes = 0;
+	streaming = 0;
+	boundArray = -1;
+}
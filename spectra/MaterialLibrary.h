@@ -0,0 +1,139 @@
+#ifndef MATERIAL_LIBRARY_CLASS_H
+#define MATERIAL_LIBRARY_CLASS_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <unordered_map>
+
+#include "Shader.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include "DDSFile.h"
+#include "VirtualFileSystem.h"
+
+// A material is a layer in a pair of texture arrays, diffuse and specular. Materials whose maps
+// have the same sizes and formats share one pair, so switching between them costs no texture
+// binds, only the layer index, which Bind sets as a constant of the layer attribute for the draw.
+struct Material
+{
+	// index of the array pair and the layer in it, the placeholder until the layers are resident
+	unsigned int array = 0;
+	GLint layer = 0;
+};
+
+// Diffuse and specular arrays with the same number of layers
+struct MaterialArray
+{
+	GLuint diffuse = 0;
+	GLuint specular = 0;
+	GLsizei layers = 0;
+};
+
+class MaterialLibrary
+{
+public:
+	// Sampler units of the two arrays and the vertex attribute that carries the layer
+	static const GLuint DIFFUSE_UNIT = 0;
+	static const GLuint SPECULAR_UNIT = 1;
+	static const GLuint LAYER_ATTRIBUTE = 8;
+	// One texel pair, grey without highlights, shown by materials whose layers are still streaming
+	static const unsigned int PLACEHOLDER_ARRAY = 0;
+
+	// Array binds since the last BeginFrame, one per switch between array pairs
+	unsigned int Binds = 0;
+	// Adds served by a material with the same maps and adds that queued a new one
+	unsigned int Hits = 0;
+	unsigned int Misses = 0;
+
+	// Maps are decoded on pool's workers when given, otherwise by Build. With a streamer the layers
+	// go up a slice at a time through its pixel buffers, otherwise Build uploads them
+	explicit MaterialLibrary(ThreadPool* pool = nullptr, TextureStreamer* streamer = nullptr);
+	~MaterialLibrary();
+
+	MaterialLibrary(const MaterialLibrary&) = delete;
+	MaterialLibrary& operator=(const MaterialLibrary&) = delete;
+
+	// Queues a material unless one with the same maps, by canonical path, was added before. A
+	// transcoded .dds next to an image is used in its place, a null image gives a one texel map:
+	// grey for diffuse, black for specular. Only the headers are read here, a map shared between
+	// materials is decoded once
+	unsigned int Add(const std::string& dir, const char* diffuseImage, const char* specularImage);
+	// Packs every material added since the last Build into arrays. With a streamer it returns right
+	// away and each material shows the placeholder until both its layers are resident, otherwise
+	// it waits for the decodes and uploads
+	void Build();
+
+	// Points the sampler uniforms of shader at the array units, once per program
+	static void SetSamplers(Shader& shader);
+	// Binds material's arrays unless they already are and makes its layer the constant
+	// value of the layer attribute for the following draws
+	void Bind(unsigned int material);
+	// Forgets which arrays are bound and resets Binds, call once per frame
+	void BeginFrame();
+
+	const Material& Get(unsigned int material) const { return materials[material]; }
+	unsigned int Count() const { return (unsigned int)materials.size(); }
+	unsigned int ArrayCount() const { return (unsigned int)arrays.size(); }
+	size_t ResidentBytes() const { return residentBytes; }
+	// Materials still showing the placeholder
+	unsigned int Streaming() const { return streaming; }
+
+	void Delete();
+
+private:
+	// Size and format of a map as its header gives them, what materials are grouped into arrays by
+	struct MapInfo
+	{
+		// the image to decode, empty for a one texel map of fallback
+		std::string path;
+		glm::u8vec4 fallback = glm::u8vec4(0, 0, 0, 255);
+		// 0 for RGBA8, decoded and widened on a worker
+		GLenum compressedFormat = 0;
+		GLsizei width = 1;
+		GLsizei height = 1;
+		GLsizei levels = 1;
+		// the mapped .dds of a compressed map, its blocks upload as they are
+		ResourceFile file;
+		DDSImage compressed;
+	};
+
+	struct Map
+	{
+		MapInfo info;
+		std::shared_future<LayerImage> image;
+	};
+
+	struct PendingMaterial
+	{
+		unsigned int material;
+		std::shared_ptr<const Map> diffuse;
+		std::shared_ptr<const Map> specular;
+	};
+
+	ThreadPool* pool;
+	TextureStreamer* streamer;
+	std::vector<Material> materials;
+	std::vector<MaterialArray> arrays;
+	std::vector<PendingMaterial> pending;
+	// materials by their canonical map paths
+	std::unordered_map<std::string, unsigned int> materialKeys;
+	// maps of the pending materials by role and canonical path
+	std::unordered_map<std::string, std::shared_ptr<const Map>> maps;
+	size_t residentBytes = 0;
+	unsigned int streaming = 0;
+	// array pair bound to the units, -1 when unknown
+	int boundArray = -1;
+
+	std::shared_ptr<const Map> addMap(const std::string& role, const std::string& path, glm::u8vec4 fallback);
+	// Reads the header of the map at path, or of the .dds texconv wrote for it
+	static MapInfo probe(const std::string& path, glm::u8vec4 fallback);
+	// Every level of the map, decoded and with its mip chain built unless it is a .dds
+	static LayerImage prepare(const MapInfo& info);
+	GLuint createArray(const MapInfo& info, GLsizei layers);
+	static void uploadLayer(GLuint texture, GLint layer, const LayerImage& image);
+	void createPlaceholder();
+};
+#endif
@@ -1,78 +1,172 @@
 #include "Mesh.h"
-#include "Mesh.h"
 
-Mesh::Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::vector <Texture>& textures)
+Mesh::Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::vector <Texture>&& textures, const VertexLayout& layout)
 {
-	Mesh::vertices = vertices;
-	Mesh::indices = indices;
-	Mesh::textures = textures;
+	Mesh::textures = std::move(textures);
+	lods.push_back({ 0, (GLsizei)indices.size() });
+
+	// Keep track of how many of each type of textures we have
+	unsigned int numDiffuse = 0;
+	unsigned int numSpecular = 0;
+
+	for (unsigned int i = 0; i < Mesh::textures.size(); i++)
+	{
+		std::string num;
+		std::string type = Mesh::textures[i].type;
+		if (type == "diffuse")
+		{
+			num = std::to_string(numDiffuse++);
+		}
+		else if (type == "specular")
+		{
+			num = std::to_string(numSpecular++);
+		}
+
+		textureUniforms.push_back(Uniform<int>(type + num));
+	}
 
 	VAO.Bind();
-	// Generates Vertex Buffer Object and links it to vertices
-	VBO VBO(vertices);
+	// Encodes the vertices per the layout and links each stream's buffer to its attributes
+	std::vector<std::vector<unsigned char>> streamData = layout.Pack(vertices);
+	vertexBuffers.reserve(streamData.size());
+	for (size_t i = 0; i < streamData.size(); i++)
+	{
+		vertexBuffers.push_back(VBO(streamData[i]));
+		VAO.LinkStream(vertexBuffers.back(), layout.streams[i]);
+	}
 	// Generates Element Buffer Object and links it to indices
-	EBO EBO(indices);
-
-	//Position attribute
-	VAO.LinkAttrib(VBO, 0, 3, GL_FLOAT, sizeof(Vertex), (void*)0);
-	//Normal attribute
-	VAO.LinkAttrib(VBO, 1, 3, GL_FLOAT, sizeof(Vertex), (void*)(3 * sizeof(float)));
-	//Color attribute
-	VAO.LinkAttrib(VBO, 2, 3, GL_FLOAT, sizeof(Vertex), (void*)(6 * sizeof(float)));
-	//Texture attribute
-	VAO.LinkAttrib(VBO, 3, 2, GL_FLOAT, sizeof(Vertex), (void*)(9 * sizeof(float)));
+	indexBuffer = EBO(indices);
 
 	// Unbind all to prevent accidentally modifying them
 	VAO.Unbind();
-	VBO.Unbind();
-	EBO.Unbind();
+	indexBuffer.Unbind();
+
+	calculateBoundingBox(vertices);
+}
+
+Mesh::Mesh(const VertexLayout& layout, const std::vector<const void*>& streams, GLsizei vertexCount,
+	const void* indexData, GLsizei indexCount, GLenum indexType, const std::vector<MeshLod>& lods,
+	const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	: indexType(indexType), lods(lods)
+{
+	VAO.Bind();
+	vertexBuffers.reserve(layout.streams.size());
+	for (size_t i = 0; i < layout.streams.size(); i++)
+	{
+		vertexBuffers.push_back(VBO(streams[i], (GLsizeiptr)vertexCount * layout.streams[i].stride));
+		VAO.LinkStream(vertexBuffers.back(), layout.streams[i]);
+	}
+	GLsizeiptr indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	indexBuffer = EBO(indexData, indexCount * indexSize);
 
-	calculateBoundingBox(this);
+	VAO.Unbind();
+	indexBuffer.Unbind();
+
+	minX = boundsMin.x;
+	minY = boundsMin.y;
+	minZ = boundsMin.z;
+	maxX = boundsMax.x;
+	maxY = boundsMax.y;
+	maxZ = boundsMax.z;
+	boundingBox = BoundingBox(
+		(boundsMin + boundsMax) / 2.0f,
+		maxX - minX, maxY - minY, maxZ - minZ, minX, minY, minZ, maxX, maxY, maxZ
+	);
 }
 
 
+void Mesh::Delete()
+{
+	VAO.Delete();
+	for (VBO& vertexBuffer : vertexBuffers)
+		vertexBuffer.Delete();
+	indexBuffer.Delete();
+	for (Texture& texture : textures)
+		texture.Delete();
+}
+
 void Mesh::Draw(Shader& shader)
 {
 	// Bind shader to be able to access uniforms
 	shader.Activate();
 	VAO.Bind();
+	BindMaterial(shader);
 
-	// Keep track of how many of each type of textures we have
-	unsigned int numDiffuse = 0;
-	unsigned int numSpecular = 0;
+	// Draw the actual mesh
+	DrawElements();
+}
 
-	for (unsigned int i = 0; i < textures.size(); i++)
+void Mesh::DrawInstanced(Shader& shader, GLsizei instanceCount)
+{
+	shader.Activate();
+	VAO.Bind();
+	BindMaterial(shader);
+	//No instances draws nothing, DrawElements would take 0 for a single draw
+	if (instanceCount > 0)
+		DrawElements(instanceCount);
+}
+
+void Mesh::BindMaterial(Shader& shader)
+{
+	if (materialLibrary != nullptr)
+		materialLibrary->Bind(material);
+	else
 	{
-		std::string num;
-		std::string type = textures[i].type;
-		if (type == "diffuse")
-		{
-			num = std::to_string(numDiffuse++);
-		}
-		else if (type == "specular")
+		for (unsigned int i = 0; i < textures.size(); i++)
 		{
-			num = std::to_string(numSpecular++);
+			//New Texture Unit
+			textures[i].TextureUnit(shader, textureUniforms[i], i);
+			textures[i].Bind();
 		}
-
-		//New Texture Unit
-		textures[i].TextureUnit(shader, (type + num).c_str(), i);
-		textures[i].Bind();
 	}
+}
 
-	// Draw the actual mesh
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+void Mesh::DrawElements(GLsizei instanceCount) const
+{
+	const MeshLod& range = lods[lod];
+	if (instanceCount > 0)
+		glDrawElementsInstanced(GL_TRIANGLES, range.indexCount, indexType, indexOffset(range), instanceCount);
+	else
+		glDrawElements(GL_TRIANGLES, range.indexCount, indexType, indexOffset(range));
+}
+
+void Mesh::SetInstanceBuffer(VBO& instanceVBO, GLuint layout, GLintptr offset)
+{
+	VAO.Bind();
+	VAO.LinkInstanceMat4(instanceVBO, layout, offset);
+	VAO.Unbind();
+}
+
+void Mesh::SetMaterial(MaterialLibrary* library, unsigned int materialIndex)
+{
+	materialLibrary = library;
+	material = materialIndex;
+}
+
+void Mesh::SetLod(unsigned int level)
+{
+	lod = std::min(level, (unsigned int)lods.size() - 1);
 }
 
-void Mesh::SetMeshProperties(Shader& shader, Camera& cam, glm::vec3& position, glm::vec3& rotation, glm::vec3& scale)
+const void* Mesh::indexOffset(const MeshLod& range) const
 {
+	return (const void*)((size_t)range.firstIndex * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+}
+
+void Mesh::SetMeshProperties(Shader& shader, glm::vec3& position, glm::vec3& rotation, glm::vec3& scale)
+{
+	static const Uniform<glm::mat4> modelUniform("model");
+
 	//Activate Shader
 	shader.Activate();
-	shader.setVec3("viewPos", cam.Position);
 
-	cam.UpdateCameraMatrix(shader);
+	Position = position;
+	shader.setUniform(modelUniform, ModelMatrix(position, rotation, scale));
+}
 
+glm::mat4 Mesh::ModelMatrix(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
+{
 	glm::mat4 meshMat = glm::mat4(1.0f);
-	Position = position;
 	meshMat = glm::translate(meshMat, position);	
 
 	meshMat = glm::rotate(meshMat, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)); // Rotate around x-axis
@@ -81,5 +175,5 @@ void Mesh::SetMeshProperties(Shader& shader, Camera& cam, glm::vec3& position, g
 
 	meshMat = glm::scale(meshMat, scale);
 
-	shader.setMat4("model", meshMat);
+	return meshMat;
 }
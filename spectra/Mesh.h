@@ -7,40 +7,58 @@
 #include "EBO.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "MaterialLibrary.h"
 #include "BoundingBox.h"
 
+// A range of the index buffer drawn as one level of detail, level 0 is the whole mesh
+struct MeshLod
+{
+	GLuint firstIndex;
+	GLsizei indexCount;
+};
+
 class Mesh
 {
 public:
-	std::vector <Vertex> vertices;
-	std::vector <GLuint> indices;
 	std::vector <Texture> textures;
     glm::vec3 Position;
 	// Store VAO in public so it can be used in the Draw function
 	VAO VAO;
 
-	// Initializes the mesh
-	Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::vector <Texture>& textures);
-
-    void calculateBoundingBox(Mesh* mesh) {
+	// Initializes the mesh, the textures are moved in since the mesh owns them from here on.
+	// The layout decides how the vertices are encoded on the GPU
+	Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::vector <Texture>&& textures,
+		const VertexLayout& layout = VertexLayout::Compact());
+	// Uploads vertex streams already encoded for layout and indices of indexType straight from
+	// memory, e.g. a mapped mesh file, without staging them in vectors first. One stream pointer
+	// per layout stream, lods index into the index data
+	Mesh(const VertexLayout& layout, const std::vector<const void*>& streams, GLsizei vertexCount,
+		const void* indexData, GLsizei indexCount, GLenum indexType, const std::vector<MeshLod>& lods,
+		const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	// Owns its GPU buffers and textures, pass it by reference to draw and move it to transfer it
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
+
+	// Frees the buffers and textures now instead of at destruction, e.g. before the context goes away
+	void Delete();
+
+    void calculateBoundingBox(const std::vector<Vertex>& vertices) {
         // Calculate the minimum and maximum extents of the model
         // ...
 
-        for (unsigned int i = 0; i < mesh->vertices.size(); i++)
+        for (unsigned int i = 0; i < vertices.size(); i++)
         {
-            minX = std::min(minX, mesh->vertices[i].position.x);
-            maxX = std::max(maxX, mesh->vertices[i].position.x);
-            minY = std::min(minY, mesh->vertices[i].position.y);
-            maxY = std::max(maxY, mesh->vertices[i].position.y);
-            minZ = std::min(minZ, mesh->vertices[i].position.z);
-            maxZ = std::max(maxZ, mesh->vertices[i].position.z);
+            minX = std::min(minX, vertices[i].position.x);
+            maxX = std::max(maxX, vertices[i].position.x);
+            minY = std::min(minY, vertices[i].position.y);
+            maxY = std::max(maxY, vertices[i].position.y);
+            minZ = std::min(minZ, vertices[i].position.z);
+            maxZ = std::max(maxZ, vertices[i].position.z);
         }
 
-        std::cout << mesh << std::endl;
-        std::cout << "X: (" << minX << ", " << maxX << ") " 
-                  << "Y: (" << minY << ", " << maxY << ") " 
-                  << "Z: (" << minZ << ", " << maxZ << ") " << std::endl;
-
         // Calculate the center, width, height, and depth of the bounding box
         boundingBox = BoundingBox(
             glm::vec3((minX + maxX) / 2.0f, (minY + maxY) / 2.0f, (minZ + maxZ) / 2.0f),
@@ -56,10 +74,6 @@ public:
         maxY *= scale.y;
         minZ *= scale.z;
         maxZ *= scale.z;
-        
-        std::cout << "X: (" << minX << ", " << maxX << ") "
-            << "Y: (" << minY << ", " << maxY << ") "
-            << "Z: (" << minZ << ", " << maxZ << ") " << std::endl;
 
         // Calculate the center, width, height, and depth of the bounding box
         boundingBox = BoundingBox(
@@ -70,17 +84,51 @@ public:
 
 	// Draws the mesh
 	void Draw(Shader& shader);
+	// Draws instanceCount copies in one call, each placed by the instance buffer
+	void DrawInstanced(Shader& shader, GLsizei instanceCount);
+	// The two halves of a draw for callers that track the bound program and vertex array themselves,
+	// see RenderQueue. BindMaterial binds the material or the mesh's own textures, DrawElements only
+	// issues the draw call, instanced when instanceCount isn't 0
+	void BindMaterial(Shader& shader);
+	void DrawElements(GLsizei instanceCount = 0) const;
+	MaterialLibrary* GetMaterialLibrary() const { return materialLibrary; }
+	unsigned int GetMaterial() const { return material; }
+	// Attaches a buffer of per-instance model matrices at locations layout to layout + 3,
+	// the first instance reading the matrix offset bytes in
+	void SetInstanceBuffer(VBO& instanceVBO, GLuint layout = 4, GLintptr offset = 0);
+	// Draws with a material from library instead of the mesh's own textures
+	void SetMaterial(MaterialLibrary* library, unsigned int materialIndex);
+	// Level of detail the draws use, clamped to the coarsest one the mesh has
+	void SetLod(unsigned int level);
+	unsigned int LodCount() const { return (unsigned int)lods.size(); }
 
     BoundingBox GetMeshBoundingBox()
     {
         return boundingBox;
     }
 
-    void SetMeshProperties(Shader& shader, Camera& cam, glm::vec3& position, glm::vec3& rotation, glm::vec3& scale);
+    // Sets the model matrix, camera data comes from the per-frame FrameData block
+    void SetMeshProperties(Shader& shader, glm::vec3& position, glm::vec3& rotation, glm::vec3& scale);
+    // Translation, then x/y/z rotation in degrees, then scale
+    static glm::mat4 ModelMatrix(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale);
 
 private:
 
     BoundingBox boundingBox;
+    // one vertex buffer per layout stream plus the index buffer, all referenced by the VAO
+    std::vector<VBO> vertexBuffers;
+    EBO indexBuffer;
+    GLenum indexType = GL_UNSIGNED_INT;
+    std::vector<MeshLod> lods;
+    unsigned int lod = 0;
+
+    // byte offset of a LOD's first index in the index buffer
+    const void* indexOffset(const MeshLod& range) const;
+    // sampler uniform per texture ("diffuse0", "specular0", ...), resolved once at construction
+    std::vector<Uniform<int>> textureUniforms;
+    // texture array material, when set the textures above are not bound
+    MaterialLibrary* materialLibrary = nullptr;
+    unsigned int material = 0;
 
     // Initialize minimum and maximum extents
     float minX = std::numeric_limits<float>::max();
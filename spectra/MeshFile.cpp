@@ -0,0 +1,320 @@
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+	const uint32_t MESH_FILE_MAGIC = 0x48534D53; // "SMSH"
+
+	uint64_t align16(uint64_t offset)
+	{
+		return (offset + 15) & ~(uint64_t)15;
+	}
+}
+
+bool MeshFile::Open(const std::string& path)
+{
+	file = VirtualFileSystem::Open(path);
+	if (!file.Valid())
+		return false;
+	data = file.Data();
+	size = file.Size();
+	if (!validate(path))
+	{
+		file = ResourceFile();
+		data = nullptr;
+		size = 0;
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::Open(const uint8_t* image, size_t imageSize)
+{
+	file = ResourceFile();
+	data = image;
+	size = imageSize;
+	if (!validate("(memory)"))
+	{
+		data = nullptr;
+		size = 0;
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::validate(const std::string& name) const
+{
+	if (size < sizeof(MeshFileHeader))
+		return false;
+	const MeshFileHeader& header = Header();
+	if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION)
+	{
+		std::cout << "Mesh file " << name << " is from another version, rebuilding it" << std::endl;
+		return false;
+	}
+	if (header.fileSize != size
+		|| header.meshesOffset + (uint64_t)header.meshCount * sizeof(MeshRecord) > size
+		|| header.materialsOffset + (uint64_t)header.materialCount * sizeof(MaterialRecord) > size
+		|| header.stringsOffset + header.stringBytes > size
+		|| header.normalFormat > (uint8_t)VertexFormat::Omitted || header.colorFormat > (uint8_t)VertexFormat::Omitted
+		|| header.texUVFormat > (uint8_t)VertexFormat::Omitted)
+	{
+		std::cout << "ERROR::MESH_FILE::TRUNCATED " << name << std::endl;
+		return false;
+	}
+
+	VertexLayout layout = Layout();
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		const MeshRecord& mesh = MeshAt(i);
+		bool valid = mesh.lodCount >= 1 && mesh.lodCount <= MESH_FILE_MAX_LODS
+			&& (mesh.indexSize == 2 || mesh.indexSize == 4)
+			&& mesh.materialIndex < header.materialCount
+			&& mesh.indexOffset + (uint64_t)mesh.indexCount * mesh.indexSize <= size;
+		for (size_t s = 0; valid && s < layout.streams.size(); ++s)
+			valid = mesh.streamOffsets[s] + (uint64_t)mesh.vertexCount * layout.streams[s].stride <= size;
+		for (uint32_t lod = 0; valid && lod < mesh.lodCount; ++lod)
+			valid = (uint64_t)mesh.lods[lod].firstIndex + mesh.lods[lod].indexCount <= mesh.indexCount;
+		if (!valid)
+		{
+			std::cout << "ERROR::MESH_FILE::BAD_MESH_RECORD " << name << " mesh " << i << std::endl;
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header.materialCount; ++i)
+	{
+		const MaterialRecord& material = MaterialAt(i);
+		if ((uint64_t)material.diffuseOffset + material.diffuseLength > header.stringBytes
+			|| (uint64_t)material.specularOffset + material.specularLength > header.stringBytes)
+		{
+			std::cout << "ERROR::MESH_FILE::BAD_MATERIAL_RECORD " << name << " material " << i << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+const MeshRecord& MeshFile::MeshAt(uint32_t index) const
+{
+	return ((const MeshRecord*)(data + Header().meshesOffset))[index];
+}
+
+const MaterialRecord& MeshFile::MaterialAt(uint32_t index) const
+{
+	return ((const MaterialRecord*)(data + Header().materialsOffset))[index];
+}
+
+std::string MeshFile::String(uint32_t offset, uint32_t length) const
+{
+	return std::string((const char*)data + Header().stringsOffset + offset, length);
+}
+
+VertexLayout MeshFile::Layout() const
+{
+	const MeshFileHeader& header = Header();
+	return VertexLayout((VertexFormat)header.normalFormat, (VertexFormat)header.colorFormat, (VertexFormat)header.texUVFormat,
+		header.separatePosition != 0);
+}
+
+std::string MeshFile::CachePath(const std::string& sourcePath)
+{
+	return std::filesystem::path(sourcePath).replace_extension(".mesh").string();
+}
+
+bool MeshFile::UpToDate(const std::string& cachePath, const std::string& sourcePath)
+{
+	int64_t cacheTime = VirtualFileSystem::ModifiedTime(cachePath);
+	if (cacheTime == 0)
+		return false;
+	return VirtualFileSystem::ModifiedTime(sourcePath) <= cacheTime;
+}
+
+MeshFileWriter::MeshFileWriter(const VertexLayout& layout) : layout(layout)
+{
+}
+
+MeshFileWriter::EncodedMesh MeshFileWriter::Encode(const VertexLayout& layout, const std::vector<Vertex>& vertices,
+	const std::vector<uint32_t>& indices, uint32_t materialIndex)
+{
+	EncodedMesh mesh;
+	MeshRecord& record = mesh.record;
+	record.vertexCount = (uint32_t)vertices.size();
+	record.materialIndex = materialIndex;
+
+	glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(std::numeric_limits<float>::lowest());
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+	if (vertices.empty())
+		boundsMin = boundsMax = glm::vec3(0.0f);
+	memcpy(record.boundsMin, &boundsMin[0], sizeof(record.boundsMin));
+	memcpy(record.boundsMax, &boundsMax[0], sizeof(record.boundsMax));
+
+	std::vector<std::vector<unsigned char>> streams = layout.Pack(vertices);
+	for (size_t s = 0; s < streams.size() && s < MESH_FILE_MAX_STREAMS; ++s)
+		mesh.streams[s] = std::move(streams[s]);
+
+	// LOD 0 is the mesh itself, each coarser level goes after it in the same index buffer
+	std::vector<uint32_t> allIndices = indices;
+	record.lods[0] = { 0, (uint32_t)indices.size() };
+	record.lodCount = 1;
+	size_t previousCount = indices.size();
+	for (int cellsPerSide = 64; cellsPerSide >= 4 && record.lodCount < MESH_FILE_MAX_LODS; cellsPerSide /= 4)
+	{
+		std::vector<uint32_t> coarse = cluster(vertices, indices, boundsMin, boundsMax, cellsPerSide);
+		// a level that hardly removes triangles isn't worth drawing instead of the previous one
+		if (coarse.empty() || coarse.size() * 4 > previousCount * 3)
+			continue;
+		record.lods[record.lodCount++] = { (uint32_t)allIndices.size(), (uint32_t)coarse.size() };
+		allIndices.insert(allIndices.end(), coarse.begin(), coarse.end());
+		previousCount = coarse.size();
+	}
+	record.indexCount = (uint32_t)allIndices.size();
+
+	record.indexSize = vertices.size() <= 0x10000 ? 2 : 4;
+	mesh.indices.resize(allIndices.size() * record.indexSize);
+	if (record.indexSize == 2)
+	{
+		uint16_t* out = (uint16_t*)mesh.indices.data();
+		for (size_t i = 0; i < allIndices.size(); ++i)
+			out[i] = (uint16_t)allIndices[i];
+	}
+	else
+		memcpy(mesh.indices.data(), allIndices.data(), mesh.indices.size());
+	return mesh;
+}
+
+std::vector<uint32_t> MeshFileWriter::cluster(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	const glm::vec3& boundsMin, const glm::vec3& boundsMax, int cellsPerSide)
+{
+	glm::vec3 extent = boundsMax - boundsMin;
+	float longest = std::max(extent.x, std::max(extent.y, extent.z));
+	if (longest <= 0.0f)
+		return std::vector<uint32_t>();
+	float cellSize = longest / cellsPerSide;
+
+	std::unordered_map<uint64_t, uint32_t> cells;
+	std::vector<uint32_t> remap(vertices.size());
+	for (uint32_t v = 0; v < (uint32_t)vertices.size(); ++v)
+	{
+		glm::ivec3 cell = glm::clamp(glm::ivec3((vertices[v].position - boundsMin) / cellSize), glm::ivec3(0), glm::ivec3(cellsPerSide - 1));
+		uint64_t key = (uint64_t)cell.x | ((uint64_t)cell.y << 21) | ((uint64_t)cell.z << 42);
+		remap[v] = cells.emplace(key, v).first->second;
+	}
+
+	// triangles whose corners fell into fewer than three cells disappear
+	std::vector<uint32_t> coarse;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		uint32_t a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+		if (a == b || b == c || a == c)
+			continue;
+		coarse.push_back(a);
+		coarse.push_back(b);
+		coarse.push_back(c);
+	}
+	return coarse;
+}
+
+void MeshFileWriter::AddMesh(EncodedMesh&& mesh)
+{
+	meshes.push_back(std::move(mesh));
+}
+
+void MeshFileWriter::AddMaterial(const std::string& diffuse, const std::string& specular)
+{
+	MaterialRecord material;
+	material.diffuseOffset = (uint32_t)strings.size();
+	material.diffuseLength = (uint32_t)diffuse.size();
+	strings += diffuse;
+	material.specularOffset = (uint32_t)strings.size();
+	material.specularLength = (uint32_t)specular.size();
+	strings += specular;
+	materials.push_back(material);
+}
+
+std::vector<uint8_t> MeshFileWriter::Build() const
+{
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.meshCount = (uint32_t)meshes.size();
+	header.materialCount = (uint32_t)materials.size();
+	header.normalFormat = (uint8_t)layout.normalFormat;
+	header.colorFormat = (uint8_t)layout.colorFormat;
+	header.texUVFormat = (uint8_t)layout.texUVFormat;
+	header.separatePosition = layout.separatePosition ? 1 : 0;
+	header.stringBytes = (uint32_t)strings.size();
+
+	// Records first, then the bulk data, each block starting on a 16 byte boundary
+	uint64_t offset = align16(sizeof(MeshFileHeader));
+	header.meshesOffset = offset;
+	offset = align16(offset + meshes.size() * sizeof(MeshRecord));
+	header.materialsOffset = offset;
+	offset = align16(offset + materials.size() * sizeof(MaterialRecord));
+	header.stringsOffset = offset;
+	offset = align16(offset + strings.size());
+
+	std::vector<MeshRecord> records;
+	records.reserve(meshes.size());
+	for (const EncodedMesh& mesh : meshes)
+	{
+		MeshRecord record = mesh.record;
+		for (uint32_t s = 0; s < MESH_FILE_MAX_STREAMS; ++s)
+		{
+			record.streamOffsets[s] = offset;
+			offset = align16(offset + mesh.streams[s].size());
+		}
+		record.indexOffset = offset;
+		offset = align16(offset + mesh.indices.size());
+		records.push_back(record);
+	}
+	header.fileSize = offset;
+
+	std::vector<uint8_t> image((size_t)offset, 0);
+	memcpy(image.data(), &header, sizeof(header));
+	if (!records.empty())
+		memcpy(image.data() + header.meshesOffset, records.data(), records.size() * sizeof(MeshRecord));
+	if (!materials.empty())
+		memcpy(image.data() + header.materialsOffset, materials.data(), materials.size() * sizeof(MaterialRecord));
+	memcpy(image.data() + header.stringsOffset, strings.data(), strings.size());
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		for (uint32_t s = 0; s < MESH_FILE_MAX_STREAMS; ++s)
+			memcpy(image.data() + records[i].streamOffsets[s], meshes[i].streams[s].data(), meshes[i].streams[s].size());
+		memcpy(image.data() + records[i].indexOffset, meshes[i].indices.data(), meshes[i].indices.size());
+	}
+	return image;
+}
+
+bool MeshFileWriter::Save(const std::string& path, const std::vector<uint8_t>& image)
+{
+	// written under a temporary name first, a crash halfway never leaves a truncated cache behind
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file || !file.write((const char*)image.data(), (std::streamsize)image.size()))
+		{
+			std::cout << "ERROR::MESH_FILE::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (error)
+	{
+		std::cout << "ERROR::MESH_FILE::WRITE_FAILED " << path << ": " << error.message() << std::endl;
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
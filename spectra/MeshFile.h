@@ -0,0 +1,140 @@
+#ifndef MESH_FILE_CLASS_H
+#define MESH_FILE_CLASS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "VertexLayout.h"
+#include "VirtualFileSystem.h"
+
+// Processed meshes stored exactly as they are uploaded: vertex streams already encoded for a
+// VertexLayout and index buffers ready for glDrawElements, every block 16 byte aligned. Loading
+// one is mapping the file and pointing glBufferData at it, no parsing and no copies.
+// Bump MESH_FILE_VERSION whenever a record or the encoding changes, older files are rebuilt
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_FILE_MAX_STREAMS = 2;
+const uint32_t MESH_FILE_MAX_LODS = 4;
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t meshCount;
+	uint32_t materialCount;
+	// VertexFormat values of the layout the streams are encoded with
+	uint8_t normalFormat;
+	uint8_t colorFormat;
+	uint8_t texUVFormat;
+	uint8_t separatePosition;
+	uint32_t stringBytes;
+	uint64_t meshesOffset;
+	uint64_t materialsOffset;
+	uint64_t stringsOffset;
+	uint64_t fileSize;
+};
+
+// A range of the mesh's index buffer, LOD 0 is the full mesh
+struct LodRecord
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+struct MeshRecord
+{
+	float boundsMin[3];
+	float boundsMax[3];
+	uint32_t vertexCount;
+	// indices of all LODs together
+	uint32_t indexCount;
+	// 2 when every index fits in 16 bits, otherwise 4
+	uint32_t indexSize;
+	uint32_t materialIndex;
+	uint32_t lodCount;
+	uint32_t reserved;
+	LodRecord lods[MESH_FILE_MAX_LODS];
+	uint64_t streamOffsets[MESH_FILE_MAX_STREAMS];
+	uint64_t indexOffset;
+};
+
+// Map paths relative to the model's directory, in the string table. Length 0 means no map
+struct MaterialRecord
+{
+	uint32_t diffuseOffset;
+	uint32_t diffuseLength;
+	uint32_t specularOffset;
+	uint32_t specularLength;
+};
+
+// Read access to a mesh file, either mapped from disk or viewed in memory
+class MeshFile
+{
+public:
+	// Maps path through the resource mounts and checks every record against the file size,
+	// false when it is missing, truncated or of another version
+	bool Open(const std::string& path);
+	// Views a file image in memory, which must outlive this
+	bool Open(const uint8_t* image, size_t imageSize);
+
+	const MeshFileHeader& Header() const { return *(const MeshFileHeader*)data; }
+	const MeshRecord& MeshAt(uint32_t index) const;
+	const MaterialRecord& MaterialAt(uint32_t index) const;
+	std::string String(uint32_t offset, uint32_t length) const;
+	const uint8_t* At(uint64_t offset) const { return data + offset; }
+	size_t Size() const { return size; }
+	// The layout the vertex streams were encoded with
+	VertexLayout Layout() const;
+
+	// Where the processed meshes of a source model are cached, next to it
+	static std::string CachePath(const std::string& sourcePath);
+	// False when there is no cache or the source was modified after it was written. A source
+	// that isn't there, e.g. left out of an archive, never makes the cache stale
+	static bool UpToDate(const std::string& cachePath, const std::string& sourcePath);
+
+private:
+	ResourceFile file;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+	bool validate(const std::string& name) const;
+};
+
+// Collects encoded meshes and materials and lays them out as a mesh file
+class MeshFileWriter
+{
+public:
+	// One mesh with its streams and indices in their final form
+	struct EncodedMesh
+	{
+		MeshRecord record = {};
+		std::vector<uint8_t> streams[MESH_FILE_MAX_STREAMS];
+		std::vector<uint8_t> indices;
+	};
+
+	explicit MeshFileWriter(const VertexLayout& layout);
+
+	// Packs vertices per layout, picks 16 bit indices when they fit and appends coarser LODs
+	// made by vertex clustering. Touches nothing shared, so meshes can encode on worker threads
+	static EncodedMesh Encode(const VertexLayout& layout, const std::vector<Vertex>& vertices,
+		const std::vector<uint32_t>& indices, uint32_t materialIndex);
+
+	void AddMesh(EncodedMesh&& mesh);
+	void AddMaterial(const std::string& diffuse, const std::string& specular);
+
+	// The complete file image
+	std::vector<uint8_t> Build() const;
+	static bool Save(const std::string& path, const std::vector<uint8_t>& image);
+
+private:
+	VertexLayout layout;
+	std::vector<EncodedMesh> meshes;
+	std::vector<MaterialRecord> materials;
+	std::string strings;
+
+	// Indices of a coarser version of the mesh, vertices snapped to a grid of cellsPerSide
+	// cells along the longest side are merged into the first vertex of their cell
+	static std::vector<uint32_t> cluster(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		const glm::vec3& boundsMin, const glm::vec3& boundsMax, int cellsPerSide);
+};
+#endif
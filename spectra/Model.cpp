@@ -0,0 +1,268 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Model.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <iostream>
+
+namespace
+{
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+Model::Model(const std::string& path, ThreadPool& pool, MaterialLibrary& materials)
+{
+	Stats.peakBytesBefore = peakWorkingSet();
+	auto start = std::chrono::steady_clock::now();
+
+	std::string cachePath = MeshFile::CachePath(path);
+	MeshFile file;
+	std::vector<uint8_t> image;
+	if (MeshFile::UpToDate(cachePath, path) && file.Open(cachePath))
+	{
+		Stats.fromCache = true;
+		Stats.readMs = millisecondsSince(start);
+	}
+	else
+	{
+		if (!import(path, pool, image))
+			return;
+		MeshFileWriter::Save(VirtualFileSystem::DiskPath(cachePath), image);
+		if (!file.Open(image.data(), image.size()))
+			return;
+	}
+	Stats.fileBytes = file.Size();
+
+	// GL objects are created here on the context's thread
+	auto uploadStart = std::chrono::steady_clock::now();
+	upload(file, std::filesystem::path(path).parent_path().string(), materials);
+	Stats.uploadMs = millisecondsSince(uploadStart);
+	Stats.peakBytesAfter = peakWorkingSet();
+
+	const double MB = 1024.0 * 1024.0;
+	std::cout << "Model: " << path << ", " << Stats.meshes << " meshes, " << Stats.vertices << " vertices, "
+		<< Stats.triangles << " triangles, " << Stats.materials << " materials" << std::endl;
+	if (Stats.fromCache)
+		std::cout << "Model: mapped " << cachePath << " (" << Stats.fileBytes / MB << " MB) " << Stats.readMs << " ms, uploaded "
+			<< Stats.uploadMs << " ms, total " << millisecondsSince(start) << " ms" << std::endl;
+	else
+		std::cout << "Model: read " << Stats.readMs << " ms, processed " << Stats.processMs << " ms on " << pool.Size()
+			<< " threads, uploaded " << Stats.uploadMs << " ms, total " << millisecondsSince(start) << " ms" << std::endl;
+	std::cout << "Model: assimp scene " << Stats.sceneBytes / MB << " MB, peak working set " << Stats.peakBytesAfter / MB
+		<< " MB (+" << (Stats.peakBytesAfter - Stats.peakBytesBefore) / MB << " MB during import)" << std::endl;
+}
+
+bool Model::import(const std::string& path, ThreadPool& pool, std::vector<uint8_t>& image)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Hierarchy transforms are baked into the vertices, so the whole model shares one model matrix.
+	// UVs stay as they are since every image is flipped on load
+	Assimp::Importer importer;
+	// assimp opens the file and the ones it references itself, so it gets the path on disk
+	const aiScene* scene = importer.ReadFile(VirtualFileSystem::DiskPath(path), aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+		aiProcess_JoinIdenticalVertices | aiProcess_PreTransformVertices | aiProcess_ImproveCacheLocality |
+		aiProcess_RemoveRedundantMaterials | aiProcess_SortByPType);
+	if (scene == nullptr || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || scene->mRootNode == nullptr)
+	{
+		std::cout << "ERROR::MODEL::IMPORT_FAILED " << path << ": " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+	Stats.readMs = millisecondsSince(start);
+	aiMemoryInfo memory;
+	importer.GetMemoryRequirements(memory);
+	Stats.sceneBytes = memory.total;
+
+	// Every mesh converts and encodes on its own worker, the scene is only read from here on
+	auto processStart = std::chrono::steady_clock::now();
+	VertexLayout layout = VertexLayout::Compact();
+	std::vector<std::future<MeshFileWriter::EncodedMesh>> processing;
+	processing.reserve(scene->mNumMeshes);
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+	{
+		const aiMesh* mesh = scene->mMeshes[i];
+		// points and lines left over after SortByPType aren't drawn
+		if (!(mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE))
+			continue;
+		processing.push_back(pool.Submit([mesh, &layout]()
+		{
+			MeshData data = processMesh(mesh);
+			return MeshFileWriter::Encode(layout, data.vertices, data.indices, data.materialIndex);
+		}));
+	}
+
+	MeshFileWriter writer(layout);
+	for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+		writer.AddMaterial(texturePath(scene->mMaterials[i], aiTextureType_DIFFUSE), texturePath(scene->mMaterials[i], aiTextureType_SPECULAR));
+	for (std::future<MeshFileWriter::EncodedMesh>& future : processing)
+		writer.AddMesh(future.get());
+	image = writer.Build();
+	Stats.processMs = millisecondsSince(processStart);
+	return true;
+}
+
+void Model::upload(const MeshFile& file, const std::string& directory, MaterialLibrary& materials)
+{
+	const MeshFileHeader& header = file.Header();
+
+	// Material maps decode on the pool while the buffers upload
+	std::vector<unsigned int> materialIds(header.materialCount);
+	for (uint32_t i = 0; i < header.materialCount; ++i)
+	{
+		const MaterialRecord& material = file.MaterialAt(i);
+		std::string diffuse = file.String(material.diffuseOffset, material.diffuseLength);
+		std::string specular = file.String(material.specularOffset, material.specularLength);
+		materialIds[i] = materials.Add(directory, diffuse.empty() ? nullptr : diffuse.c_str(),
+			specular.empty() ? nullptr : specular.c_str());
+	}
+	Stats.materials = header.materialCount;
+
+	// the buffers read straight from the file, from the mapping when it is the cache
+	VertexLayout layout = file.Layout();
+	meshes.reserve(header.meshCount);
+	std::vector<const void*> streams(layout.streams.size());
+	std::vector<MeshLod> lods;
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		const MeshRecord& record = file.MeshAt(i);
+		for (size_t s = 0; s < streams.size(); ++s)
+			streams[s] = file.At(record.streamOffsets[s]);
+		lods.clear();
+		for (uint32_t level = 0; level < record.lodCount; ++level)
+			lods.push_back({ record.lods[level].firstIndex, (GLsizei)record.lods[level].indexCount });
+
+		meshes.emplace_back(layout, streams, (GLsizei)record.vertexCount, file.At(record.indexOffset), (GLsizei)record.indexCount,
+			record.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, lods,
+			glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]),
+			glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]));
+		meshes.back().SetMaterial(&materials, materialIds[record.materialIndex]);
+		Stats.vertices += record.vertexCount;
+		Stats.triangles += record.lods[0].indexCount / 3;
+	}
+	Stats.meshes = (unsigned int)meshes.size();
+	materials.Build();
+}
+
+Model::MeshData Model::processMesh(const aiMesh* mesh)
+{
+	MeshData data;
+	data.materialIndex = mesh->mMaterialIndex;
+	data.vertices.resize(mesh->mNumVertices);
+	for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+	{
+		Vertex& vertex = data.vertices[i];
+		vertex.position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		vertex.normal = mesh->HasNormals() ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f, 1.0f, 0.0f);
+		vertex.color = mesh->HasVertexColors(0) ? glm::vec3(mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b) : glm::vec3(1.0f);
+		vertex.texUV = mesh->HasTextureCoords(0) ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+	}
+
+	data.indices.reserve((size_t)mesh->mNumFaces * 3);
+	for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		if (face.mNumIndices != 3)
+			continue;
+		data.indices.push_back(face.mIndices[0]);
+		data.indices.push_back(face.mIndices[1]);
+		data.indices.push_back(face.mIndices[2]);
+	}
+	return data;
+}
+
+std::string Model::texturePath(const aiMaterial* material, aiTextureType type)
+{
+	if (material->GetTextureCount(type) == 0)
+		return std::string();
+	aiString file;
+	if (material->GetTexture(type, 0, &file) != aiReturn_SUCCESS)
+		return std::string();
+	std::string path = file.C_Str();
+	// textures embedded in the file are addressed as "*index", only files on disk are supported
+	if (path.empty() || path[0] == '*')
+		return std::string();
+	return path;
+}
+
+size_t Model::peakWorkingSet()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+unsigned int Model::Draw(Shader& shader, const glm::mat4& model, const Frustum* frustum)
+{
+	static const Uniform<glm::mat4> modelUniform("model");
+
+	shader.Activate();
+	shader.setUniform(modelUniform, model);
+
+	unsigned int drawn = 0;
+	for (Mesh& mesh : meshes)
+	{
+		if (frustum != nullptr)
+		{
+			BoundingBox bounds = mesh.GetMeshBoundingBox();
+			glm::vec3 center, extent;
+			Frustum::TransformBounds(bounds, model, center, extent);
+			if (!frustum->IsVisible(center, extent))
+				continue;
+		}
+		mesh.SetLod(Lod);
+		mesh.Draw(shader);
+		drawn++;
+	}
+	return drawn;
+}
+
+unsigned int Model::Submit(RenderQueue& queue, RenderPass pass, Shader& shader, const glm::mat4& model, const Frustum* frustum, bool material)
+{
+	DrawItem item;
+	item.shader = &shader;
+	item.model = model;
+	item.material = material;
+
+	unsigned int queued = 0;
+	for (Mesh& mesh : meshes)
+	{
+		BoundingBox bounds = mesh.GetMeshBoundingBox();
+		glm::vec3 center, extent;
+		Frustum::TransformBounds(bounds, model, center, extent);
+		if (frustum != nullptr && !frustum->IsVisible(center, extent))
+			continue;
+		mesh.SetLod(Lod);
+		item.mesh = &mesh;
+		queue.Submit(pass, item, center);
+		queued++;
+	}
+	return queued;
+}
+
+void Model::Delete()
+{
+	for (Mesh& mesh : meshes)
+		mesh.Delete();
+	meshes.clear();
+}
@@ -0,0 +1,86 @@
+#ifndef MODEL_CLASS_H
+#define MODEL_CLASS_H
+
+#include <string>
+#include <vector>
+
+#include <assimp/scene.h>
+
+#include "Mesh.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+#include "MaterialLibrary.h"
+#include "MeshFile.h"
+#include "RenderQueue.h"
+
+// How long an import took and how much memory it needed
+struct ModelImportStats
+{
+	// true when the meshes came from the mesh file cache and assimp wasn't involved
+	bool fromCache = false;
+	size_t fileBytes = 0;
+	// assimp parsing and post processing or mapping the cache, vertex encoding on the pool,
+	// buffers and materials on the GL thread
+	double readMs = 0.0;
+	double processMs = 0.0;
+	double uploadMs = 0.0;
+	// memory assimp held for the scene (0 from the cache), and the process's peak working set before and after the import
+	size_t sceneBytes = 0;
+	size_t peakBytesBefore = 0;
+	size_t peakBytesAfter = 0;
+	unsigned int meshes = 0;
+	unsigned int vertices = 0;
+	unsigned int triangles = 0;
+	unsigned int materials = 0;
+};
+
+// A scene imported through assimp. The node hierarchy is flattened into the meshes, every
+// mesh draws with a material from the library built from the file's diffuse and specular maps.
+// The processed meshes are cached in a mesh file next to the source, later runs map that and
+// upload from it directly until the source changes.
+class Model
+{
+public:
+	std::vector<Mesh> meshes;
+	ModelImportStats Stats;
+	// Level of detail every mesh draws with, see MeshFileWriter::Encode
+	unsigned int Lod = 0;
+
+	// Loads path from its mesh file, or imports it and converts its meshes on pool's workers,
+	// then uploads them on the calling thread, which must own the GL context. Failures leave
+	// the model empty
+	Model(const std::string& path, ThreadPool& pool, MaterialLibrary& materials);
+
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
+	// Draws every mesh with the model matrix, skipping those outside frustum when one is given.
+	// Returns the number of meshes drawn
+	unsigned int Draw(Shader& shader, const glm::mat4& model, const Frustum* frustum = nullptr);
+	// Queues the meshes Draw would draw for pass instead, each at the center of its bounds.
+	// Returns the number of meshes queued
+	unsigned int Submit(RenderQueue& queue, RenderPass pass, Shader& shader, const glm::mat4& model, const Frustum* frustum = nullptr,
+		bool material = true);
+	void Delete();
+
+	bool Empty() const { return meshes.empty(); }
+
+private:
+	// One aiMesh converted to the engine's vertex and index format
+	struct MeshData
+	{
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		unsigned int materialIndex = 0;
+	};
+
+	// Imports path with assimp and encodes it into a mesh file image, false when it can't be read
+	bool import(const std::string& path, ThreadPool& pool, std::vector<uint8_t>& image);
+	// Creates the meshes and materials of a mesh file
+	void upload(const MeshFile& file, const std::string& directory, MaterialLibrary& materials);
+
+	static MeshData processMesh(const aiMesh* mesh);
+	static std::string texturePath(const aiMaterial* material, aiTextureType type);
+	static size_t peakWorkingSet();
+};
+#endif
@@ -0,0 +1,47 @@
+#include "PassQuery.h"
+
+PassQuery::PassQuery()
+{
+	glGenQueries(LATENCY, timeQueries);
+	glGenQueries(LATENCY, primitiveQueries);
+	glGenQueries(LATENCY, sampleQueries);
+}
+
+void PassQuery::Begin()
+{
+	//The queries about to be reused were issued LATENCY frames ago, pick up their results if they are in
+	if (pending[current])
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(timeQueries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(timeQueries[current], GL_QUERY_RESULT, &nanoseconds);
+			glGetQueryObjectui64v(primitiveQueries[current], GL_QUERY_RESULT, &Primitives);
+			glGetQueryObjectui64v(sampleQueries[current], GL_QUERY_RESULT, &Samples);
+			Milliseconds = nanoseconds / 1000000.0;
+		}
+		pending[current] = false;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, timeQueries[current]);
+	glBeginQuery(GL_PRIMITIVES_GENERATED, primitiveQueries[current]);
+	glBeginQuery(GL_SAMPLES_PASSED, sampleQueries[current]);
+}
+
+void PassQuery::End()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	glEndQuery(GL_PRIMITIVES_GENERATED);
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = (current + 1) % LATENCY;
+}
+
+void PassQuery::Delete()
+{
+	glDeleteQueries(LATENCY, timeQueries);
+	glDeleteQueries(LATENCY, primitiveQueries);
+	glDeleteQueries(LATENCY, sampleQueries);
+}
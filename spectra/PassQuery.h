@@ -0,0 +1,36 @@
+#ifndef PASS_QUERY_CLASS_H
+#define PASS_QUERY_CLASS_H
+
+#include <glad/glad.h>
+
+// GPU time, primitive and sample count of a stretch of draws. The queries of a frame are read a
+// few frames later, when the GPU is done with them, so measuring never stalls the pipeline
+class PassQuery
+{
+public:
+	// results of the latest pass that finished
+	double Milliseconds = 0.0;
+	GLuint64 Primitives = 0;
+	// samples that passed the depth test, the fragments shaded when nothing discards
+	GLuint64 Samples = 0;
+
+	PassQuery();
+
+	PassQuery(const PassQuery&) = delete;
+	PassQuery& operator=(const PassQuery&) = delete;
+
+	// Brackets the draws to measure, once per frame. Primitives are counted after the geometry
+	// shader, so amplified triangles count once per copy
+	void Begin();
+	void End();
+	void Delete();
+
+private:
+	static const int LATENCY = 3;
+	GLuint timeQueries[LATENCY] = {};
+	GLuint primitiveQueries[LATENCY] = {};
+	GLuint sampleQueries[LATENCY] = {};
+	bool pending[LATENCY] = {};
+	int current = 0;
+};
+#endif
@@ -2,7 +2,15 @@
 in vec4 FragPos;
 
 uniform vec3 lightPos;
-uniform float far_plane;
+
+//Shared per-frame camera data, see UniformBlocks.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float far_plane;
+};
 
 void main()
 {
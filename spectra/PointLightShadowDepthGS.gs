@@ -3,6 +3,8 @@ layout (triangles) in;
 layout (triangle_strip, max_vertices=18) out;
 
 uniform mat4 shadowMatrices[6];
+// cube of the shadow atlas array being drawn, its faces are layers 6 * shadowSlot to 6 * shadowSlot + 5
+uniform int shadowSlot;
 
 out vec4 FragPos; // FragPos from GS (output per emitvertex)
 
@@ -10,7 +12,7 @@ void main()
 {
     for(int face = 0; face < 6; ++face)
     {
-        gl_Layer = face; // built-in variable that specifies to which face we render.
+        gl_Layer = shadowSlot * 6 + face; // built-in variable that specifies to which face we render.
         for(int i = 0; i < 3; ++i) // for each triangle's vertices
         {
             FragPos = gl_in[i].gl_Position;
@@ -1,9 +1,51 @@
 #version 330 core
+#ifdef VERTEX_LAYER
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
 layout (location = 0) in vec3 aPos;
-
+#ifdef INSTANCED
+//Same per-instance buffer the scene pass draws the cubes with
+layout (location = 4) in mat4 aInstanceModel;
+#else
 uniform mat4 model;
+#endif
+
+//How a vertex reaches its cube face:
+//  GEOMETRY_FACES  the geometry shader copies every triangle to all six faces
+//  VERTEX_LAYER    picked here and written to gl_Layer, so one draw covers several faces of the atlas
+//  neither         one face per draw, the framebuffer has only that face attached
+#ifndef GEOMETRY_FACES
+uniform mat4 shadowMatrices[6];
+// face of this draw, or for instanced casters under VERTEX_LAYER the face of every instance
+uniform int shadowFace;
+out vec4 FragPos;
+#endif
+#ifdef VERTEX_LAYER
+// cube of the shadow atlas array being drawn, its faces are layers 6 * shadowSlot to 6 * shadowSlot + 5
+uniform int shadowSlot;
+#ifndef INSTANCED
+// single meshes are drawn with one instance per face they land on, instance i goes to shadowFaces[i]
+uniform int shadowFaces[6];
+#endif
+#endif
 
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+#endif
+#ifdef GEOMETRY_FACES
     gl_Position = model * vec4(aPos, 1.0);
+#else
+#if defined(VERTEX_LAYER) && !defined(INSTANCED)
+    int face = shadowFaces[gl_InstanceID];
+#else
+    int face = shadowFace;
+#endif
+    FragPos = model * vec4(aPos, 1.0);
+    gl_Position = shadowMatrices[face] * FragPos;
+#ifdef VERTEX_LAYER
+    gl_Layer = shadowSlot * 6 + face;
+#endif
+#endif
 }
\ No newline at end of file
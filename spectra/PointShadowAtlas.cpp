@@ -0,0 +1,212 @@
+#include "PointShadowAtlas.h"
+
+#include <algorithm>
+#include <numeric>
+
+PointShadowAtlas::PointShadowAtlas(const std::vector<PointShadowTier>& tiers)
+	: tiers(tiers), arrays(tiers.size()), used(tiers.size())
+{
+	for (size_t t = 0; t < tiers.size(); ++t)
+	{
+		createArray(tiers[t], arrays[t].array, arrays[t].fbo);
+		used[t].resize(tiers[t].slots);
+	}
+
+	glGenFramebuffers(2, faceFBOs);
+	for (GLuint faceFBO : faceFBOs)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, faceFBO);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	//The same arrays serve the shaders that read depth and those comparing in hardware, the unit's sampler decides
+	glGenSamplers(1, &depthSampler);
+	glSamplerParameteri(depthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glSamplerParameteri(depthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glGenSamplers(1, &compareSampler);
+	//Linear filtering on a comparison sampler blends the results of four texels, 2x2 PCF in one fetch
+	glSamplerParameteri(compareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(compareSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(compareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glSamplerParameteri(compareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	for (GLuint sampler : { depthSampler, compareSampler })
+	{
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+}
+
+bool PointShadowAtlas::Supported()
+{
+	return GLAD_GL_ARB_texture_cube_map_array != 0;
+}
+
+void PointShadowAtlas::createArray(const PointShadowTier& tier, GLuint& array, GLuint& fbo)
+{
+	//Depth is stored as distance / far plane, 16 bits resolve far below the shaders' bias and halve the pool
+	glGenTextures(1, &array);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, array);
+	glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, 0, GL_DEPTH_COMPONENT16, tier.size, tier.size, tier.slots * 6, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, 0);
+
+	//Layered, the depth shaders pick the face of the slot through gl_Layer
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, array, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+float PointShadowAtlas::Cost(unsigned int tier) const
+{
+	float scale = tiers[tier].size / 1024.0f;
+	return scale * scale;
+}
+
+size_t PointShadowAtlas::ResidentBytes() const
+{
+	size_t bytes = 0;
+	for (size_t t = 0; t < tiers.size(); ++t)
+	{
+		size_t cube = (size_t)tiers[t].size * tiers[t].size * 6 * 2;
+		bytes += cube * tiers[t].slots * (arrays[t].staticArray != 0 ? 2 : 1);
+	}
+	return bytes;
+}
+
+void PointShadowAtlas::Assign(std::vector<PointShadowMap>& maps, const std::vector<float>& importance)
+{
+	std::vector<unsigned int> order(maps.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [&importance](unsigned int a, unsigned int b) { return importance[a] > importance[b]; });
+
+	//The tier each light should be in, by rank
+	wanted.assign(maps.size(), -1);
+	unsigned int tier = 0, filled = 0;
+	for (unsigned int light : order)
+	{
+		while (tier < tiers.size() && filled == tiers[tier].slots)
+		{
+			tier++;
+			filled = 0;
+		}
+		if (tier == tiers.size() || importance[light] <= 0.0f)
+			break;
+		wanted[light] = (int)tier;
+		filled++;
+	}
+
+	//Maps that stay in their tier keep their slots, the others take the free ones
+	for (std::vector<bool>& slots : used)
+		std::fill(slots.begin(), slots.end(), false);
+	for (size_t i = 0; i < maps.size(); ++i)
+	{
+		if (maps[i].Tier >= 0 && maps[i].Tier == wanted[i])
+			used[maps[i].Tier][maps[i].Slot] = true;
+	}
+	for (unsigned int light : order)
+	{
+		PointShadowMap& map = maps[light];
+		if (map.Tier == wanted[light])
+			continue;
+		if (wanted[light] < 0)
+		{
+			map.Assign(-1, -1);
+			continue;
+		}
+		std::vector<bool>& slots = used[wanted[light]];
+		int slot = (int)(std::find(slots.begin(), slots.end(), false) - slots.begin());
+		slots[slot] = true;
+		map.Assign(wanted[light], slot);
+	}
+}
+
+void PointShadowAtlas::clearCube(GLuint array, int slot, GLsizei size)
+{
+	//Clearing the layered framebuffer would clear every slot of the array
+	glBindFramebuffer(GL_FRAMEBUFFER, faceFBOs[0]);
+	glViewport(0, 0, size, size);
+	for (int face = 0; face < 6; ++face)
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, array, 0, slot * 6 + face);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+}
+
+void PointShadowAtlas::BeginStaticLayer(const PointShadowMap& map, bool split)
+{
+	TierArrays& tier = arrays[map.Tier];
+	if (split && tier.staticArray == 0)
+		createArray(tiers[map.Tier], tier.staticArray, tier.staticFBO);
+
+	GLuint array = split ? tier.staticArray : tier.array;
+	clearCube(array, map.Slot, tiers[map.Tier].size);
+	glBindFramebuffer(GL_FRAMEBUFFER, split ? tier.staticFBO : tier.fbo);
+}
+
+void PointShadowAtlas::BeginDynamicLayer(const PointShadowMap& map)
+{
+	TierArrays& tier = arrays[map.Tier];
+	GLsizei size = tiers[map.Tier].size;
+
+	//A layered attachment only blits its first layer, so each face gets attached on its own
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, faceFBOs[0]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, faceFBOs[1]);
+	for (int face = 0; face < 6; ++face)
+	{
+		glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tier.staticArray, 0, map.Slot * 6 + face);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tier.array, 0, map.Slot * 6 + face);
+		glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+
+	glViewport(0, 0, size, size);
+	glBindFramebuffer(GL_FRAMEBUFFER, tier.fbo);
+}
+
+void PointShadowAtlas::BindFace(const PointShadowMap& map, int face, bool staticLayer)
+{
+	TierArrays& tier = arrays[map.Tier];
+	glBindFramebuffer(GL_FRAMEBUFFER, faceFBOs[0]);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticLayer ? tier.staticArray : tier.array, 0, map.Slot * 6 + face);
+}
+
+void PointShadowAtlas::Bind(GLuint firstUnit)
+{
+	GLuint tierCount = (GLuint)arrays.size();
+	for (GLuint t = 0; t < tierCount; ++t)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit + t);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, arrays[t].array);
+		glBindSampler(firstUnit + t, depthSampler);
+		glActiveTexture(GL_TEXTURE0 + firstUnit + tierCount + t);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, arrays[t].array);
+		glBindSampler(firstUnit + tierCount + t, compareSampler);
+	}
+}
+
+void PointShadowAtlas::Delete()
+{
+	for (TierArrays& tier : arrays)
+	{
+		glDeleteFramebuffers(1, &tier.fbo);
+		glDeleteTextures(1, &tier.array);
+		if (tier.staticArray != 0)
+		{
+			glDeleteFramebuffers(1, &tier.staticFBO);
+			glDeleteTextures(1, &tier.staticArray);
+		}
+		tier = TierArrays();
+	}
+	glDeleteFramebuffers(2, faceFBOs);
+	glDeleteSamplers(1, &depthSampler);
+	glDeleteSamplers(1, &compareSampler);
+}
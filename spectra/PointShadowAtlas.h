@@ -0,0 +1,77 @@
+#ifndef POINT_SHADOW_ATLAS_CLASS_H
+#define POINT_SHADOW_ATLAS_CLASS_H
+
+#include <glad/glad.h>
+#include <vector>
+
+#include "PointShadowMap.h"
+
+// A resolution tier of the atlas: how many cubes of which size
+struct PointShadowTier
+{
+	GLsizei size;
+	unsigned int slots;
+};
+
+// Every point shadow map lives in a pool of cube map arrays, one array per resolution tier.
+// Lights are handed slots each frame, the most important ones get the largest tier, so the number
+// of shadowed lights is the pool's slot count instead of one texture and framebuffer per light.
+// A cube is drawn in one pass through a layered framebuffer, where the depth shaders offset
+// gl_Layer by the slot, or a face at a time through BindFace. Needs ARB_texture_cube_map_array, see Supported
+class PointShadowAtlas
+{
+public:
+	explicit PointShadowAtlas(const std::vector<PointShadowTier>& tiers);
+
+	PointShadowAtlas(const PointShadowAtlas&) = delete;
+	PointShadowAtlas& operator=(const PointShadowAtlas&) = delete;
+
+	static bool Supported();
+
+	unsigned int TierCount() const { return (unsigned int)tiers.size(); }
+	const PointShadowTier& Tier(unsigned int tier) const { return tiers[tier]; }
+	// Relative cost of drawing a cube of tier, a 1024 cube is 1
+	float Cost(unsigned int tier) const;
+	size_t ResidentBytes() const;
+
+	// Hands out slots by importance, one per map. Walking from the most important light the
+	// largest tier fills up first, lights with importance 0 or beyond the last slot get none.
+	// A map staying in its tier keeps its slot, and with it what was drawn there
+	void Assign(std::vector<PointShadowMap>& maps, const std::vector<float>& importance);
+
+	// Clears the cube of map's slot, or its static copy when split, and binds it for drawing
+	void BeginStaticLayer(const PointShadowMap& map, bool split);
+	// Copies the static cube into map's slot and binds it, dynamic casters are drawn over it
+	void BeginDynamicLayer(const PointShadowMap& map);
+	// Binds a single face of map's cube, of its static copy when staticLayer, instead of the whole
+	// array. For drawing without gl_Layer, after the Begin call of the layer
+	void BindFace(const PointShadowMap& map, int face, bool staticLayer);
+	// Binds the array of every tier twice: tier t to unit firstUnit + t to read its depth, and to unit
+	// firstUnit + TierCount() + t through a linear comparison sampler, for samplerCubeArrayShadow
+	void Bind(GLuint firstUnit);
+	void Delete();
+
+private:
+	struct TierArrays
+	{
+		GLuint array = 0;
+		GLuint fbo = 0;
+		// copies of the static casters for split maps, created on the first split in the tier
+		GLuint staticArray = 0;
+		GLuint staticFBO = 0;
+	};
+
+	std::vector<PointShadowTier> tiers;
+	std::vector<TierArrays> arrays;
+	// single faces get attached to these to clear and copy one cube of an array
+	GLuint faceFBOs[2] = { 0, 0 };
+	// how the tiers are sampled, see Bind. The arrays' own state is never used
+	GLuint depthSampler = 0;
+	GLuint compareSampler = 0;
+	std::vector<int> wanted;
+	std::vector<std::vector<bool>> used;
+
+	static void createArray(const PointShadowTier& tier, GLuint& array, GLuint& fbo);
+	void clearCube(GLuint array, int slot, GLsizei size);
+};
+#endif
@@ -0,0 +1,67 @@
+#include "PointShadowMap.h"
+
+bool PointShadowMap::inRange(const ShadowCaster& caster, const glm::vec3& lightPosition, float radius)
+{
+	//A negative extent stands for nothing at all
+	if (caster.extent.x < 0.0f)
+		return false;
+	//Distance from the light to the closest point of the box
+	glm::vec3 offset = glm::max(glm::abs(lightPosition - caster.center) - caster.extent, glm::vec3(0.0f));
+	return glm::dot(offset, offset) <= radius * radius;
+}
+
+bool PointShadowMap::SplitLayers(const std::vector<ShadowCaster>& casters, bool split)
+{
+	if (!split)
+		return false;
+	for (const ShadowCaster& caster : casters)
+	{
+		if (caster.dynamic)
+			return true;
+	}
+	return false;
+}
+
+unsigned int PointShadowMap::Stale(const glm::vec3& position, float range, const std::vector<ShadowCaster>& current, bool splitLayers) const
+{
+	unsigned int stale = 0;
+	if (!valid || position != lightPosition || range != radius || splitLayers != split || current.size() != casters.size())
+		stale = POINT_SHADOW_STATIC_LAYER | POINT_SHADOW_DYNAMIC_LAYER;
+	else
+	{
+		for (size_t i = 0; i < current.size(); ++i)
+		{
+			const ShadowCaster& before = casters[i];
+			const ShadowCaster& now = current[i];
+			if (before.version == now.version && before.transform == now.transform && before.dynamic == now.dynamic)
+				continue;
+			//Moving into or out of range changes the map as much as moving within it
+			if (!inRange(before, position, range) && !inRange(now, position, range))
+				continue;
+			stale |= splitLayers && now.dynamic && before.dynamic ? POINT_SHADOW_DYNAMIC_LAYER : POINT_SHADOW_STATIC_LAYER;
+		}
+	}
+
+	//A redrawn static layer has to be copied again before the dynamic casters go over it
+	if (splitLayers && (stale & POINT_SHADOW_STATIC_LAYER))
+		stale |= POINT_SHADOW_DYNAMIC_LAYER;
+	if (!splitLayers)
+		stale &= POINT_SHADOW_STATIC_LAYER;
+	return stale;
+}
+
+void PointShadowMap::MarkDrawn(const glm::vec3& position, float range, const std::vector<ShadowCaster>& current, bool splitLayers)
+{
+	valid = true;
+	split = splitLayers;
+	lightPosition = position;
+	radius = range;
+	casters = current;
+}
+
+void PointShadowMap::Assign(int tier, int slot)
+{
+	Tier = tier;
+	Slot = slot;
+	valid = false;
+}
@@ -0,0 +1,76 @@
+#ifndef POINT_SHADOW_MAP_CLASS_H
+#define POINT_SHADOW_MAP_CLASS_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Something drawn into the point shadow maps, as the maps see it when deciding whether to redraw
+struct ShadowCaster
+{
+	// world space box as center/half extent, where the caster is now
+	glm::vec3 center;
+	glm::vec3 extent;
+	glm::mat4 transform;
+	// bumped by the owner when the geometry changes without the transform changing, e.g. instances
+	uint64_t version;
+	// drawn into the per frame layer instead of the cached one when the layers are split
+	bool dynamic;
+};
+
+// Layers of a point shadow map that are out of date, see PointShadowMap::Stale
+const unsigned int POINT_SHADOW_STATIC_LAYER = 1;
+const unsigned int POINT_SHADOW_DYNAMIC_LAYER = 2;
+
+// What the point shadow maps did this frame
+struct ShadowStats
+{
+	// static layers (or whole maps) drawn, dynamic layers drawn over a copy of their static layer, and maps reused as they were
+	unsigned int Redrawn = 0;
+	unsigned int Composited = 0;
+	unsigned int Cached = 0;
+	// stale maps left for a later frame because the update budget was spent
+	unsigned int Deferred = 0;
+	// caster/face pairs sent to and kept from the faces by per-face culling, an instanced cube counts as a caster
+	unsigned int FaceDraws = 0;
+	unsigned int FacesCulled = 0;
+};
+
+// A point light's depth cubemap, a slot of the PointShadowAtlas, that is only redrawn when it
+// would come out different: the light moved, or a caster that is or was within the light's
+// radius changed. Optionally the casters are split in two layers, static ones are kept in a cube
+// of their own and the dynamic ones are drawn each time over a copy of it, so a moving object
+// doesn't redraw the whole scene
+class PointShadowMap
+{
+public:
+	// atlas tier and cube in that tier's array, -1 without a slot
+	int Tier = -1;
+	int Slot = -1;
+
+	// Whether the layers get split for these casters, a split without dynamic casters would only copy the static layer around
+	static bool SplitLayers(const std::vector<ShadowCaster>& casters, bool split);
+
+	// Compares the light and casters with what the map was last drawn with and returns the layers
+	// to draw, 0 when the map can be used as it is. Without split everything is in the static layer
+	unsigned int Stale(const glm::vec3& lightPosition, float radius, const std::vector<ShadowCaster>& casters, bool split) const;
+	// Records what the layers Stale returned were drawn with
+	void MarkDrawn(const glm::vec3& lightPosition, float radius, const std::vector<ShadowCaster>& casters, bool split);
+	// True once the slot holds this light's depth
+	bool Drawn() const { return valid; }
+	// Forces a full redraw, e.g. when the depth programs change
+	void Invalidate() { valid = false; }
+	// Moves the map to another slot, which holds nothing of this light yet
+	void Assign(int tier, int slot);
+
+private:
+	// what the map was last drawn with
+	bool valid = false;
+	bool split = false;
+	glm::vec3 lightPosition = glm::vec3(0.0f);
+	float radius = 0.0f;
+	std::vector<ShadowCaster> casters;
+
+	static bool inRange(const ShadowCaster& caster, const glm::vec3& lightPosition, float radius);
+};
+#endif
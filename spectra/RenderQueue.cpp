@@ -0,0 +1,160 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+void RenderQueue::Begin(const glm::vec3& viewPosition, float farPlane)
+{
+	this->viewPosition = viewPosition;
+	this->farPlane = farPlane;
+	items.clear();
+	entries.clear();
+	sorted = true;
+	Immediate = RenderQueueStats();
+	Sorted = RenderQueueStats();
+	immediateArray = -1;
+	//Other passes attach their own instance buffers between frames
+	attachedInstances.clear();
+}
+
+void RenderQueue::Submit(RenderPass pass, const DrawItem& item, const glm::vec3& center)
+{
+	if (item.instances != nullptr && item.instanceCount <= 0)
+		return;
+
+	float distance = glm::clamp(glm::length(center - viewPosition) / farPlane, 0.0f, 1.0f);
+	uint32_t depth = (uint32_t)(distance * 65535.0f);
+	uint64_t key = item.material
+		? makeKey(pass, item.shader->ID, materialArray(*item.mesh), item.mesh->VAO.ID, depth)
+		: makeKey(pass, item.shader->ID, depth, item.mesh->VAO.ID, 0);
+	entries.push_back({ key, (uint32_t)items.size() });
+	items.push_back(item);
+	sorted = false;
+
+	//Mesh::Draw activates the program and binds the vertex array every time, the library skips arrays already bound
+	Immediate.Draws++;
+	Immediate.Programs++;
+	Immediate.VertexArrays++;
+	if (MaterialLibrary* library = item.mesh->GetMaterialLibrary())
+	{
+		int array = (int)library->Get(item.mesh->GetMaterial()).array;
+		if (array != immediateArray)
+		{
+			Immediate.Textures += 2;
+			immediateArray = array;
+		}
+	}
+	else
+		Immediate.Textures += (unsigned int)item.mesh->textures.size();
+}
+
+void RenderQueue::Execute(RenderPass pass)
+{
+	static const Uniform<glm::mat4> modelUniform("model");
+
+	if (!sorted)
+		sort();
+
+	//Whatever ran since the last pass bound its own program and vertex array, nothing is assumed bound
+	const Shader* boundShader = nullptr;
+	GLuint boundVertexArray = 0;
+
+	uint64_t first = (uint64_t)pass << 60;
+	auto it = std::lower_bound(entries.begin(), entries.end(), first,
+		[](const SortEntry& entry, uint64_t key) { return entry.key < key; });
+	for (; it != entries.end() && (it->key >> 60) == (uint64_t)pass; ++it)
+	{
+		DrawItem& item = items[it->item];
+		Mesh& mesh = *item.mesh;
+
+		if (item.instances != nullptr)
+		{
+			auto attached = std::find_if(attachedInstances.begin(), attachedInstances.end(),
+				[&mesh](const std::pair<GLuint, const VBO*>& entry) { return entry.first == mesh.VAO.ID; });
+			if (attached == attachedInstances.end() || attached->second != item.instances)
+			{
+				//Attaching leaves no vertex array bound
+				mesh.SetInstanceBuffer(*item.instances);
+				boundVertexArray = 0;
+				if (attached == attachedInstances.end())
+					attachedInstances.push_back({ mesh.VAO.ID, item.instances });
+				else
+					attached->second = item.instances;
+			}
+		}
+
+		if (item.shader != boundShader)
+		{
+			item.shader->Activate();
+			boundShader = item.shader;
+			Sorted.Programs++;
+		}
+		if (mesh.VAO.ID != boundVertexArray)
+		{
+			mesh.VAO.Bind();
+			boundVertexArray = mesh.VAO.ID;
+			Sorted.VertexArrays++;
+		}
+		if (item.material)
+		{
+			//The library only binds when the array pair changes, its count says whether it did
+			if (MaterialLibrary* library = mesh.GetMaterialLibrary())
+			{
+				unsigned int binds = library->Binds;
+				mesh.BindMaterial(*item.shader);
+				Sorted.Textures += (library->Binds - binds) * 2;
+			}
+			else
+			{
+				mesh.BindMaterial(*item.shader);
+				Sorted.Textures += (unsigned int)mesh.textures.size();
+			}
+		}
+
+		if (item.instances == nullptr)
+			item.shader->setUniform(modelUniform, item.model);
+		if (item.colorUniform.id != UINT_MAX)
+			item.shader->setUniform(item.colorUniform, item.color);
+		mesh.DrawElements(item.instances != nullptr ? item.instanceCount : 0);
+		Sorted.Draws++;
+	}
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, uint32_t material, GLuint vertexArray, uint32_t depth)
+{
+	return ((uint64_t)pass << 60) | ((uint64_t)(program & 0xFFF) << 48) | ((uint64_t)(material & 0xFFFF) << 32)
+		| ((uint64_t)(vertexArray & 0xFFFF) << 16) | (uint64_t)(depth & 0xFFFF);
+}
+
+uint32_t RenderQueue::materialArray(const Mesh& mesh)
+{
+	if (MaterialLibrary* library = mesh.GetMaterialLibrary())
+		return library->Get(mesh.GetMaterial()).array;
+	return 0xFFFF;
+}
+
+void RenderQueue::sort()
+{
+	//Least significant byte first, every pass keeps the order of the one before for equal digits
+	scratch.resize(entries.size());
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		size_t histogram[256] = {};
+		for (const SortEntry& entry : entries)
+			histogram[(entry.key >> shift) & 0xFF]++;
+		//A byte all keys share, e.g. the pass or the unused depth bits, leaves the order as it is
+		if (histogram[(entries[0].key >> shift) & 0xFF] == entries.size())
+			continue;
+
+		size_t offset = 0;
+		for (size_t& bucket : histogram)
+		{
+			size_t count = bucket;
+			bucket = offset;
+			offset += count;
+		}
+		for (const SortEntry& entry : entries)
+			scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+		entries.swap(scratch);
+	}
+	sorted = true;
+}
@@ -0,0 +1,86 @@
+#ifndef RENDER_QUEUE_CLASS_H
+#define RENDER_QUEUE_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+#include "Shader.h"
+
+// Passes of the camera view in the order they are drawn, the top bits of every sort key
+enum RenderPass { RENDER_PASS_DEPTH_PREPASS, RENDER_PASS_OPAQUE, RENDER_PASS_UNLIT, RENDER_PASS_COUNT };
+
+// One draw handed to the queue. Single draws carry their model matrix, instanced ones the buffer
+// of instance matrices
+struct DrawItem
+{
+	Shader* shader = nullptr;
+	Mesh* mesh = nullptr;
+	glm::mat4 model = glm::mat4(1.0f);
+	VBO* instances = nullptr;
+	GLsizei instanceCount = 0;
+	// depth only passes never sample the material, its arrays are then left alone
+	bool material = true;
+	// per draw colour, set when the handle is
+	Uniform<glm::vec3> colorUniform;
+	glm::vec3 color = glm::vec3(0.0f);
+};
+
+// State changes of a frame's draws, texture units bound and program and vertex array switches
+struct RenderQueueStats
+{
+	unsigned int Draws = 0;
+	unsigned int Programs = 0;
+	unsigned int Textures = 0;
+	unsigned int VertexArrays = 0;
+};
+
+// Draws of the camera passes collected over a frame and drawn in sort key order, which groups them
+// by pass, program, material arrays and vertex array, nearest first within those:
+//   63..60 pass, 59..48 program, 47..32 material array, 31..16 vertex array, 15..0 depth
+// Depth only draws have no material, their depth moves up into its bits so they go front to back
+// within a program. The keys are radix sorted once, Execute then draws one pass and only binds what
+// changed since the previous draw
+class RenderQueue
+{
+public:
+	// What drawing the items in submission order through Mesh::Draw would have bound, which
+	// activates the program and binds the vertex array for every draw
+	RenderQueueStats Immediate;
+	// What Execute bound in sort order
+	RenderQueueStats Sorted;
+
+	// Empties the queue and resets the stats, depth is measured from viewPosition out to farPlane
+	void Begin(const glm::vec3& viewPosition, float farPlane);
+	// Queues item for pass, center is the world space point its depth is taken at
+	void Submit(RenderPass pass, const DrawItem& item, const glm::vec3& center);
+	// Draws pass's items, sorting the queue first if anything was submitted since the last sort
+	void Execute(RenderPass pass);
+
+	unsigned int Size() const { return (unsigned int)items.size(); }
+
+private:
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t item;
+	};
+
+	std::vector<DrawItem> items;
+	std::vector<SortEntry> entries, scratch;
+	bool sorted = true;
+	glm::vec3 viewPosition = glm::vec3(0.0f);
+	float farPlane = 1.0f;
+	// material arrays in submission order, for the Immediate count
+	int immediateArray = -1;
+	// instance buffer attached to each vertex array this frame
+	std::vector<std::pair<GLuint, const VBO*>> attachedInstances;
+
+	static uint64_t makeKey(RenderPass pass, GLuint program, uint32_t material, GLuint vertexArray, uint32_t depth);
+	// material array the mesh binds, one past the last for meshes with their own textures
+	static uint32_t materialArray(const Mesh& mesh);
+	void sort();
+};
+#endif
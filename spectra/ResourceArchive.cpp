@@ -0,0 +1,204 @@
+#include "ResourceArchive.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+	const uint32_t RESOURCE_ARCHIVE_MAGIC = 0x4B415053; // "SPAK"
+
+	uint64_t alignUp(uint64_t offset)
+	{
+		return (offset + RESOURCE_ARCHIVE_ALIGNMENT - 1) & ~(RESOURCE_ARCHIVE_ALIGNMENT - 1);
+	}
+}
+
+std::string ResourceArchive::NormalizeName(const std::string& path)
+{
+	std::string name = path;
+	std::replace(name.begin(), name.end(), '\\', '/');
+	name = std::filesystem::path(name).lexically_normal().generic_string();
+	if (name == ".")
+		name.clear();
+	if (!name.empty() && name.back() == '/')
+		name.pop_back();
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return name;
+}
+
+bool ResourceArchive::Open(const std::string& path)
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(path))
+		return false;
+
+	const uint8_t* data = file->Data();
+	size_t size = file->Size();
+	const ResourceArchiveHeader* header = size >= sizeof(ResourceArchiveHeader) ? (const ResourceArchiveHeader*)data : nullptr;
+	if (header == nullptr || header->magic != RESOURCE_ARCHIVE_MAGIC || header->version != RESOURCE_ARCHIVE_VERSION)
+	{
+		std::cout << "ERROR::ARCHIVE::NOT_AN_ARCHIVE " << path << std::endl;
+		return false;
+	}
+	if (header->fileSize != size || header->entriesOffset + (uint64_t)header->entryCount * sizeof(ResourceArchiveEntry) > size
+		|| header->namesOffset + header->namesBytes > size)
+	{
+		std::cout << "ERROR::ARCHIVE::TRUNCATED " << path << std::endl;
+		return false;
+	}
+	const ResourceArchiveEntry* entry = (const ResourceArchiveEntry*)(data + header->entriesOffset);
+	for (uint32_t i = 0; i < header->entryCount; ++i, ++entry)
+	{
+		if (entry->offset + entry->size > size || (uint64_t)entry->nameOffset + entry->nameLength > header->namesBytes)
+		{
+			std::cout << "ERROR::ARCHIVE::BAD_ENTRY " << path << " entry " << i << std::endl;
+			return false;
+		}
+	}
+
+	mapping = std::move(file);
+	return true;
+}
+
+const ResourceArchiveEntry* ResourceArchive::Find(const std::string& name) const
+{
+	if (!mapping)
+		return nullptr;
+
+	// the index is sorted by name, a binary search touches a few of its pages and no data
+	const char* names = (const char*)mapping->Data() + header().namesOffset;
+	const ResourceArchiveEntry* first = entries();
+	const ResourceArchiveEntry* last = first + header().entryCount;
+	const ResourceArchiveEntry* found = std::lower_bound(first, last, std::string_view(name),
+		[names](const ResourceArchiveEntry& entry, std::string_view key)
+		{
+			return std::string_view(names + entry.nameOffset, entry.nameLength) < key;
+		});
+	if (found == last || std::string_view(names + found->nameOffset, found->nameLength) != name)
+		return nullptr;
+	return found;
+}
+
+bool ResourceArchive::Write(const std::string& directory, const std::string& archivePath,
+	const std::function<bool(const std::filesystem::path&)>& include)
+{
+	namespace fs = std::filesystem;
+
+	struct Source
+	{
+		fs::path path;
+		std::string name;
+		uint64_t size;
+		int64_t modifiedTime;
+	};
+	std::vector<Source> sources;
+	std::error_code error;
+	for (const fs::directory_entry& file : fs::recursive_directory_iterator(directory, error))
+	{
+		// the archive itself and its temporary file may be inside the directory
+		std::error_code sameError;
+		if (!file.is_regular_file() || !include(file.path()) || fs::equivalent(file.path(), archivePath, sameError)
+			|| file.path().filename() == fs::path(archivePath + ".tmp").filename())
+			continue;
+		Source source;
+		source.path = file.path();
+		source.name = NormalizeName(fs::relative(file.path(), directory).generic_string());
+		source.size = (uint64_t)file.file_size();
+		source.modifiedTime = (int64_t)file.last_write_time().time_since_epoch().count();
+		sources.push_back(source);
+	}
+	if (error)
+	{
+		std::cout << "ERROR::ARCHIVE::CANNOT_READ_DIRECTORY " << directory << ": " << error.message() << std::endl;
+		return false;
+	}
+	std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.name < b.name; });
+	for (size_t i = 1; i < sources.size(); ++i)
+	{
+		// names are case folded, so these two would shadow each other
+		if (sources[i].name == sources[i - 1].name)
+		{
+			std::cout << "ERROR::ARCHIVE::DUPLICATE_NAME " << sources[i - 1].path.string() << " and " << sources[i].path.string() << std::endl;
+			return false;
+		}
+	}
+
+	ResourceArchiveHeader header = {};
+	header.magic = RESOURCE_ARCHIVE_MAGIC;
+	header.version = RESOURCE_ARCHIVE_VERSION;
+	header.entryCount = (uint32_t)sources.size();
+	header.entriesOffset = alignUp(sizeof(ResourceArchiveHeader));
+
+	std::vector<ResourceArchiveEntry> entries(sources.size());
+	std::string names;
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		entries[i].nameOffset = (uint32_t)names.size();
+		entries[i].nameLength = (uint32_t)sources[i].name.size();
+		entries[i].size = sources[i].size;
+		entries[i].modifiedTime = sources[i].modifiedTime;
+		names += sources[i].name;
+	}
+	header.namesOffset = header.entriesOffset + entries.size() * sizeof(ResourceArchiveEntry);
+	header.namesBytes = names.size();
+	uint64_t offset = alignUp(header.namesOffset + header.namesBytes);
+	for (ResourceArchiveEntry& entry : entries)
+	{
+		entry.offset = offset;
+		offset = alignUp(offset + entry.size);
+	}
+	header.fileSize = offset;
+
+	// written under a temporary name first, a failed pack never replaces a working archive
+	std::string temporary = archivePath + ".tmp";
+	{
+		std::ofstream archive(temporary, std::ios::binary | std::ios::trunc);
+		std::vector<char> padding(RESOURCE_ARCHIVE_ALIGNMENT, 0);
+		auto padTo = [&](uint64_t target)
+		{
+			uint64_t position = (uint64_t)archive.tellp();
+			archive.write(padding.data(), (std::streamsize)(target - position));
+		};
+
+		archive.write((const char*)&header, sizeof(header));
+		padTo(header.entriesOffset);
+		archive.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(ResourceArchiveEntry)));
+		archive.write(names.data(), (std::streamsize)names.size());
+
+		std::vector<char> contents;
+		for (size_t i = 0; i < sources.size() && archive; ++i)
+		{
+			std::ifstream file(sources[i].path, std::ios::binary);
+			contents.resize((size_t)sources[i].size);
+			if (!file.read(contents.data(), (std::streamsize)contents.size()))
+			{
+				std::cout << "ERROR::ARCHIVE::CANNOT_READ " << sources[i].path.string() << std::endl;
+				archive.close();
+				fs::remove(temporary, error);
+				return false;
+			}
+			padTo(entries[i].offset);
+			archive.write(contents.data(), (std::streamsize)contents.size());
+		}
+		padTo(header.fileSize);
+		if (!archive)
+		{
+			std::cout << "ERROR::ARCHIVE::WRITE_FAILED " << archivePath << std::endl;
+			archive.close();
+			fs::remove(temporary, error);
+			return false;
+		}
+	}
+	fs::rename(temporary, archivePath, error);
+	if (error)
+	{
+		std::cout << "ERROR::ARCHIVE::WRITE_FAILED " << archivePath << ": " << error.message() << std::endl;
+		fs::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,68 @@
+#ifndef RESOURCE_ARCHIVE_CLASS_H
+#define RESOURCE_ARCHIVE_CLASS_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <functional>
+#include <filesystem>
+
+#include "MappedFile.h"
+
+// Every resource of a directory packed into one file: a header, an index sorted by name and
+// the file contents, each starting on a 64 byte boundary so data with alignment needs of its
+// own, like mesh files, keeps them. The whole archive is mapped once and resources are handed
+// out as pointers into the mapping
+const uint32_t RESOURCE_ARCHIVE_VERSION = 1;
+const uint64_t RESOURCE_ARCHIVE_ALIGNMENT = 64;
+
+struct ResourceArchiveHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	uint64_t entriesOffset;
+	uint64_t namesOffset;
+	uint64_t namesBytes;
+	uint64_t fileSize;
+};
+
+struct ResourceArchiveEntry
+{
+	uint64_t offset;
+	uint64_t size;
+	// last write time of the packed file, in std::filesystem::file_time_type ticks
+	int64_t modifiedTime;
+	// path relative to the packed directory, lower case with forward slashes
+	uint32_t nameOffset;
+	uint32_t nameLength;
+};
+
+class ResourceArchive
+{
+public:
+	// Maps path and checks the index against the file size
+	bool Open(const std::string& path);
+
+	// The entry for a name as NormalizeName returns it, null when it isn't packed
+	const ResourceArchiveEntry* Find(const std::string& name) const;
+	const uint8_t* Data(const ResourceArchiveEntry& entry) const { return mapping->Data() + entry.offset; }
+	// Shared with every resource handed out, the mapping stays until the last one is gone
+	const std::shared_ptr<const MappedFile>& Mapping() const { return mapping; }
+	uint32_t Count() const { return header().entryCount; }
+
+	// How names are stored and looked up: lower case, forward slashes, no "." or ".." parts
+	static std::string NormalizeName(const std::string& path);
+
+	// Packs the files under directory that include accepts into an archive at archivePath
+	static bool Write(const std::string& directory, const std::string& archivePath,
+		const std::function<bool(const std::filesystem::path&)>& include);
+
+private:
+	std::shared_ptr<const MappedFile> mapping;
+
+	const ResourceArchiveHeader& header() const { return *(const ResourceArchiveHeader*)mapping->Data(); }
+	const ResourceArchiveEntry* entries() const { return (const ResourceArchiveEntry*)(mapping->Data() + header().entriesOffset); }
+};
+#endif
@@ -1,96 +1,242 @@
 #include "Shader.h"
+#include "ShaderCache.h"
+#include "VirtualFileSystem.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
-{
-    // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::string geometryCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    std::ifstream gShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try
+ShaderSources ShaderSources::Load(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
+{
+    // 1. retrieve the vertex/fragment source code through the resource mounts
+    ShaderSources sources;
+    auto read = [](const char* path)
     {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-        // if geometry shader path is present, also load a geometry shader
-        if (geometryPath != nullptr)
-        {
-            gShaderFile.open(geometryPath);
-            std::stringstream gShaderStream;
-            gShaderStream << gShaderFile.rdbuf();
-            gShaderFile.close();
-            geometryCode = gShaderStream.str();
-        }
+        ResourceFile file = VirtualFileSystem::Open(path);
+        if (!file.Valid())
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+        return file.Text();
+    };
+    sources.vertex = read(vertexPath);
+    sources.fragment = read(fragmentPath);
+    // if geometry shader path is present, also load a geometry shader
+    if (geometryPath != nullptr)
+        sources.geometry = read(geometryPath);
+    return sources;
+}
+
+// inserts the defines right after #version, which has to stay the first statement.
+// The #line directive keeps compiler messages pointing at the lines of the file on disk
+static std::string injectDefines(const std::string& source, const ShaderDefines& defines)
+{
+    if (defines.empty() || source.empty())
+        return source;
+
+    size_t insertAt = 0;
+    int nextLine = 1;
+    size_t version = source.find("#version");
+    if (version != std::string::npos)
+    {
+        size_t lineEnd = source.find('\n', version);
+        insertAt = lineEnd != std::string::npos ? lineEnd + 1 : source.size();
+        nextLine = 1 + (int)std::count(source.begin(), source.begin() + insertAt, '\n');
     }
-    catch (std::ifstream::failure& e)
+
+    std::string block = insertAt == source.size() ? "\n" : "";
+    for (const auto& define : defines)
+        block += "#define " + define.first + " " + define.second + "\n";
+    block += "#line " + std::to_string(nextLine) + "\n";
+
+    std::string result = source;
+    result.insert(insertAt, block);
+    return result;
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines& defines)
+    : Shader(ShaderSources::Load(vertexPath, fragmentPath, geometryPath), defines)
+{
+}
+
+Shader::Shader(const ShaderSources& sources, const ShaderDefines& defines)
+{
+    std::string vertexCode = injectDefines(sources.vertex, defines);
+    std::string fragmentCode = injectDefines(sources.fragment, defines);
+    std::string geometryCode = injectDefines(sources.geometry, defines);
+    bool hasGeometry = !geometryCode.empty();
+
+    // 2. try the program binary cache, a hit skips compiling and linking entirely
+    ID = glCreateProgram();
+    if (ShaderCache::IsEnabled())
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        cacheKey = ShaderCache::Key(vertexCode, fragmentCode, geometryCode);
+        if (ShaderCache::Load(cacheKey, ID))
+        {
+            ShaderCache::Hits++;
+            reflectUniforms();
+            bindUniformBlocks();
+            state = State::Ready;
+            return;
+        }
+        ShaderCache::Misses++;
     }
+
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
-    // 2. compile shaders
-    unsigned int vertex, fragment;
+    // 3. submit the compile and link, nothing here waits on the driver. Status is only
+    // queried from IsReady() so every program can be in flight at the same time
     // vertex shader
     vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, NULL);
     glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
     // fragment Shader
     fragment = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragment, 1, &fShaderCode, NULL);
     glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
     // if geometry shader is given, compile geometry shader
-    unsigned int geometry;
-    if (geometryPath != nullptr)
+    if (hasGeometry)
     {
         const char* gShaderCode = geometryCode.c_str();
         geometry = glCreateShader(GL_GEOMETRY_SHADER);
         glShaderSource(geometry, 1, &gShaderCode, NULL);
         glCompileShader(geometry);
-        checkCompileErrors(geometry, "GEOMETRY");
     }
     // shader Program
-    ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
-    if (geometryPath != nullptr)
+    if (geometry != 0)
         glAttachShader(ID, geometry);
+    if (ShaderCache::IsEnabled())
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
+}
+
+// compile state
+// ------------------------------------------------------------------------
+Shader* Shader::placeholder = nullptr;
+
+void Shader::SetPlaceholder(Shader* shader)
+{
+    placeholder = shader;
+}
+
+void Shader::EnableParallelCompile()
+{
+    // 0xFFFFFFFF leaves the thread count up to the implementation
+    if (GLAD_GL_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+}
+
+bool Shader::IsReady()
+{
+    if (state != State::Compiling)
+        return state == State::Ready;
+    // without the extension there is no way to ask, the status query below blocks instead
+    if (GLAD_GL_KHR_parallel_shader_compile)
+    {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+        if (!completed)
+            return false;
+    }
+    finishLink();
+    return state == State::Ready;
+}
+
+void Shader::WaitUntilReady()
+{
+    if (state == State::Compiling)
+        finishLink();
+}
+
+void Shader::OnReady(std::function<void(Shader&)> callback)
+{
+    if (state == State::Compiling)
+    {
+        readyCallbacks.push_back(std::move(callback));
+        return;
+    }
+    if (state == State::Ready)
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+        glUseProgram(ID);
+        callback(*this);
+        glUseProgram(previous);
+    }
+}
+
+// the deferred half of the constructor, runs once the driver has finished with the program
+// ------------------------------------------------------------------------
+void Shader::finishLink()
+{
+    checkCompileErrors(vertex, "VERTEX");
+    checkCompileErrors(fragment, "FRAGMENT");
+    if (geometry != 0)
+        checkCompileErrors(geometry, "GEOMETRY");
     checkCompileErrors(ID, "PROGRAM");
+
+    GLint linked = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &linked);
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
-    if (geometryPath != nullptr)
+    if (geometry != 0)
         glDeleteShader(geometry);
+    vertex = fragment = geometry = 0;
+
+    if (!linked)
+    {
+        state = State::Failed;
+        readyCallbacks.clear();
+        return;
+    }
+    if (ShaderCache::IsEnabled())
+        ShaderCache::Store(cacheKey, ID);
+    reflectUniforms();
+    bindUniformBlocks();
+    state = State::Ready;
+
+    // callbacks set their uniforms on this program, put back whatever was bound before
+    std::vector<std::function<void(Shader&)>> callbacks;
+    callbacks.swap(readyCallbacks);
+    if (!callbacks.empty())
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+        glUseProgram(ID);
+        for (std::function<void(Shader&)>& callback : callbacks)
+            callback(*this);
+        glUseProgram(previous);
+    }
+}
+
+const Shader* Shader::target() const
+{
+    if (state == State::Ready)
+        return this;
+    if (placeholder != nullptr && placeholder != this && placeholder->state == State::Ready)
+        return placeholder;
+    return nullptr;
 }
+
 // activate the shader
 // ------------------------------------------------------------------------
 void Shader::Activate()
 {
-    glUseProgram(ID);
+    if (IsReady())
+        glUseProgram(ID);
+    else if (const Shader* fallback = target())
+        glUseProgram(fallback->ID);
 }
 
 // activate the shader
 // ------------------------------------------------------------------------
 void Shader::Delete()
 {
+    // a program deleted before it was ever polled still owns its stage objects
+    if (vertex != 0)
+        glDeleteShader(vertex);
+    if (fragment != 0)
+        glDeleteShader(fragment);
+    if (geometry != 0)
+        glDeleteShader(geometry);
+    vertex = fragment = geometry = 0;
     glDeleteProgram(ID);
 }
 
@@ -98,63 +244,213 @@ void Shader::Delete()
 // ------------------------------------------------------------------------
 void Shader::setBool(const std::string& name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(uniformLocation(name), (int)value);
 }
 // ------------------------------------------------------------------------
 void Shader::setInt(const std::string& name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(uniformLocation(name), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setFloat(const std::string& name, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(uniformLocation(name), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setVec2(const std::string& name, const glm::vec2& value) const
 {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2fv(uniformLocation(name), 1, &value[0]);
 }
 void Shader::setVec2(const std::string& name, float x, float y) const
 {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    glUniform2f(uniformLocation(name), x, y);
 }
 // ------------------------------------------------------------------------
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(uniformLocation(name), 1, &value[0]);
 }
 void Shader::setVec3(const std::string& name, float x, float y, float z) const
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(uniformLocation(name), x, y, z);
 }
 // ------------------------------------------------------------------------
 void Shader::setVec4(const std::string& name, const glm::vec4& value) const
 {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform4fv(uniformLocation(name), 1, &value[0]);
 }
 void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
 {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    glUniform4f(uniformLocation(name), x, y, z, w);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat2(const std::string& name, const glm::mat2& mat) const
 {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix2fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat3(const std::string& name, const glm::mat3& mat) const
 {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix3fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat4(const std::string& name, const glm::mat4& mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+// handle based uniform functions
+// ------------------------------------------------------------------------
+void Shader::setUniform(Uniform<bool> uniform, bool value) const
+{
+    glUniform1i(handleLocation(uniform.id), (int)value);
+}
+void Shader::setUniform(Uniform<int> uniform, int value) const
+{
+    glUniform1i(handleLocation(uniform.id), value);
+}
+void Shader::setUniform(Uniform<float> uniform, float value) const
+{
+    glUniform1f(handleLocation(uniform.id), value);
+}
+void Shader::setUniform(Uniform<glm::vec2> uniform, const glm::vec2& value) const
+{
+    glUniform2fv(handleLocation(uniform.id), 1, &value[0]);
+}
+void Shader::setUniform(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+{
+    glUniform3fv(handleLocation(uniform.id), 1, &value[0]);
+}
+void Shader::setUniform(Uniform<glm::vec4> uniform, const glm::vec4& value) const
+{
+    glUniform4fv(handleLocation(uniform.id), 1, &value[0]);
+}
+void Shader::setUniform(Uniform<glm::mat2> uniform, const glm::mat2& mat) const
+{
+    glUniformMatrix2fv(handleLocation(uniform.id), 1, GL_FALSE, &mat[0][0]);
+}
+void Shader::setUniform(Uniform<glm::mat3> uniform, const glm::mat3& mat) const
+{
+    glUniformMatrix3fv(handleLocation(uniform.id), 1, GL_FALSE, &mat[0][0]);
+}
+void Shader::setUniform(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
+{
+    glUniformMatrix4fv(handleLocation(uniform.id), 1, GL_FALSE, &mat[0][0]);
+}
+
+// uniform lookup
+// ------------------------------------------------------------------------
+GLint Shader::GetUniformLocation(const std::string& name) const
+{
+    auto it = uniformLocations.find(name);
+    return it != uniformLocations.end() ? it->second : -1;
+}
+
+GLint Shader::uniformLocation(const std::string& name) const
+{
+    const Shader* program = target();
+    return program != nullptr ? program->GetUniformLocation(name) : -1;
+}
+
+// the registry lives in function statics so handles can be built during static initialization
+static std::vector<std::string>& internedUniformNames()
+{
+    static std::vector<std::string> names;
+    return names;
+}
+
+unsigned int Shader::InternUniformName(const std::string& name)
+{
+    static std::unordered_map<std::string, unsigned int> ids;
+    auto it = ids.find(name);
+    if (it != ids.end())
+        return it->second;
+
+    std::vector<std::string>& names = internedUniformNames();
+    unsigned int id = (unsigned int)names.size();
+    names.push_back(name);
+    ids.emplace(name, id);
+    return id;
+}
+
+GLint Shader::handleLocation(unsigned int id) const
+{
+    if (id == UINT_MAX)
+        return -1;
+    // handle ids are shared by every program, so sets made while compiling resolve against the placeholder
+    const Shader* program = target();
+    if (program == nullptr)
+        return -1;
+    if (program != this)
+        return program->handleLocation(id);
+    if (id >= handleLocations.size())
+    {
+        // resolve every handle interned since the last lookup in one go
+        const std::vector<std::string>& names = internedUniformNames();
+        size_t first = handleLocations.size();
+        handleLocations.resize(names.size());
+        for (size_t i = first; i < names.size(); ++i)
+            handleLocations[i] = GetUniformLocation(names[i]);
+    }
+    return handleLocations[id];
+}
+
+// builds the name -> location table from the program's active uniforms
+// ------------------------------------------------------------------------
+void Shader::reflectUniforms()
+{
+    uniformLocations.clear();
+    handleLocations.clear();
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+    for (GLint i = 0; i < count; ++i)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        // members of uniform blocks have no location
+        if (location < 0)
+            continue;
+        uniformLocations[name] = location;
+
+        // arrays report as "name[0]", register the bare name and every element
+        size_t bracket = name.rfind("[0]");
+        if (bracket != std::string::npos && bracket + 3 == name.size())
+        {
+            std::string base = name.substr(0, bracket);
+            uniformLocations[base] = location;
+            for (GLint element = 1; element < size; ++element)
+            {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+            }
+        }
+    }
 }
 
 
 
+// attaches the shared uniform blocks this program declares to their fixed binding points
+// ------------------------------------------------------------------------
+void Shader::bindUniformBlocks()
+{
+    for (const UniformBlockName& block : uniformBlockBindings)
+    {
+        GLuint index = glGetUniformBlockIndex(ID, block.name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, block.binding);
+    }
+}
+
 // utility function for checking shader compilation/linking errors.
 // ------------------------------------------------------------------------
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
@@ -2,10 +2,43 @@
 #include <glad/glad.h> // include glad to get all the required OpenGL headers
 #include <glm/glm.hpp>
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <functional>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+#include "UniformBlocks.h"
+
+// Typed handle to a uniform. The name is interned once when the handle is built and the
+// resulting id indexes a per-program location table, so per-frame sets do no string work.
+template <typename T>
+struct Uniform
+{
+    unsigned int id = UINT_MAX;
+
+    Uniform() = default;
+    explicit Uniform(const std::string& name);
+};
+
+// Preprocessor defines inserted into every stage. Ordered so equal sets always produce
+// identical sources, and with them identical binary cache keys.
+typedef std::map<std::string, std::string> ShaderDefines;
+
+// GLSL source of each stage, geometry is left empty when the program has none
+struct ShaderSources
+{
+    std::string vertex;
+    std::string fragment;
+    std::string geometry;
+
+    static ShaderSources Load(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+};
 
 class Shader
 {
@@ -14,10 +47,26 @@ public:
     unsigned int ID;
 
     // constructor reads and builds the shader
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
-    // use/activate the shader
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const ShaderDefines& defines = ShaderDefines());
+    // builds from sources already in memory, used to compile several variants of one file
+    Shader(const ShaderSources& sources, const ShaderDefines& defines = ShaderDefines());
+    // use/activate the shader, binds the placeholder program while this one is still compiling
     void Activate();
     void Delete();
+
+    // polls the driver without blocking, true once the program has linked
+    bool IsReady();
+    // blocks until compiling and linking have finished
+    void WaitUntilReady();
+    bool HasFailed() const { return state == State::Failed; }
+    // runs once with the program bound as soon as it has linked, right away if it already has
+    void OnReady(std::function<void(Shader&)> callback);
+
+    // program drawn with in place of any shader that hasn't finished linking yet
+    static void SetPlaceholder(Shader* shader);
+    // lets the driver compile on as many threads as it likes when GL_KHR_parallel_shader_compile is present
+    static void EnableParallelCompile();
+
     // utility uniform functions
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
@@ -35,8 +84,46 @@ public:
     void setMat2(const std::string& name, const glm::mat2& mat) const;    
     void setMat3(const std::string& name, const glm::mat3& mat) const;
     void setMat4(const std::string& name, const glm::mat4& mat) const;
-    
+
+    // handle based uniform functions, resolve the handle once and reuse it every frame
+    void setUniform(Uniform<bool> uniform, bool value) const;
+    void setUniform(Uniform<int> uniform, int value) const;
+    void setUniform(Uniform<float> uniform, float value) const;
+    void setUniform(Uniform<glm::vec2> uniform, const glm::vec2& value) const;
+    void setUniform(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+    void setUniform(Uniform<glm::vec4> uniform, const glm::vec4& value) const;
+    void setUniform(Uniform<glm::mat2> uniform, const glm::mat2& mat) const;
+    void setUniform(Uniform<glm::mat3> uniform, const glm::mat3& mat) const;
+    void setUniform(Uniform<glm::mat4> uniform, const glm::mat4& mat) const;
+
+    // location of an active uniform from the table built at link time, -1 if it isn't active
+    GLint GetUniformLocation(const std::string& name) const;
+    // maps a uniform name to an id shared by every program
+    static unsigned int InternUniformName(const std::string& name);
 
 private:
+    enum class State { Compiling, Ready, Failed };
+    State state = State::Compiling;
+    // stage objects kept alive until the link completes so their logs can be read
+    unsigned int vertex = 0, fragment = 0, geometry = 0;
+    uint64_t cacheKey = 0;
+    std::vector<std::function<void(Shader&)>> readyCallbacks;
+    static Shader* placeholder;
+
+    // name -> location of every active uniform, filled once after linking
+    std::unordered_map<std::string, GLint> uniformLocations;
+    // interned uniform id -> location in this program, grown lazily as new handles show up
+    mutable std::vector<GLint> handleLocations;
+
     void checkCompileErrors(unsigned int shader, std::string type);
-};
\ No newline at end of file
+    void reflectUniforms();
+    void bindUniformBlocks();
+    void finishLink();
+    // program uniform sets go to, the placeholder while this one is still compiling
+    const Shader* target() const;
+    GLint uniformLocation(const std::string& name) const;
+    GLint handleLocation(unsigned int id) const;
+};
+
+template <typename T>
+Uniform<T>::Uniform(const std::string& name) : id(Shader::InternUniformName(name)) {}
\ No newline at end of file
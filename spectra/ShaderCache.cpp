@@ -0,0 +1,165 @@
+#include "ShaderCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	// Bump whenever the entry layout changes so old files are ignored
+	const uint32_t CACHE_VERSION = 1;
+	const char CACHE_MAGIC[4] = { 'S', 'P', 'S', 'C' };
+
+	struct EntryHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t binaryLength;
+		uint32_t driverIdLength;
+	};
+
+	// 64-bit FNV-1a
+	uint64_t hashBytes(uint64_t hash, const std::string& bytes)
+	{
+		for (unsigned char c : bytes)
+		{
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		// separator so ("ab", "c") and ("a", "bc") hash differently
+		hash ^= 0xFF;
+		hash *= 1099511628211ull;
+		return hash;
+	}
+
+	std::string glString(GLenum name)
+	{
+		const GLubyte* value = glGetString(name);
+		return value ? std::string((const char*)value) : std::string();
+	}
+}
+
+bool ShaderCache::enabled = false;
+std::string ShaderCache::cacheDirectory;
+std::string ShaderCache::driverId;
+unsigned int ShaderCache::Hits = 0;
+unsigned int ShaderCache::Misses = 0;
+
+void ShaderCache::Init(const std::string& directory)
+{
+	enabled = false;
+	if (!GLAD_GL_ARB_get_program_binary)
+	{
+		std::cout << "Shader cache disabled: GL_ARB_get_program_binary not supported" << std::endl;
+		return;
+	}
+
+	GLint numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	if (numFormats <= 0)
+	{
+		std::cout << "Shader cache disabled: driver exposes no program binary formats" << std::endl;
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		std::cout << "Shader cache disabled: cannot create " << directory << ": " << error.message() << std::endl;
+		return;
+	}
+
+	cacheDirectory = directory;
+	driverId = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+	enabled = true;
+}
+
+bool ShaderCache::IsEnabled()
+{
+	return enabled;
+}
+
+uint64_t ShaderCache::Key(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode)
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash = hashBytes(hash, driverId);
+	hash = hashBytes(hash, vertexCode);
+	hash = hashBytes(hash, fragmentCode);
+	hash = hashBytes(hash, geometryCode);
+	return hash;
+}
+
+bool ShaderCache::Load(uint64_t key, GLuint program)
+{
+	if (!enabled)
+		return false;
+
+	std::ifstream file(entryPath(key), std::ios::binary);
+	if (!file)
+		return false;
+
+	EntryHeader header;
+	if (!file.read((char*)&header, sizeof(header)))
+		return false;
+	if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION || header.key != key)
+		return false;
+
+	// the key already covers the driver, comparing the full string guards against hash collisions
+	std::string storedDriverId(header.driverIdLength, '\0');
+	if (!file.read(&storedDriverId[0], header.driverIdLength) || storedDriverId != driverId)
+		return false;
+
+	std::vector<char> binary(header.binaryLength);
+	if (!file.read(binary.data(), binary.size()))
+		return false;
+
+	glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+	// drivers may reject binaries they produced themselves (e.g. after an update that kept the version string)
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	return success != 0;
+}
+
+void ShaderCache::Store(uint64_t key, GLuint program)
+{
+	if (!enabled)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+	EntryHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.binaryFormat = format;
+	header.binaryLength = (uint32_t)length;
+	header.driverIdLength = (uint32_t)driverId.size();
+
+	std::ofstream file(entryPath(key), std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	file.write(driverId.data(), driverId.size());
+	file.write(binary.data(), binary.size());
+	if (!file)
+		std::cout << "ERROR::SHADER_CACHE::WRITE_FAILED: " << entryPath(key) << std::endl;
+}
+
+std::string ShaderCache::entryPath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return (std::filesystem::path(cacheDirectory) / name).string();
+}
@@ -0,0 +1,36 @@
+#ifndef SHADER_CACHE_CLASS_H
+#define SHADER_CACHE_CLASS_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries (GL_ARB_get_program_binary).
+// Entries are keyed by a hash of the final shader sources and the driver's vendor,
+// renderer and version strings, so a driver update misses and rebuilds from source.
+class ShaderCache
+{
+public:
+	// Enables the cache if the driver can hand out program binaries, entries live in directory
+	static void Init(const std::string& directory);
+	static bool IsEnabled();
+
+	static uint64_t Key(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode);
+
+	// Loads a cached binary into program. False when there is no entry or the driver rejects it
+	static bool Load(uint64_t key, GLuint program);
+	// Writes the binary of a successfully linked program
+	static void Store(uint64_t key, GLuint program);
+
+	// Programs served from the cache and programs compiled from source since startup
+	static unsigned int Hits;
+	static unsigned int Misses;
+
+private:
+	static bool enabled;
+	static std::string cacheDirectory;
+	static std::string driverId;
+
+	static std::string entryPath(uint64_t key);
+};
+#endif
@@ -0,0 +1,57 @@
+#include "ShaderPermutations.h"
+
+ShaderPermutations::ShaderPermutations(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines& baseDefines)
+	: baseDefines(baseDefines)
+{
+	sources = ShaderSources::Load(vertexPath, fragmentPath, geometryPath);
+}
+
+Shader& ShaderPermutations::Get(const ShaderDefines& defines)
+{
+	return Get(defines, Key(defines));
+}
+
+Shader& ShaderPermutations::Get(const ShaderDefines& defines, const std::string& key)
+{
+	auto it = variants.find(key);
+	if (it == variants.end())
+	{
+		ShaderDefines variantDefines = defines;
+		variantDefines.insert(baseDefines.begin(), baseDefines.end());
+		std::unique_ptr<Shader> shader(new Shader(sources, variantDefines));
+		if (onCreate)
+			shader->OnReady(onCreate);
+		it = variants.emplace(key, std::move(shader)).first;
+	}
+
+	Shader& shader = *it->second;
+	if (shader.IsReady())
+	{
+		lastReady = &shader;
+		return shader;
+	}
+	return lastReady != nullptr ? *lastReady : shader;
+}
+
+void ShaderPermutations::OnCreate(std::function<void(Shader&)> callback)
+{
+	onCreate = callback;
+	for (auto& variant : variants)
+		variant.second->OnReady(callback);
+}
+
+void ShaderPermutations::Delete()
+{
+	for (auto& variant : variants)
+		variant.second->Delete();
+	variants.clear();
+	lastReady = nullptr;
+}
+
+std::string ShaderPermutations::Key(const ShaderDefines& defines)
+{
+	std::string key;
+	for (const auto& define : defines)
+		key += define.first + "=" + define.second + ";";
+	return key;
+}
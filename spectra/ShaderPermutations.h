@@ -0,0 +1,39 @@
+#ifndef SHADER_PERMUTATIONS_CLASS_H
+#define SHADER_PERMUTATIONS_CLASS_H
+
+#include <memory>
+#include <functional>
+#include <unordered_map>
+
+#include "Shader.h"
+
+// Specialised variants of one set of shader files, one program per distinct define set.
+// The files are read once, variants are compiled the first time they are asked for.
+class ShaderPermutations
+{
+public:
+	// baseDefines are added to every variant, e.g. INSTANCED for a set that only draws instanced meshes
+	ShaderPermutations(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const ShaderDefines& baseDefines = ShaderDefines());
+
+	// Variant for this define set. While a new variant is still compiling the last one that
+	// was ready is returned instead, so switching features never drops to the placeholder
+	Shader& Get(const ShaderDefines& defines);
+	// Same with the key of defines already built, for callers that keep it between frames
+	Shader& Get(const ShaderDefines& defines, const std::string& key);
+	// Runs on every variant once it has linked, for uniforms that never change
+	void OnCreate(std::function<void(Shader&)> callback);
+
+	size_t Count() const { return variants.size(); }
+	void Delete();
+
+	// Canonical "NAME=VALUE;..." string identifying a define set
+	static std::string Key(const ShaderDefines& defines);
+
+private:
+	ShaderSources sources;
+	ShaderDefines baseDefines;
+	std::unordered_map<std::string, std::unique_ptr<Shader>> variants;
+	std::function<void(Shader&)> onCreate;
+	Shader* lastReady = nullptr;
+};
+#endif
@@ -1,10 +1,19 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED
+//Same per-instance buffer layout the scene pass draws the cubes with
+layout (location = 4) in mat4 aInstanceModel;
+#else
+uniform mat4 model;
+#endif
 
+//Light projection * view of the cascade being drawn
 uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
 
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+#endif
     gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
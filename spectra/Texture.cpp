@@ -1,53 +1,35 @@
 #include "Texture.h"
 
-Texture::Texture(const std::string& dir, const char* image , const char* textureType, GLuint textureSlot, GLenum pixelType)
+Texture::Texture(const std::string& dir, const char* image, const char* textureType, GLuint textureSlot, GLenum pixelType, const TextureParams& params)
 {
 	type = textureType;
 	slot = textureSlot;
 	texPath = image;
-	std::string filename = dir + '/' + image;
 
-	// load and generate the texture
-	int width, height, nrChannels;
-
-	glGenTextures(1, &ID);
-	glActiveTexture(GL_TEXTURE0 + textureSlot);
-	glBindTexture(GL_TEXTURE_2D, ID);
-
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
+	TextureParams textureParams = params;
+	textureParams.pixelType = pixelType;
+	resource = TextureManager::Acquire(dir + '/' + image, textureParams);
+	ID = resource->ID;
+}
 
-	switch (nrChannels)
-	{
-		case 1: 
-			format = GL_RED;
-			break;
-		default:
-		case 3: 
-			format = GL_RGB;
-			break;
-		case 4: 
-			format = GL_RGBA;
-			break;
-	};
+Texture::Texture(Texture&& other) noexcept
+	: ID(other.ID), type(other.type), slot(other.slot), texPath(std::move(other.texPath)), resource(std::move(other.resource))
+{
+	other.ID = 0;
+}
 
-	if (data)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, pixelType, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
+Texture& Texture::operator=(Texture&& other) noexcept
+{
+	if (this != &other)
 	{
-		std::cout << "Failed to load texture" << std::endl;
+		ID = other.ID;
+		type = other.type;
+		slot = other.slot;
+		texPath = std::move(other.texPath);
+		resource = std::move(other.resource);
+		other.ID = 0;
 	}
-	stbi_image_free(data);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	return *this;
 }
 
 void Texture::TextureUnit(Shader& shader, const char* uniform, GLuint unit)
@@ -56,6 +38,12 @@ void Texture::TextureUnit(Shader& shader, const char* uniform, GLuint unit)
 	shader.setInt(uniform, unit);
 }
 
+void Texture::TextureUnit(Shader& shader, Uniform<int> uniform, GLuint unit)
+{
+	shader.Activate();
+	shader.setUniform(uniform, unit);
+}
+
 void Texture::Activate() 
 {
 	glActiveTexture(slot);
@@ -75,5 +63,6 @@ void Texture::Unbind()
 
 void Texture::Delete()
 {
-	glDeleteTextures(1, &ID);
+	resource.reset();
+	ID = 0;
 }
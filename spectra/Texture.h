@@ -4,24 +4,35 @@
 #include <glad/glad.h>
 #include "stb_image.h"
 #include "Shader.h"
+#include "TextureManager.h"
 
 class Texture
 {
 	public:
-		GLuint ID;
+		GLuint ID = 0;
 		const char* type;
 		GLuint slot;
-		GLenum format;
 		std::string texPath;
 
-		Texture(const std::string& dir, const char* image, const char* textureType, GLuint slot, GLenum pixelType);
+		// Looks the image up in the TextureManager, only the first request for a file loads it
+		Texture(const std::string& dir, const char* image, const char* textureType, GLuint slot, GLenum pixelType,
+			const TextureParams& params = TextureParams());
+
+		// A handle to a shared texture object, copies share it and the last one to go frees it
+		Texture(const Texture&) = default;
+		Texture& operator=(const Texture&) = default;
+		Texture(Texture&& other) noexcept;
+		Texture& operator=(Texture&& other) noexcept;
 
 		void TextureUnit(Shader& shader, const char* uniform, GLuint unit);
+		void TextureUnit(Shader& shader, Uniform<int> uniform, GLuint unit);
 		void Activate();
 		void Bind();
 		void Unbind();
+		// Releases this handle, the texture object goes once no other handle uses it
 		void Delete();
+
+	private:
+		std::shared_ptr<TextureResource> resource;
 };
 #endif 
-
-
@@ -0,0 +1,253 @@
+#include "TextureManager.h"
+#include "DDSFile.h"
+#include "VirtualFileSystem.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+TextureStreamer* TextureManager::streamer = nullptr;
+std::unordered_map<std::string, std::weak_ptr<TextureResource>> TextureManager::textures;
+unsigned int TextureManager::Hits = 0;
+unsigned int TextureManager::Misses = 0;
+
+std::string TextureParams::Key() const
+{
+	return std::to_string(pixelType) + ',' + std::to_string(wrap) + ',' + std::to_string(minFilter) + ',' + std::to_string(magFilter);
+}
+
+TextureResource::~TextureResource()
+{
+	if (ID == 0)
+		return;
+	// a decode still in flight must not land in a recycled texture name
+	if (TextureManager::Streamer() != nullptr)
+		TextureManager::Streamer()->Cancel(ID);
+	glDeleteTextures(1, &ID);
+}
+
+void TextureManager::SetStreamer(TextureStreamer* textureStreamer)
+{
+	streamer = textureStreamer;
+}
+
+std::string TextureManager::CanonicalPath(const std::string& path)
+{
+	// "a/../b.png", "./b.png" and "B.PNG" on Windows all name the same file. Only lexical, the
+	// path may name a resource that exists inside a mounted archive and nowhere on disk
+	std::string generic = path;
+	std::replace(generic.begin(), generic.end(), '\\', '/');
+	std::string result = std::filesystem::path(generic).lexically_normal().make_preferred().string();
+#ifdef _WIN32
+	for (char& c : result)
+		c = (char)tolower((unsigned char)c);
+#endif
+	return result;
+}
+
+std::shared_ptr<TextureResource> TextureManager::Acquire(const std::string& path, const TextureParams& params)
+{
+	std::string canonical = CanonicalPath(path);
+	std::string key = canonical + '|' + params.Key();
+
+	auto it = textures.find(key);
+	if (it != textures.end())
+	{
+		if (std::shared_ptr<TextureResource> texture = it->second.lock())
+		{
+			Hits++;
+			return texture;
+		}
+	}
+
+	Misses++;
+	std::shared_ptr<TextureResource> texture = std::make_shared<TextureResource>();
+	texture->path = canonical;
+	texture->params = params;
+	load(*texture);
+	textures[key] = texture;
+
+	// drop entries whose textures have all been released so the map doesn't grow with churn
+	for (auto entry = textures.begin(); entry != textures.end();)
+	{
+		if (entry->second.expired())
+			entry = textures.erase(entry);
+		else
+			++entry;
+	}
+	return texture;
+}
+
+void TextureManager::load(TextureResource& texture)
+{
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+	glGenTextures(1, &texture.ID);
+	glBindTexture(GL_TEXTURE_2D, texture.ID);
+
+	// set the texture wrapping/filtering options (on the currently bound texture object)
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture.params.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture.params.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.params.minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texture.params.magFilter);
+
+	// a transcoded .dds next to the image goes up as is, no decode and a fraction of the memory
+	if (loadCompressed(texture))
+	{
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+		return;
+	}
+
+	if (streamer != nullptr)
+	{
+		// grey until the streamer has the decoded image resident
+		const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		texture.residentBytes = sizeof(placeholder);
+		// the streamer drops the job when the resource is destroyed, so the pointer outlives the callback
+		TextureResource* resource = &texture;
+		streamer->Load(texture.ID, texture.path, texture.params.pixelType, [resource](GLsizei width, GLsizei height, int channels)
+		{
+			resource->residentBytes = mipChainBytes(width, height, channels);
+		});
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+		return;
+	}
+
+	int width = 0, height = 0, nrChannels = 0;
+	stbi_set_flip_vertically_on_load(true);
+	ResourceFile file = VirtualFileSystem::Open(texture.path);
+	unsigned char* data = file.Valid() ? stbi_load_from_memory(file.Data(), (int)file.Size(), &width, &height, &nrChannels, 0) : nullptr;
+
+	// stored with the image's own channel count, not padded out to RGBA
+	GLenum format, internalFormat;
+	switch (nrChannels)
+	{
+		case 1:
+			format = GL_RED;
+			internalFormat = GL_R8;
+			break;
+		case 2:
+			format = GL_RG;
+			internalFormat = GL_RG8;
+			break;
+		default:
+		case 3:
+			format = GL_RGB;
+			internalFormat = GL_RGB8;
+			break;
+		case 4:
+			format = GL_RGBA;
+			internalFormat = GL_RGBA8;
+			break;
+	};
+
+	if (data)
+	{
+		// rows of RGB and single channel images aren't 4 byte aligned
+		GLint previousAlignment = 4;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, texture.params.pixelType, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		texture.residentBytes = mipChainBytes(width, height, nrChannels);
+	}
+	else
+	{
+		std::cout << "Failed to load texture " << texture.path << std::endl;
+	}
+	stbi_image_free(data);
+	glBindTexture(GL_TEXTURE_2D, previousTexture);
+}
+
+std::string TextureManager::CompressedPath(const std::string& path)
+{
+	std::filesystem::path source(path);
+	std::string compressed = std::filesystem::path(source).replace_extension(".dds").string();
+	int64_t compressedTime = VirtualFileSystem::ModifiedTime(compressed);
+	if (compressedTime == 0)
+		return std::string();
+	// an image edited after it was transcoded wins until texconv runs again. Archives leave out
+	// images that have a .dds, then the .dds is all there is
+	if (compressed != path && VirtualFileSystem::ModifiedTime(path) > compressedTime)
+		return std::string();
+	return compressed;
+}
+
+bool TextureManager::loadCompressed(TextureResource& texture)
+{
+	std::string compressed = CompressedPath(texture.path);
+	if (compressed.empty())
+		return false;
+
+	// the blocks upload straight from the mapped file
+	ResourceFile file = VirtualFileSystem::Open(compressed);
+	DDSImage image;
+	if (!file.Valid() || !ParseDDS(file.Data(), file.Size(), image, compressed))
+		return false;
+	GLenum internalFormat = CompressedFormat(image.format);
+	if (internalFormat == 0)
+	{
+		std::cout << "Texture " << compressed << ": " << DDSImage::Name(image.format)
+			<< " not supported by the driver, decoding the image instead" << std::endl;
+		return false;
+	}
+
+	texture.residentBytes = 0;
+	for (size_t i = 0; i < image.levels.size(); ++i)
+	{
+		const DDSImage::Level& level = image.levels[i];
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, internalFormat, level.width, level.height, 0,
+			(GLsizei)level.size, image.Blocks() + level.offset);
+		texture.residentBytes += level.size;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+	return true;
+}
+
+GLenum TextureManager::CompressedFormat(BlockFormat format)
+{
+	switch (format)
+	{
+		case BlockFormat::BC1: return GLAD_GL_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+		case BlockFormat::BC3: return GLAD_GL_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+		// RGTC is core since GL 3.0
+		case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+		case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+		case BlockFormat::BC7: return GLAD_GL_ARB_texture_compression_bptc ? GL_COMPRESSED_RGBA_BPTC_UNORM : 0;
+	}
+	return 0;
+}
+
+size_t TextureManager::mipChainBytes(GLsizei width, GLsizei height, int bytesPerTexel)
+{
+	size_t bytes = 0;
+	for (;;)
+	{
+		bytes += (size_t)width * height * bytesPerTexel;
+		if (width == 1 && height == 1)
+			return bytes;
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+}
+
+unsigned int TextureManager::Count()
+{
+	unsigned int count = 0;
+	for (auto& entry : textures)
+		if (!entry.second.expired())
+			count++;
+	return count;
+}
+
+size_t TextureManager::ResidentBytes()
+{
+	size_t bytes = 0;
+	for (auto& entry : textures)
+		if (std::shared_ptr<TextureResource> texture = entry.second.lock())
+			bytes += texture->residentBytes;
+	return bytes;
+}
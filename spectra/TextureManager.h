@@ -0,0 +1,77 @@
+#ifndef TEXTURE_MANAGER_CLASS_H
+#define TEXTURE_MANAGER_CLASS_H
+
+#include <glad/glad.h>
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "TextureStreamer.h"
+#include "DDSFile.h"
+
+// How an image is uploaded and sampled, part of the cache key next to the path
+struct TextureParams
+{
+	GLenum pixelType = GL_UNSIGNED_BYTE;
+	GLint wrap = GL_REPEAT;
+	GLint minFilter = GL_LINEAR;
+	GLint magFilter = GL_LINEAR;
+
+	std::string Key() const;
+};
+
+// One GL texture object shared by every Texture handle made from the same file and parameters.
+// The object is deleted when the last handle lets go of it
+class TextureResource
+{
+public:
+	GLuint ID = 0;
+	std::string path;
+	TextureParams params;
+	// GPU memory held, including the mip chain. A placeholder texel until the image is resident
+	size_t residentBytes = 0;
+
+	TextureResource() = default;
+	~TextureResource();
+
+	TextureResource(const TextureResource&) = delete;
+	TextureResource& operator=(const TextureResource&) = delete;
+};
+
+// Loads each image once. Textures are keyed by canonical path plus parameters and handed out
+// as shared handles, so a scene that references the same file a hundred times decodes and
+// uploads it once. Only weak references are kept, an unused texture is freed right away
+class TextureManager
+{
+public:
+	// Returns the texture for path, loading it on a miss. Render thread only
+	static std::shared_ptr<TextureResource> Acquire(const std::string& path, const TextureParams& params = TextureParams());
+
+	// When set, misses decode on worker threads and stream in, showing a placeholder meanwhile
+	static void SetStreamer(TextureStreamer* textureStreamer);
+	static TextureStreamer* Streamer() { return streamer; }
+
+	// Requests served from a live texture and requests that had to load the file
+	static unsigned int Hits;
+	static unsigned int Misses;
+
+	// Live textures and the GPU memory they hold
+	static unsigned int Count();
+	static size_t ResidentBytes();
+
+	static std::string CanonicalPath(const std::string& path);
+	// The .dds texconv wrote for path, empty when there is none or the image is newer
+	static std::string CompressedPath(const std::string& path);
+	// GL internal format for a block format, 0 when the driver can't sample it
+	static GLenum CompressedFormat(BlockFormat format);
+
+private:
+	static TextureStreamer* streamer;
+	static std::unordered_map<std::string, std::weak_ptr<TextureResource>> textures;
+
+	static void load(TextureResource& texture);
+	// Uploads the .dds texconv wrote next to the image, false when there is none or it is stale
+	static bool loadCompressed(TextureResource& texture);
+	static size_t mipChainBytes(GLsizei width, GLsizei height, int bytesPerTexel);
+};
+#endif
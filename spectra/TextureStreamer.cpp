@@ -0,0 +1,280 @@
+#include "TextureStreamer.h"
+#include "VirtualFileSystem.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include "stb_image.h"
+
+TextureStreamer::TextureStreamer(ThreadPool& pool, GLsizeiptr bytesPerFrame) : BytesPerFrame(bytesPerFrame), pool(pool)
+{
+	glGenBuffers(2, pbos);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	Delete();
+}
+
+void TextureStreamer::Load(GLuint texture, const std::string& path, GLenum pixelType,
+	std::function<void(GLsizei width, GLsizei height, int channels)> onResident)
+{
+	std::unique_ptr<Job> job(new Job());
+	job->texture = texture;
+	job->path = path;
+	job->pixelType = pixelType;
+	job->onResident = std::move(onResident);
+	job->decoding = pool.Submit([path]() { return Decode(path); });
+	jobs.push_back(std::move(job));
+}
+
+void TextureStreamer::LoadLayer(GLuint texture, GLint layer, std::shared_future<LayerImage> image, std::function<void()> onResident)
+{
+	std::unique_ptr<LayerJob> job(new LayerJob());
+	job->texture = texture;
+	job->layer = layer;
+	job->onResident = std::move(onResident);
+	job->preparing = std::move(image);
+	layerJobs.push_back(std::move(job));
+}
+
+void TextureStreamer::Cancel(GLuint texture)
+{
+	// a decode that is still running just finishes into a job nobody reads
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [texture](const std::unique_ptr<Job>& job) { return job->texture == texture; }), jobs.end());
+	layerJobs.erase(std::remove_if(layerJobs.begin(), layerJobs.end(),
+		[texture](const std::unique_ptr<LayerJob>& job) { return job->texture == texture; }), layerJobs.end());
+}
+
+DecodedImage TextureStreamer::Decode(const std::string& path)
+{
+	DecodedImage image;
+	// the global flip flag isn't safe to touch from several threads at once
+	stbi_set_flip_vertically_on_load_thread(true);
+	// the encoded file is read in place from its mapping, only the decoded pixels are allocated
+	ResourceFile file = VirtualFileSystem::Open(path);
+	if (!file.Valid())
+		return image;
+	image.pixels.reset(stbi_load_from_memory(file.Data(), (int)file.Size(), &image.width, &image.height, &image.channels, 0));
+	if (!image.pixels)
+		return image;
+
+	// average colour for the placeholder mip
+	size_t texels = (size_t)image.width * image.height;
+	unsigned long long sum[4] = { 0, 0, 0, 0 };
+	const unsigned char* pixel = image.pixels.get();
+	for (size_t i = 0; i < texels; ++i, pixel += image.channels)
+	{
+		for (int c = 0; c < image.channels; ++c)
+			sum[c] += pixel[c];
+	}
+	glm::u8vec4 average(0, 0, 0, 255);
+	for (int c = 0; c < image.channels; ++c)
+		average[c] = (unsigned char)(sum[c] / texels);
+	// single channel images are uploaded as GL_RED
+	if (image.channels == 1)
+		average = glm::u8vec4(average.r, 0, 0, 255);
+	image.average = average;
+	return image;
+}
+
+void TextureStreamer::Update()
+{
+	UploadedLastFrame = 0;
+	GLint previousTexture = 0, previousArray = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousArray);
+	GLint previousAlignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+	// rows of RGB images aren't 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (size_t i = 0; i < jobs.size();)
+	{
+		Job& job = *jobs[i];
+		if (!job.decoded)
+		{
+			if (job.decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++i;
+				continue;
+			}
+			job.image = job.decoding.get();
+			job.decoded = true;
+			if (!job.image.pixels)
+			{
+				std::cout << "Failed to load texture " << job.path << std::endl;
+				jobs.erase(jobs.begin() + i);
+				continue;
+			}
+			beginUpload(job);
+		}
+
+		if (UploadedLastFrame < BytesPerFrame)
+			UploadedLastFrame += uploadRows(job, BytesPerFrame - UploadedLastFrame);
+
+		if (job.nextRow >= job.image.height)
+		{
+			finishUpload(job);
+			jobs.erase(jobs.begin() + i);
+			continue;
+		}
+		++i;
+	}
+
+	for (size_t i = 0; i < layerJobs.size();)
+	{
+		LayerJob& job = *layerJobs[i];
+		if (!job.prepared)
+		{
+			// a deferred future, from a caller without a pool, is prepared right here
+			if (job.preparing.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+			{
+				++i;
+				continue;
+			}
+			job.image = job.preparing.get();
+			job.prepared = true;
+		}
+
+		// the small levels at the end of a chain go up together
+		while (job.level < job.image.levels.size() && UploadedLastFrame < BytesPerFrame)
+			UploadedLastFrame += uploadLayerRows(job, BytesPerFrame - UploadedLastFrame);
+
+		if (job.level >= job.image.levels.size())
+		{
+			std::unique_ptr<LayerJob> finished = std::move(layerJobs[i]);
+			layerJobs.erase(layerJobs.begin() + i);
+			if (finished->onResident)
+				finished->onResident();
+			continue;
+		}
+		++i;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+	glBindTexture(GL_TEXTURE_2D, previousTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, previousArray);
+}
+
+void TextureStreamer::beginUpload(Job& job)
+{
+	switch (job.image.channels)
+	{
+		// stored with the image's own channel count, not padded out to RGBA
+		case 1: job.format = GL_RED; job.internalFormat = GL_R8; break;
+		case 2: job.format = GL_RG; job.internalFormat = GL_RG8; break;
+		case 4: job.format = GL_RGBA; job.internalFormat = GL_RGBA8; break;
+		default: job.format = GL_RGB; job.internalFormat = GL_RGB8; break;
+	}
+
+	int size = std::max(job.image.width, job.image.height);
+	job.levels = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		job.levels++;
+	}
+
+	// Allocate the whole chain, fill only the last level with the average colour and sample
+	// nothing but that level until level 0 is complete. A bound unpack buffer would turn the
+	// null pointers below into offsets into it, so the slice from the previous job is unbound first
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, job.texture);
+	for (GLint level = 0; level < job.levels; ++level)
+	{
+		GLsizei width = std::max(1, job.image.width >> level);
+		GLsizei height = std::max(1, job.image.height >> level);
+		glTexImage2D(GL_TEXTURE_2D, level, job.internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	GLint lastLevel = job.levels - 1;
+	glTexSubImage2D(GL_TEXTURE_2D, lastLevel, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &job.image.average[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, lastLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, lastLevel);
+}
+
+GLsizeiptr TextureStreamer::uploadRows(Job& job, GLsizeiptr budget)
+{
+	GLsizeiptr rowBytes = (GLsizeiptr)job.image.width * job.image.channels;
+	int remaining = job.image.height - job.nextRow;
+	// always make progress, even when a single row is over budget
+	int rows = (int)std::min<GLsizeiptr>(remaining, std::max<GLsizeiptr>(1, budget / rowBytes));
+	GLsizeiptr bytes = rows * rowBytes;
+
+	if (stageSlice(job.image.pixels.get() + job.nextRow * rowBytes, bytes))
+	{
+		// with a buffer bound to GL_PIXEL_UNPACK_BUFFER the pointer is an offset into it
+		glBindTexture(GL_TEXTURE_2D, job.texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.nextRow, job.image.width, rows, job.format, job.pixelType, (void*)0);
+	}
+	job.nextRow += rows;
+	return bytes;
+}
+
+GLsizeiptr TextureStreamer::uploadLayerRows(LayerJob& job, GLsizeiptr budget)
+{
+	const LayerImage::Level& level = job.image.levels[job.level];
+	bool compressed = job.image.compressedFormat != 0;
+	// a compressed row is a row of 4x4 blocks, so every slice starts on a block boundary
+	int rowHeight = compressed ? 4 : 1;
+	int rowCount = (level.height + rowHeight - 1) / rowHeight;
+	GLsizeiptr rowBytes = std::max<GLsizeiptr>(1, level.size / rowCount);
+	int rows = (int)std::min<GLsizeiptr>(rowCount - job.nextRow, std::max<GLsizeiptr>(1, budget / rowBytes));
+	GLsizeiptr bytes = rows * rowBytes;
+
+	if (stageSlice(level.data + job.nextRow * rowBytes, bytes))
+	{
+		GLint y = job.nextRow * rowHeight;
+		GLsizei height = std::min(rows * rowHeight, level.height - y);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, job.texture);
+		if (compressed)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)job.level, 0, y, job.layer, level.width, height, 1,
+				job.image.compressedFormat, (GLsizei)bytes, (void*)0);
+		else
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)job.level, 0, y, job.layer, level.width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	}
+	job.nextRow += rows;
+	if (job.nextRow >= rowCount)
+	{
+		job.level++;
+		job.nextRow = 0;
+	}
+	return bytes;
+}
+
+bool TextureStreamer::stageSlice(const unsigned char* data, GLsizeiptr bytes)
+{
+	// orphan the buffer, then write the slice straight into the fresh storage
+	GLuint pbo = pbos[nextPbo];
+	nextPbo = (nextPbo + 1) % 2;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped == nullptr)
+		return false;
+	memcpy(mapped, data, bytes);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	return true;
+}
+
+void TextureStreamer::finishUpload(Job& job)
+{
+	glBindTexture(GL_TEXTURE_2D, job.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, job.levels - 1);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	if (job.onResident)
+		job.onResident(job.image.width, job.image.height, job.image.channels);
+	// the decoded pixels go with the job
+}
+
+void TextureStreamer::Delete()
+{
+	jobs.clear();
+	layerJobs.clear();
+	if (pbos[0] != 0)
+		glDeleteBuffers(2, pbos);
+	pbos[0] = pbos[1] = 0;
+}
@@ -0,0 +1,122 @@
+#ifndef TEXTURE_STREAMER_CLASS_H
+#define TEXTURE_STREAMER_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <functional>
+
+#include "ThreadPool.h"
+#include "stb_image.h"
+
+// Image decoded on a worker thread, the pixels belong to stb_image
+struct DecodedImage
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::unique_ptr<unsigned char, void(*)(void*)> pixels{ nullptr, stbi_image_free };
+	// average colour, shown as a one texel mip while the full image streams in
+	glm::u8vec4 average = glm::u8vec4(128, 128, 128, 255);
+};
+
+// Every mip level of one layer of a 2D array texture, prepared on a worker. Plain levels are RGBA8,
+// compressed ones blocks of compressedFormat. The levels point into storage
+struct LayerImage
+{
+	struct Level
+	{
+		GLsizei width;
+		GLsizei height;
+		const unsigned char* data;
+		GLsizeiptr size;
+	};
+
+	std::vector<Level> levels;
+	// 0 for RGBA8
+	GLenum compressedFormat = 0;
+	// the decoded chain or the mapped .dds the levels live in
+	std::shared_ptr<const void> storage;
+};
+
+// Decodes images on a thread pool and streams them into existing texture objects through
+// pixel buffer objects, a bounded number of bytes per frame. A texture shows its average
+// colour until every row of level 0 has arrived, then gets its mip chain in one go.
+// Layers of array textures stream the same way, every level from the prepared image, so
+// nothing else in the array is touched
+class TextureStreamer
+{
+public:
+	// Bytes handed to the driver per frame across all textures
+	GLsizeiptr BytesPerFrame;
+	// Bytes uploaded during the last Update
+	GLsizeiptr UploadedLastFrame = 0;
+
+	TextureStreamer(ThreadPool& pool, GLsizeiptr bytesPerFrame = 4 * 1024 * 1024);
+	~TextureStreamer();
+
+	// Queues path for decoding, the result ends up in texture. onResident runs on the render
+	// thread with the image size and channel count once the full mip chain is in place
+	void Load(GLuint texture, const std::string& path, GLenum pixelType,
+		std::function<void(GLsizei width, GLsizei height, int channels)> onResident = nullptr);
+	// Queues image for layer of the 2D array texture, which already has storage for every level.
+	// onResident runs on the render thread once the last level is in place
+	void LoadLayer(GLuint texture, GLint layer, std::shared_future<LayerImage> image, std::function<void()> onResident = nullptr);
+	// Drops any work still queued for texture, call before deleting it
+	void Cancel(GLuint texture);
+	// Starts uploads for finished decodes and streams rows up to the budget. Render thread only
+	void Update();
+	// Decoding or uploading
+	unsigned int Pending() const { return (unsigned int)(jobs.size() + layerJobs.size()); }
+	void Delete();
+
+	// Loads and flips path for upload, safe to call from any thread
+	static DecodedImage Decode(const std::string& path);
+
+private:
+	struct Job
+	{
+		GLuint texture;
+		std::string path;
+		GLenum pixelType;
+		std::function<void(GLsizei, GLsizei, int)> onResident;
+		std::future<DecodedImage> decoding;
+		DecodedImage image;
+		bool decoded = false;
+		int nextRow = 0;
+		GLenum format = GL_RGBA;
+		GLenum internalFormat = GL_RGBA8;
+		GLint levels = 1;
+	};
+
+	struct LayerJob
+	{
+		GLuint texture;
+		GLint layer;
+		std::function<void()> onResident;
+		std::shared_future<LayerImage> preparing;
+		LayerImage image;
+		bool prepared = false;
+		size_t level = 0;
+		// in block rows for compressed levels
+		int nextRow = 0;
+	};
+
+	ThreadPool& pool;
+	std::vector<std::unique_ptr<Job>> jobs;
+	std::vector<std::unique_ptr<LayerJob>> layerJobs;
+	// uploads alternate between two buffers so a slice never waits on the one before it
+	GLuint pbos[2] = { 0, 0 };
+	int nextPbo = 0;
+
+	void beginUpload(Job& job);
+	GLsizeiptr uploadRows(Job& job, GLsizeiptr budget);
+	void finishUpload(Job& job);
+	GLsizeiptr uploadLayerRows(LayerJob& job, GLsizeiptr budget);
+	// Copies bytes into the next pixel buffer and leaves it bound, false when it can't be mapped
+	bool stageSlice(const unsigned char* data, GLsizeiptr bytes);
+};
+#endif
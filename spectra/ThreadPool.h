@@ -0,0 +1,54 @@
+#ifndef THREAD_POOL_CLASS_H
+#define THREAD_POOL_CLASS_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// Fixed set of worker threads pulling tasks from one queue. Submit returns a future for the
+// task's result, tasks must not touch GL since the context lives on the render thread only.
+class ThreadPool
+{
+public:
+	// 0 picks one thread per hardware core, minus the render thread
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template <typename F>
+	auto Submit(F task) -> std::future<decltype(task())>;
+
+	unsigned int Size() const { return (unsigned int)workers.size(); }
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	void workerLoop();
+};
+
+template <typename F>
+auto ThreadPool::Submit(F task) -> std::future<decltype(task())>
+{
+	typedef decltype(task()) Result;
+	// std::function needs a copyable target, the packaged task is shared instead
+	std::shared_ptr<std::packaged_task<Result()>> packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+	std::future<Result> result = packaged->get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back([packaged]() { (*packaged)(); });
+	}
+	wake.notify_one();
+	return result;
+}
+#endif
@@ -0,0 +1,45 @@
+#include "UBO.h"
+
+UBO::UBO(GLsizeiptr size, GLuint binding)
+{
+	Size = size;
+	Binding = binding;
+
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	//Binding points are global state, every program reading this block sees the buffer
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+}
+
+void UBO::Update(const void* data, GLsizeiptr size, GLintptr offset)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	if (offset == 0 && size == Size)
+	{
+		//Whole buffer rewrite, orphan the old storage so we never wait on draws still reading it
+		glBufferData(GL_UNIFORM_BUFFER, Size, data, GL_DYNAMIC_DRAW);
+	}
+	else
+	{
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UBO::Bind()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+}
+
+void UBO::Unbind()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UBO::Delete()
+{
+	glDeleteBuffers(1, &ID);
+}
@@ -0,0 +1,21 @@
+#ifndef UBO_CLASS_H
+#define UBO_CLASS_H
+
+#include <glad/glad.h>
+
+class UBO
+{
+public:
+	GLuint ID;
+	GLsizeiptr Size;
+	GLuint Binding;
+
+	// Allocates the buffer and attaches it to a uniform block binding point
+	UBO(GLsizeiptr size, GLuint binding);
+
+	void Update(const void* data, GLsizeiptr size, GLintptr offset = 0);
+	void Bind();
+	void Unbind();
+	void Delete();
+};
+#endif
@@ -0,0 +1,91 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Binding points shared by every program. After linking, Shader binds any block
+// named in uniformBlockBindings to its fixed point, so one buffer feeds all programs.
+enum UniformBlockBinding : GLuint
+{
+	FRAME_BLOCK_BINDING = 0,
+	LIGHT_BLOCK_BINDING = 1
+};
+
+struct UniformBlockName
+{
+	const char* name;
+	GLuint binding;
+};
+
+const UniformBlockName uniformBlockBindings[] =
+{
+	{ "FrameData", FRAME_BLOCK_BINDING },
+	{ "LightData", LIGHT_BLOCK_BINDING }
+};
+
+// Capacity of the directional shadow cascade arrays, see CascadedShadowMap
+const unsigned int LIGHT_BLOCK_MAX_CASCADES = 4;
+
+// The structs below mirror the std140 blocks declared in the shaders, vec3 members
+// are followed by a scalar or padding so every field lands on its std140 offset.
+
+// layout (std140) uniform FrameData
+struct FrameBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPos;
+	float farPlane;
+};
+
+struct DirectionLightData
+{
+	glm::vec3 direction;
+	float pad0;
+	glm::vec3 ambient;
+	float pad1;
+	glm::vec3 diffuse;
+	float pad2;
+	glm::vec3 specular;
+	float pad3;
+};
+
+struct SpotLightData
+{
+	glm::vec3 position;
+	float cutOff;
+	glm::vec3 direction;
+	float outerCutOff;
+	glm::vec3 ambient;
+	float constant;
+	glm::vec3 diffuse;
+	float linear;
+	glm::vec3 specular;
+	float quadratic;
+};
+
+// layout (std140) uniform LightData
+struct LightBlock
+{
+	DirectionLightData dirLight;
+	SpotLightData spotLight;
+	// directional shadow cascades in use, 0 without directional shadows
+	GLint numCascades;
+	GLint pad0[3];
+	// per cascade: world to shadow map clip space, where it ends as view depth, world size of a texel
+	glm::mat4 cascadeMatrices[LIGHT_BLOCK_MAX_CASCADES];
+	glm::vec4 cascadeSplits;
+	glm::vec4 cascadeTexelSizes;
+	// froxel grid of the point light lists, tiles across, tiles down and depth slices, then
+	// 1 / tile width and height in pixels and the scale and bias of log(view depth) to a slice
+	glm::ivec4 clusterSize;
+	glm::vec4 clusterScale;
+};
+
+static_assert(sizeof(FrameBlock) == 144, "FrameBlock does not match the std140 FrameData layout");
+static_assert(sizeof(DirectionLightData) == 64, "DirectionLightData does not match std140");
+static_assert(sizeof(SpotLightData) == 80, "SpotLightData does not match std140");
+static_assert(sizeof(LightBlock) == 480, "LightBlock does not match the std140 LightData layout");
+
+#endif
@@ -5,6 +5,27 @@ VAO::VAO()
 	glGenVertexArrays(1, &ID);
 }
 
+VAO::~VAO()
+{
+	Delete();
+}
+
+VAO::VAO(VAO&& other) noexcept : ID(other.ID)
+{
+	other.ID = 0;
+}
+
+VAO& VAO::operator=(VAO&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
+}
+
 void VAO::LinkAttrib(VBO& VBO, GLuint layout, GLuint size, GLenum type, GLsizeiptr stride, void* offset)
 {
 	VBO.Bind();
@@ -13,6 +34,31 @@ void VAO::LinkAttrib(VBO& VBO, GLuint layout, GLuint size, GLenum type, GLsizeip
 	VBO.Unbind();
 }
 
+void VAO::LinkStream(VBO& VBO, const VertexStream& stream)
+{
+	VBO.Bind();
+	for (const VertexAttribute& attribute : stream.attributes)
+	{
+		glVertexAttribPointer(attribute.location, VertexLayout::Components(attribute.format), VertexLayout::Type(attribute.format),
+			VertexLayout::Normalized(attribute.format), stream.stride, (void*)(size_t)attribute.offset);
+		glEnableVertexAttribArray(attribute.location);
+	}
+	VBO.Unbind();
+}
+
+void VAO::LinkInstanceMat4(VBO& VBO, GLuint layout, GLintptr offset)
+{
+	VBO.Bind();
+	for (GLuint column = 0; column < 4; ++column)
+	{
+		glVertexAttribPointer(layout + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(layout + column);
+		//Advance once per instance instead of once per vertex
+		glVertexAttribDivisor(layout + column, 1);
+	}
+	VBO.Unbind();
+}
+
 void VAO::Bind()
 {
 	glBindVertexArray(ID);
@@ -25,5 +71,7 @@ void VAO::Unbind()
 
 void VAO::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	if (ID != 0)
+		glDeleteVertexArrays(1, &ID);
+	ID = 0;
 }
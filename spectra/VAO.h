@@ -3,15 +3,28 @@
 
 #include<glad/glad.h>
 #include "VBO.h"
+#include "VertexLayout.h"
 
 class VAO
 {
 public:
 
-	GLuint ID;
+	GLuint ID = 0;
 	VAO();
+	~VAO();
+
+	// Owns the vertex array, moves hand it over and copies are not allowed
+	VAO(const VAO&) = delete;
+	VAO& operator=(const VAO&) = delete;
+	VAO(VAO&& other) noexcept;
+	VAO& operator=(VAO&& other) noexcept;
 
 	void LinkAttrib(VBO& VBO, GLuint layout, GLuint size, GLenum type, GLsizeiptr stride, void* offset);
+	// Links every attribute of one stream of a vertex layout to the buffer holding it
+	void LinkStream(VBO& VBO, const VertexStream& stream);
+	// Links a tightly packed per-instance mat4, one vec4 column per location from layout to layout + 3.
+	// Instance 0 reads the matrix at offset bytes into the buffer
+	void LinkInstanceMat4(VBO& VBO, GLuint layout, GLintptr offset = 0);
 	void Bind();
 	void Unbind();
 	void Delete();
@@ -6,7 +6,70 @@ VBO::VBO(std::vector<Vertex>& vertices)
 	//Bind newly generated buffer
 	glBindBuffer(GL_ARRAY_BUFFER, ID);
 	//Copies previously defined vertices into buffer's memory
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	Size = vertices.size() * sizeof(Vertex);
+	glBufferData(GL_ARRAY_BUFFER, Size, vertices.data(), GL_STATIC_DRAW);
+}
+
+VBO::VBO(const std::vector<unsigned char>& data)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	Size = data.size();
+	glBufferData(GL_ARRAY_BUFFER, Size, data.data(), GL_STATIC_DRAW);
+}
+
+VBO::VBO(const void* data, GLsizeiptr size)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	Size = size;
+	glBufferData(GL_ARRAY_BUFFER, Size, data, GL_STATIC_DRAW);
+}
+
+VBO::VBO(GLsizeiptr size)
+{
+	Size = size;
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glBufferData(GL_ARRAY_BUFFER, Size, nullptr, GL_DYNAMIC_DRAW);
+}
+
+VBO::~VBO()
+{
+	Delete();
+}
+
+VBO::VBO(VBO&& other) noexcept : ID(other.ID), Size(other.Size)
+{
+	other.ID = 0;
+	other.Size = 0;
+}
+
+VBO& VBO::operator=(VBO&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		Size = other.Size;
+		other.ID = 0;
+		other.Size = 0;
+	}
+	return *this;
+}
+
+void VBO::Update(const void* data, GLsizeiptr size)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	if (size > Size)
+	{
+		Size = size;
+		glBufferData(GL_ARRAY_BUFFER, Size, data, GL_DYNAMIC_DRAW);
+		return;
+	}
+	//Orphan the old storage so the driver doesn't stall on draws still reading it
+	glBufferData(GL_ARRAY_BUFFER, Size, nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
 }
 
 void VBO::Bind()
@@ -23,5 +86,8 @@ void VBO::Unbind()
 
 void VBO::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	if (ID != 0)
+		glDeleteBuffers(1, &ID);
+	ID = 0;
+	Size = 0;
 }
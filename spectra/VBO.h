@@ -16,9 +16,27 @@ struct Vertex
 class VBO 
 {
 public: 
-	GLuint ID;
+	GLuint ID = 0;
+	GLsizeiptr Size = 0;
+	// Empty handle that owns nothing until a buffer is moved into it
+	VBO() = default;
 	VBO(std::vector<Vertex>& vertices);
+	// Static buffer holding already encoded vertex data, see VertexLayout::Pack
+	VBO(const std::vector<unsigned char>& data);
+	// Static buffer uploaded from memory the caller keeps, such as a mapped file
+	VBO(const void* data, GLsizeiptr size);
+	// Empty buffer for data rewritten at runtime, such as per-instance attributes
+	VBO(GLsizeiptr size);
+	~VBO();
 
+	// Owns the buffer, moves hand it over and copies are not allowed
+	VBO(const VBO&) = delete;
+	VBO& operator=(const VBO&) = delete;
+	VBO(VBO&& other) noexcept;
+	VBO& operator=(VBO&& other) noexcept;
+
+	// Replaces the contents, the buffer grows when the new data doesn't fit
+	void Update(const void* data, GLsizeiptr size);
 	void Bind();
 	void Unbind();
 	void Delete();
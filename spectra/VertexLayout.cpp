@@ -0,0 +1,161 @@
+#include "VertexLayout.h"
+
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+VertexLayout::VertexLayout(VertexFormat normal, VertexFormat color, VertexFormat texUV, bool separatePosition)
+	: normalFormat(normal), colorFormat(color), texUVFormat(texUV), separatePosition(separatePosition)
+{
+	VertexAttribute attributes[] =
+	{
+		{ POSITION_LOCATION, VertexFormat::Float3, 0 },
+		{ NORMAL_LOCATION, normal, 0 },
+		{ COLOR_LOCATION, color, 0 },
+		{ TEXUV_LOCATION, texUV, 0 }
+	};
+
+	streams.push_back(VertexStream());
+	for (VertexAttribute& attribute : attributes)
+	{
+		if (attribute.format == VertexFormat::Omitted)
+			continue;
+		//Everything after the position goes to a second stream when positions are kept apart
+		if (separatePosition && attribute.location != POSITION_LOCATION && streams.size() == 1)
+			streams.push_back(VertexStream());
+
+		VertexStream& stream = streams.back();
+		attribute.offset = stream.stride;
+		stream.stride += Size(attribute.format);
+		stream.attributes.push_back(attribute);
+	}
+}
+
+VertexLayout VertexLayout::Full()
+{
+	return VertexLayout(VertexFormat::Float3, VertexFormat::Float3, VertexFormat::Float2, false);
+}
+
+VertexLayout VertexLayout::Compact()
+{
+	return VertexLayout(VertexFormat::Snorm10_10_10_2, VertexFormat::Unorm8x4, VertexFormat::Half2, true);
+}
+
+VertexLayout VertexLayout::PositionOnly()
+{
+	return VertexLayout(VertexFormat::Omitted, VertexFormat::Omitted, VertexFormat::Omitted, false);
+}
+
+GLsizei VertexLayout::VertexSize() const
+{
+	GLsizei size = 0;
+	for (const VertexStream& stream : streams)
+		size += stream.stride;
+	return size;
+}
+
+// writes one attribute of a vertex in its packed form
+static void packAttribute(const Vertex& vertex, const VertexAttribute& attribute, unsigned char* out)
+{
+	glm::vec3 value3(0.0f);
+	glm::vec2 value2(0.0f);
+	switch (attribute.location)
+	{
+		case POSITION_LOCATION: value3 = vertex.position; break;
+		case NORMAL_LOCATION: value3 = vertex.normal; break;
+		case COLOR_LOCATION: value3 = vertex.color; break;
+		case TEXUV_LOCATION: value2 = vertex.texUV; break;
+	}
+
+	switch (attribute.format)
+	{
+		case VertexFormat::Float3:
+			memcpy(out, &value3[0], sizeof(glm::vec3));
+			break;
+		case VertexFormat::Float2:
+			memcpy(out, &value2[0], sizeof(glm::vec2));
+			break;
+		case VertexFormat::Half2:
+		{
+			glm::uint32 packed = glm::packHalf2x16(value2);
+			memcpy(out, &packed, sizeof(packed));
+			break;
+		}
+		case VertexFormat::Snorm10_10_10_2:
+		{
+			//Only normals use this, 10 bits hold a unit vector comfortably but not an unnormalized one
+			float length = glm::length(value3);
+			glm::vec3 unit = length > 0.0f ? value3 / length : glm::vec3(0.0f);
+			glm::uint32 packed = glm::packSnorm3x10_1x2(glm::vec4(unit, 0.0f));
+			memcpy(out, &packed, sizeof(packed));
+			break;
+		}
+		case VertexFormat::Unorm8x4:
+		{
+			glm::uint32 packed = glm::packUnorm4x8(glm::vec4(value3, 1.0f));
+			memcpy(out, &packed, sizeof(packed));
+			break;
+		}
+		case VertexFormat::Omitted:
+			break;
+	}
+}
+
+std::vector<std::vector<unsigned char>> VertexLayout::Pack(const std::vector<Vertex>& vertices) const
+{
+	std::vector<std::vector<unsigned char>> data(streams.size());
+	for (size_t s = 0; s < streams.size(); ++s)
+	{
+		const VertexStream& stream = streams[s];
+		data[s].resize(vertices.size() * stream.stride);
+		for (size_t v = 0; v < vertices.size(); ++v)
+		{
+			unsigned char* out = data[s].data() + v * stream.stride;
+			for (const VertexAttribute& attribute : stream.attributes)
+				packAttribute(vertices[v], attribute, out + attribute.offset);
+		}
+	}
+	return data;
+}
+
+GLuint VertexLayout::Size(VertexFormat format)
+{
+	switch (format)
+	{
+		case VertexFormat::Float3: return 12;
+		case VertexFormat::Float2: return 8;
+		case VertexFormat::Half2: return 4;
+		case VertexFormat::Snorm10_10_10_2: return 4;
+		case VertexFormat::Unorm8x4: return 4;
+		default: return 0;
+	}
+}
+
+GLint VertexLayout::Components(VertexFormat format)
+{
+	switch (format)
+	{
+		case VertexFormat::Float3: return 3;
+		case VertexFormat::Float2: return 2;
+		case VertexFormat::Half2: return 2;
+		//Packed formats are always fetched as four components, the shaders just ignore w
+		case VertexFormat::Snorm10_10_10_2: return 4;
+		case VertexFormat::Unorm8x4: return 4;
+		default: return 0;
+	}
+}
+
+GLenum VertexLayout::Type(VertexFormat format)
+{
+	switch (format)
+	{
+		case VertexFormat::Half2: return GL_HALF_FLOAT;
+		case VertexFormat::Snorm10_10_10_2: return GL_INT_2_10_10_10_REV;
+		case VertexFormat::Unorm8x4: return GL_UNSIGNED_BYTE;
+		default: return GL_FLOAT;
+	}
+}
+
+GLboolean VertexLayout::Normalized(VertexFormat format)
+{
+	return format == VertexFormat::Snorm10_10_10_2 || format == VertexFormat::Unorm8x4 ? GL_TRUE : GL_FALSE;
+}
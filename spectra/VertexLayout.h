@@ -0,0 +1,76 @@
+#ifndef VERTEX_LAYOUT_CLASS_H
+#define VERTEX_LAYOUT_CLASS_H
+
+#include <glad/glad.h>
+#include <vector>
+
+#include "VBO.h"
+
+// Attribute locations shared with the layout(location = n) declarations in the shaders
+enum VertexLocation
+{
+	POSITION_LOCATION = 0,
+	NORMAL_LOCATION = 1,
+	COLOR_LOCATION = 2,
+	TEXUV_LOCATION = 3
+};
+
+// How one attribute is stored in the vertex buffer
+enum class VertexFormat
+{
+	Float3,				// 12 bytes, full precision
+	Float2,				// 8 bytes, full precision
+	Half2,				// 4 bytes, 16 bit floats
+	Snorm10_10_10_2,	// 4 bytes, normalized xyz with 10 bits each, decoded by the vertex fetch
+	Unorm8x4,			// 4 bytes, RGBA8 with alpha set to 1
+	Omitted				// not stored at all, the shader sees the attribute's default value
+};
+
+// One attribute inside a stream
+struct VertexAttribute
+{
+	GLuint location;
+	VertexFormat format;
+	GLuint offset;
+};
+
+// Interleaved attributes that live in one vertex buffer
+struct VertexStream
+{
+	GLsizei stride = 0;
+	std::vector<VertexAttribute> attributes;
+};
+
+// Describes how a Vertex is encoded on the GPU. Position is always three floats, every
+// other attribute picks its own format or is left out. With separatePosition the positions
+// get a stream of their own, so depth only passes fetch 12 bytes per vertex and nothing else.
+class VertexLayout
+{
+public:
+	std::vector<VertexStream> streams;
+	// What the layout was built from, enough to rebuild it, e.g. from a mesh file header
+	VertexFormat normalFormat;
+	VertexFormat colorFormat;
+	VertexFormat texUVFormat;
+	bool separatePosition;
+
+	VertexLayout(VertexFormat normal, VertexFormat color, VertexFormat texUV, bool separatePosition);
+
+	// The original all float vertex, 44 bytes in one stream
+	static VertexLayout Full();
+	// Positions in their own 12 byte stream, then 10-10-10-2 normal, RGBA8 color and half UV in 12 more
+	static VertexLayout Compact();
+	// Positions only, for meshes whose shaders read nothing else
+	static VertexLayout PositionOnly();
+
+	// Bytes per vertex over all streams
+	GLsizei VertexSize() const;
+	// Encodes the vertices into one tightly packed buffer per stream
+	std::vector<std::vector<unsigned char>> Pack(const std::vector<Vertex>& vertices) const;
+
+	static GLuint Size(VertexFormat format);
+	static GLint Components(VertexFormat format);
+	static GLenum Type(VertexFormat format);
+	static GLboolean Normalized(VertexFormat format);
+};
+#endif
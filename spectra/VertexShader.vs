@@ -3,26 +3,62 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec3 aColor;
 layout (location = 3) in vec2 aTexCoord;
+#ifdef INSTANCED
+//Per-instance model matrix, one vec4 column per location 4 to 7
+layout (location = 4) in mat4 aInstanceModel;
+#endif
+#ifdef MATERIAL_ARRAY
+//Texture array layer of the material. Either a per-instance buffer or, with the attribute array
+//disabled, the constant value MaterialLibrary::Bind sets for the whole draw
+layout (location = 8) in int aMaterialLayer;
+#endif
 
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec3 ourColor;
 out vec2 TexCoord;
-//out vec4 FragPosLightSpace;
+#ifdef MATERIAL_ARRAY
+flat out int MaterialLayer;
+#endif
+//The depth pre-pass draws with this same source, the lit pass depth tests GL_EQUAL against it
+invariant gl_Position;
 
+#ifndef INSTANCED
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-//uniform mat4 lightSpaceMatrix;
+#endif
 
+//Shared per-frame camera data, see UniformBlocks.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float far_plane;
+};
+
+#ifdef DEFERRED
+//The deferred lighting pass, one triangle over the whole screen made up from the vertex index,
+//FragmentShader.fs reads everything else from the G-buffer
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+#else
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+#endif
     FragPos  = vec3(model * vec4(aPos, 1.0));
     Normal   = aNormal;
     ourColor = aColor;
     TexCoord = aTexCoord;
-    //FragPosLightSpace = lightSpaceMatrix * vec4(FragPos, 1.0);
+#ifdef MATERIAL_ARRAY
+    MaterialLayer = aMaterialLayer;
+#endif
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "VirtualFileSystem.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+std::vector<VirtualFileSystem::MountEntry> VirtualFileSystem::mounts;
+std::atomic<unsigned int> VirtualFileSystem::ArchiveReads(0);
+std::atomic<unsigned int> VirtualFileSystem::LooseReads(0);
+
+bool VirtualFileSystem::Mount(const std::string& mountPoint, const std::string& source)
+{
+	MountEntry mount;
+	mount.point = ResourceArchive::NormalizeName(mountPoint);
+
+	std::error_code error;
+	if (fs::is_directory(source, error))
+		mount.directory = source;
+	else
+	{
+		std::shared_ptr<ResourceArchive> archive = std::make_shared<ResourceArchive>();
+		if (!archive->Open(source))
+		{
+			std::cout << "ERROR::VFS::CANNOT_MOUNT " << source << std::endl;
+			return false;
+		}
+		mount.directory = fs::path(source).parent_path().string();
+		mount.archive = std::move(archive);
+	}
+	mounts.push_back(std::move(mount));
+	return true;
+}
+
+void VirtualFileSystem::UnmountAll()
+{
+	// resources still held keep their archive mapped through their own reference
+	mounts.clear();
+}
+
+bool VirtualFileSystem::relativeTo(const MountEntry& mount, const std::string& path, std::string& relative)
+{
+	std::string normalized = path;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+	normalized = fs::path(normalized).lexically_normal().generic_string();
+	std::string key = ResourceArchive::NormalizeName(normalized);
+
+	if (mount.point.empty())
+	{
+		relative = normalized;
+		return true;
+	}
+	if (key.compare(0, mount.point.size(), mount.point) != 0 || (key.size() > mount.point.size() && key[mount.point.size()] != '/'))
+		return false;
+	relative = normalized.size() > mount.point.size() ? normalized.substr(mount.point.size() + 1) : std::string();
+	return true;
+}
+
+ResourceFile VirtualFileSystem::openLoose(const std::string& path)
+{
+	std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+	if (!mapping->Open(path))
+		return ResourceFile();
+	LooseReads++;
+	const uint8_t* data = mapping->Data();
+	size_t size = mapping->Size();
+	return ResourceFile(std::move(mapping), data, size);
+}
+
+ResourceFile VirtualFileSystem::Open(const std::string& path)
+{
+	bool mounted = false;
+	std::string relative;
+	for (auto mount = mounts.rbegin(); mount != mounts.rend(); ++mount)
+	{
+		if (!relativeTo(*mount, path, relative))
+			continue;
+		mounted = true;
+		if (mount->archive)
+		{
+			const ResourceArchiveEntry* entry = mount->archive->Find(ResourceArchive::NormalizeName(relative));
+			if (entry != nullptr)
+			{
+				ArchiveReads++;
+				return ResourceFile(mount->archive->Mapping(), mount->archive->Data(*entry), (size_t)entry->size);
+			}
+		}
+		else
+		{
+			ResourceFile file = openLoose((fs::path(mount->directory) / relative).string());
+			if (file.Valid())
+				return file;
+		}
+	}
+	return mounted ? ResourceFile() : openLoose(path);
+}
+
+int64_t VirtualFileSystem::ModifiedTime(const std::string& path)
+{
+	bool mounted = false;
+	std::string relative;
+	std::error_code error;
+	for (auto mount = mounts.rbegin(); mount != mounts.rend(); ++mount)
+	{
+		if (!relativeTo(*mount, path, relative))
+			continue;
+		mounted = true;
+		if (mount->archive)
+		{
+			const ResourceArchiveEntry* entry = mount->archive->Find(ResourceArchive::NormalizeName(relative));
+			if (entry != nullptr)
+				return entry->modifiedTime;
+		}
+		else
+		{
+			fs::file_time_type time = fs::last_write_time(fs::path(mount->directory) / relative, error);
+			if (!error)
+				return (int64_t)time.time_since_epoch().count();
+		}
+	}
+	if (mounted)
+		return 0;
+	fs::file_time_type time = fs::last_write_time(path, error);
+	return error ? 0 : (int64_t)time.time_since_epoch().count();
+}
+
+bool VirtualFileSystem::Exists(const std::string& path)
+{
+	return ModifiedTime(path) != 0;
+}
+
+std::string VirtualFileSystem::DiskPath(const std::string& path)
+{
+	std::string relative;
+	for (auto mount = mounts.rbegin(); mount != mounts.rend(); ++mount)
+	{
+		if (relativeTo(*mount, path, relative))
+			return (fs::path(mount->directory) / relative).string();
+	}
+	return path;
+}
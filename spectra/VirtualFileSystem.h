@@ -0,0 +1,75 @@
+#ifndef VIRTUAL_FILE_SYSTEM_CLASS_H
+#define VIRTUAL_FILE_SYSTEM_CLASS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "MappedFile.h"
+#include "ResourceArchive.h"
+
+// The bytes of one resource, valid as long as any copy of the handle exists. They point into
+// the mounted archive's mapping or into a mapping of the loose file, nothing is copied
+class ResourceFile
+{
+public:
+	ResourceFile() = default;
+	ResourceFile(std::shared_ptr<const MappedFile> mapping, const uint8_t* data, size_t size)
+		: mapping(std::move(mapping)), data(data), size(size) {}
+
+	const uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+	bool Valid() const { return data != nullptr; }
+	// A copy as text, for sources that get edited before use like shaders
+	std::string Text() const { return data != nullptr ? std::string((const char*)data, size) : std::string(); }
+
+private:
+	std::shared_ptr<const MappedFile> mapping;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+// Every resource load goes through here. A mount serves the paths under a mount point from a
+// directory or from a resource archive, so the same path works on a checkout and on a packed
+// build, and with an archive startup maps one file instead of opening every asset on its own.
+// Paths outside every mount are read from disk as they are.
+// Mount before loading starts; the lookups are safe from any thread
+class VirtualFileSystem
+{
+public:
+	// Serves paths under mountPoint from source, a directory or an archive. Later mounts are
+	// searched first, so an archive mounted over a directory overrides the files it holds
+	static bool Mount(const std::string& mountPoint, const std::string& source);
+	static void UnmountAll();
+
+	// The resource at path, invalid when no mount has it
+	static ResourceFile Open(const std::string& path);
+	static bool Exists(const std::string& path);
+	// Last write time in std::filesystem::file_time_type ticks, 0 when path doesn't exist
+	static int64_t ModifiedTime(const std::string& path);
+	// Where path is on disk, for writing caches next to resources and for libraries that open
+	// files themselves. Under an archive mount that is relative to the archive's directory
+	static std::string DiskPath(const std::string& path);
+
+	// Resources served from archives and loose files mapped one by one
+	static std::atomic<unsigned int> ArchiveReads;
+	static std::atomic<unsigned int> LooseReads;
+
+private:
+	struct MountEntry
+	{
+		// normalized like archive names, see ResourceArchive::NormalizeName
+		std::string point;
+		// the directory, or the one the archive is in
+		std::string directory;
+		std::shared_ptr<ResourceArchive> archive;
+	};
+	static std::vector<MountEntry> mounts;
+
+	// The part of path below mount's point, false when path isn't under it. relative keeps its case
+	static bool relativeTo(const MountEntry& mount, const std::string& path, std::string& relative);
+	static ResourceFile openLoose(const std::string& path);
+};
+#endif
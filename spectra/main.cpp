@@ -3,12 +3,31 @@
 #include "imgui/imgui_impl_opengl3.h"
 
 #include "Mesh.h"
+#include "UBO.h"
+#include "ShaderCache.h"
+#include "ShaderPermutations.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include "TextureManager.h"
+#include "MaterialLibrary.h"
+#include "Model.h"
+#include "PointShadowAtlas.h"
+#include "PassQuery.h"
+#include "CascadedShadowMap.h"
+#include "LightClusters.h"
+#include "GBuffer.h"
+#include "RenderQueue.h"
+#include "VirtualFileSystem.h"
 #include <GLFW/glfw3.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cfloat>
 #include <filesystem>
 #include <iostream>
 #include <deque>
+#include <iterator>
 namespace fs = std::filesystem;
 
 void InitWindow(); // Initial GLFW
@@ -18,20 +37,35 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 void mouse_callback(GLFWwindow* window, double xpos, double ypos); //callback function for mouse inputs. Mouse X and Y 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset); // Callback function for mouse scroll
 void ProcessInput(GLFWwindow* window);
-void SetupLights(Shader& shader, Camera& camera); //Light parameters are set here
+void SetupLights(LightBlock& lights, std::vector<PointLightData>& pointLightData, Camera& camera); //Light parameters are set here
 void InitImGui(GLFWwindow* window);
 void ImGuiNewFrame();
 void DrawImGuiWindow();
 void DestroyImGuiWindow();
-void RenderScene(Shader& shader,Mesh plank, Mesh cube);
-void RenderLightObj(Shader& lightShader, Mesh lightCube);
-
-std::string rootDir = "D:\\Repositories\\spectra\\spectra";
+void RenderScene(Shader& shader, Shader& instancedShader, Mesh& plank, Mesh& cube, bool drawPlank, VBO& cubeInstanceVBO, GLsizei cubeCount);
+void RenderLightObj(Shader& lightShader, Mesh& lightCube, const Frustum* frustum = nullptr);
+void GatherShadowCasters(Mesh& plank, Mesh& lightCube, BoundingBox& modelBounds);
+struct ShadowDraw;
+void CullShadowCubes(const CubeFrustum& faces, VBO& faceInstanceVBO, ShadowDraw& draw);
+void RenderShadowCasters(const ShadowDraw& draw, Mesh& plank, Mesh& cube, Mesh& lightCube, Model* model, bool dynamicLayer);
+void RenderCascadeCasters(Shader& shader, Shader& instancedShader, Mesh& plank, Mesh& cube, VBO& cubeInstanceVBO, Model* model,
+	const Frustum& frustum, CullStats& stats);
+unsigned int SubmitScene(RenderQueue& queue, RenderPass pass, Shader& shader, Shader& instancedShader, Mesh& plank, Mesh& cube, bool drawPlank,
+	VBO& cubeInstanceVBO, GLsizei cubeCount, Model* model, const Frustum& frustum, bool material);
+void SubmitLightObj(RenderQueue& queue, Shader& lightShader, Mesh& lightCube, const Frustum& frustum);
+
+//Every resource path starts with the mount point rootDir, main decides what is mounted there
+std::string rootDir = "spectra";
+std::string archivePath = "spectra.pak";
 std::string textureDirectory = rootDir + "\\Resources\\Textures";
+std::string modelDirectory = rootDir + "\\Resources\\Models";
 
 //Screen dimensions
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_LENGTH = 720;
+//Size of the default framebuffer in pixels, follows the window and is what the camera passes render at
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_LENGTH;
 
 //Camera object with initial pos
 Camera camera(glm::vec3(0.0f, 2.0f, 0.0f));
@@ -172,10 +206,29 @@ GLuint lightIndices[] =
 };
 
 // Constants
-const int MAX_CUBES = 12;
-const int MAX_POINTLIGHTS = 1;
+const int MAX_CUBES = 131072;
+const int MAX_POINTLIGHTS = MAX_CLUSTERED_LIGHTS;
 
 std::deque<glm::vec3> cubePositions;
+//Cube model matrices are rebuilt and uploaded to the instance buffer only after cubePositions changes
+std::vector<glm::mat4> cubeInstances;
+bool cubeInstancesDirty = true;
+//Bumped whenever cubeInstances is rebuilt, so the shadow maps notice the cubes changed
+uint64_t cubeInstancesVersion = 0;
+//World space cube bounds for culling, rebuilt together with cubeInstances, and the box around all of them
+BoundsSoA cubeBounds;
+glm::vec3 cubeSetCenter = glm::vec3(0.0f);
+glm::vec3 cubeSetExtent = glm::vec3(-1.0f);
+std::vector<uint32_t> visibleCubes;
+std::vector<glm::mat4> visibleCubeInstances;
+//Squared distance of each cube to the camera, filled for the visible ones when they are sorted
+std::vector<float> cubeDistances;
+//Objects submitted and culled in the camera pass this frame
+CullStats cullStats;
+//Texture array materials of the scene meshes, for the stats window
+MaterialLibrary* sceneMaterials = nullptr;
+//Imported model, null when none was found
+Model* sceneModel = nullptr;
 glm::vec3 ambientDir = glm::vec3(1.0f, -1.0f, 1.0f);
 glm::vec3 lightPos = glm::vec3(1.0f, 2.0f, -0.5f);
 
@@ -191,6 +244,111 @@ public:
 
 std::deque<PointLight> pointLights;
 const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
+const float POINT_SHADOW_NEAR = 1.0f, POINT_SHADOW_FAR = 25.0f;
+
+//Point shadow maps are redrawn only when their light or a caster in range changes. With split layers the cubes,
+//the objects that get added and scattered at runtime, are drawn each time over a cached map of everything else
+bool pointShadowCaching = true;
+bool pointShadowSplit = false;
+//Shadowed point lights get cubes of these sizes, the most important ones on screen the largest. 64 slots in 90 MB
+const std::vector<PointShadowTier> POINT_SHADOW_TIERS = { { 1024, 2 }, { 512, 8 }, { 256, 54 } };
+//How much redrawing the shadow maps may do per frame, in 1024 cubes. Maps over it keep their old depth a few frames
+float pointShadowBudget = 2.0f;
+//One per point light, same index. Slots come from pointShadowAtlas, which is null without cube map array support
+std::vector<PointShadowMap> pointShadowMaps;
+PointShadowAtlas* pointShadowAtlas = nullptr;
+//How the depth reaches the six faces of a cube: a geometry shader copying every triangle to all of them, the vertex
+//shader picking the layer (ARB_shader_viewport_layer_array), or six passes with one face attached at a time.
+//The last two cull the casters against each face's frustum first and send them only where they land
+enum PointShadowPath { POINT_SHADOW_GEOMETRY_SHADER, POINT_SHADOW_VERTEX_LAYER, POINT_SHADOW_SIX_PASSES };
+int pointShadowPath = POINT_SHADOW_SIX_PASSES;
+//What one light's shadow cube is drawn with, see RenderShadowCasters
+struct ShadowDraw
+{
+	PointShadowPath path;
+	Shader* shader;
+	Shader* instancedShader;
+	const PointShadowMap* map;
+	bool split;
+	VBO* cubeInstances;
+	//Per face cubes, the run of cubeInstances each face draws. Unused by the geometry shader path, which draws every cube
+	GLintptr cubeOffsets[6];
+	GLsizei cubeCounts[6];
+	//The faces of the light, null on the geometry shader path
+	const CubeFrustum* faces;
+};
+//A mesh of the shadow pass, and the faces of the light it lands on
+struct ShadowFaceCaster
+{
+	Mesh* mesh;
+	glm::mat4 transform;
+	unsigned int faceMask;
+};
+std::vector<ShadowFaceCaster> shadowFaceCasters;
+std::vector<uint32_t> shadowFaceCubes[6];
+std::vector<glm::mat4> shadowFaceCubeInstances;
+//GPU time and primitives of the point shadow pass, to compare the paths with caching off
+PassQuery* pointShadowQuery = nullptr;
+//The directional light's shadow, cascades splitting the first shadowCascadeDistance of the view. A lambda of 1 splits
+//logarithmically, every cascade as many times longer than the last, 0 splits evenly
+bool cascadedShadows = true;
+int shadowCascadeCount = 3;
+float shadowCascadeDistance = 60.0f;
+float shadowCascadeLambda = 0.8f;
+const GLsizei SHADOW_CASCADE_SIZE = 2048;
+//What each cascade drew and culled this frame
+CullStats cascadeCullStats[MAX_SHADOW_CASCADES];
+//Point light lists per froxel, for the stats window
+LightClusters* lightClusters = nullptr;
+//Forward shades every fragment as it is drawn, deferred writes the surfaces into the G-buffer first and lights
+//each pixel once in a full screen pass. Both walk the same froxel light lists
+enum RendererMode { RENDERER_FORWARD, RENDERER_DEFERRED };
+int rendererMode = RENDERER_FORWARD;
+//GPU time of the opaque scene, the lit pass or the G-buffer pass, and of the deferred lighting on top
+PassQuery* scenePassQuery = nullptr;
+PassQuery* lightingPassQuery = nullptr;
+GBuffer* sceneGBuffer = nullptr;
+//Lays the scene's depth down nearest first with a depth only program, the scene pass then depth tests GL_EQUAL
+//and shades each pixel once. Pays off when the samples the scene pass shades per pixel drop by more than the
+//pre-pass costs
+bool depthPrepass = false;
+PassQuery* depthPrepassQuery = nullptr;
+//Draws of the camera passes, for the state change counts
+RenderQueue* sceneRenderQueue = nullptr;
+//Scenes that show where each mode wins. Overdraw is a dense block of cubes under many small lights, forward shades
+//the pixels covered several times over and deferred lights each once. Sparse is a few cubes under a few lights,
+//writing and reading back the G-buffer costs more than the little overdraw it saves
+enum BenchmarkScene { BENCHMARK_OVERDRAW, BENCHMARK_SPARSE };
+enum ShadowCasterIndex { SHADOW_CASTER_PLANK, SHADOW_CASTER_CUBES, SHADOW_CASTER_MODEL, SHADOW_CASTER_LIGHTS };
+//Rebuilt every frame, one per light cube from SHADOW_CASTER_LIGHTS on
+std::vector<ShadowCaster> shadowCasters;
+ShadowStats shadowStats;
+
+//Uniform handles, resolved once so the render loop never builds uniform names
+std::vector<Uniform<int>> pointShadowTierUniforms;
+std::vector<Uniform<int>> pointShadowCompareTierUniforms;
+std::vector<Uniform<glm::mat4>> shadowMatrixUniforms;
+std::vector<Uniform<int>> shadowFacesUniforms;
+
+void InitUniformHandles();
+
+//Scene shader features, each combination is its own program variant
+bool spotLightEnabled = false;
+//How point shadows are filtered. The first three compare in hardware, 2x2 bilinear PCF per tap, with the Poisson kernels
+//stopping after four taps where those agree. The last two read raw depth and compare in the shader, kept for reference
+enum PointShadowQuality { POINT_SHADOW_HARD, POINT_SHADOW_POISSON_8, POINT_SHADOW_POISSON_16, POINT_SHADOW_GRID_20, POINT_SHADOW_CUBE_64 };
+const char* POINT_SHADOW_QUALITY_NAMES[] = { "Hardware PCF (1 tap)", "Poisson (8 taps)", "Poisson (16 taps)", "Grid (20 taps)", "PCF Cube (64 taps)" };
+const int POINT_SHADOW_QUALITY_TAPS[] = { 1, 8, 16, 0, 0 };
+int pointShadowQuality = POINT_SHADOW_POISSON_8;
+ShaderDefines SceneShaderDefines();
+void UpdateCubeInstances(VBO& instanceVBO, Mesh& cube);
+GLsizei CullCubes(const Frustum& frustum, VBO& visibleInstanceVBO, const glm::vec3* viewPosition = nullptr);
+bool CullMesh(const Frustum& frustum, Mesh& mesh, const glm::vec3& position, const glm::vec3& rotation);
+void ScatterCubes(int count);
+void ScatterLights(int count, const glm::vec3& center = glm::vec3(0.0f, 2.5f, 0.0f), const glm::vec3& extent = glm::vec3(20.0f, 2.0f, 20.0f));
+void LoadBenchmarkScene(BenchmarkScene scene);
+float PointLightRange(const PointLight& light);
+float PointLightImportance(const PointLight& light, const Frustum& frustum);
 
 glm::vec3 plankPosition = glm::vec3(0.0f);
 glm::vec3 plankRotation = glm::vec3(0.0f, 0.0f, 0.0f);;
@@ -201,10 +359,23 @@ glm::vec3 cubeScale = glm::vec3(0.2f);
 //glm::vec3 lightPosition = glm::vec3(0.0f);
 glm::vec3 lightRotation = glm::vec3(0.0f);
 glm::vec3 lightScale = glm::vec3(0.1f);
+glm::vec3 modelPosition = glm::vec3(0.0f);
+glm::vec3 modelRotation = glm::vec3(0.0f);
+glm::vec3 modelScale = glm::vec3(0.01f);
 
-int main() 
+int main(int argc, char* argv[]) 
 {
-	
+	//--resources <dir> serves the loose files of that directory, e.g. a checkout, the other
+	//argument is the model to load
+	std::string resourceDir, modelArgument;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--resources" && i + 1 < argc)
+			resourceDir = argv[++i];
+		else
+			modelArgument = argv[i];
+	}
+
 	//Instantiate GLFW Window
 	InitWindow();
 
@@ -242,7 +413,9 @@ int main()
 	glCullFace(GL_BACK);
 	glFrontFace(GL_CCW);
 
-	camera.SetScreenDimensions(SCR_WIDTH, SCR_LENGTH);
+	//Can differ from the window size on high DPI screens
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	camera.SetScreenDimensions(framebufferWidth, framebufferHeight);
 
 #pragma region Init Shaders
 
@@ -255,30 +428,146 @@ int main()
 	std::string point_depth_vs = "\\PointLightShadowDepthVS.vs";
 	std::string point_depth_fs = "\\PointLightShadowDepthFS.fs";
 	std::string point_depth_gs = "\\PointLightShadowDepthGS.gs";
-
-	Shader mainShader((rootDir + vs).c_str(), (rootDir + fs).c_str());
+	std::string placeholder_fs = "\\PlaceholderShader.fs";
+	std::string gbuffer_fs = "\\GBufferShader.fs";
+
+	//Resources come from the directory given on the command line, otherwise from the packed archive
+	//when there is one, mapped once for all of them, otherwise from the working directory
+	if (!resourceDir.empty())
+		VirtualFileSystem::Mount(rootDir, resourceDir);
+	else if (!(fs::exists(archivePath) && VirtualFileSystem::Mount(rootDir, archivePath)))
+		VirtualFileSystem::Mount(rootDir, fs::current_path().string());
+
+	//Program binaries are cached on disk, a warm start skips GLSL compilation entirely
+	ShaderCache::Init(VirtualFileSystem::DiskPath(rootDir + "\\ShaderCache"));
+	Shader::EnableParallelCompile();
+
+	//Tiny flat colour program, built up front and bound for anything still compiling
+	Shader placeholderShader((rootDir + l_vs).c_str(), (rootDir + placeholder_fs).c_str());
+	placeholderShader.WaitUntilReady();
+	Shader::SetPlaceholder(&placeholderShader);
+
+	//Every program is submitted before any of them is waited on, the driver compiles them in parallel
+	//and the render loop starts straight away, polling each one when it is first activated
+	double shaderStartTime = glfwGetTime();
+
+	//Scene shader variants are specialised by defines and compiled the first time they are used
+	ShaderPermutations sceneShaders((rootDir + vs).c_str(), (rootDir + fs).c_str());
+	sceneShaders.Get(SceneShaderDefines());
+	ShaderPermutations instancedSceneShaders((rootDir + vs).c_str(), (rootDir + fs).c_str(), nullptr, { { "INSTANCED", "1" } });
+	instancedSceneShaders.Get(SceneShaderDefines());
 	Shader lightShader((rootDir + l_vs).c_str(), (rootDir + l_fs).c_str());
-	//Dir Light Shadow Shader
-	Shader depthShader((rootDir + depth_vs).c_str(), (rootDir + depth_fs).c_str());
-	//Point Light Shadow Shader
-	Shader simpleDepthShader((rootDir + point_depth_vs).c_str(), (rootDir + point_depth_fs).c_str(), (rootDir + point_depth_gs).c_str());
-#pragma endregion
-
-#pragma region Plank
+	//Deferred path, the geometry pass programs and the lighting pass variants, which share the scene defines
+	Shader gBufferShader((rootDir + vs).c_str(), (rootDir + gbuffer_fs).c_str(), nullptr, { { "MATERIAL_ARRAY", "1" } });
+	Shader instancedGBufferShader((rootDir + vs).c_str(), (rootDir + gbuffer_fs).c_str(), nullptr, { { "MATERIAL_ARRAY", "1" }, { "INSTANCED", "1" } });
+	ShaderPermutations deferredLightingShaders((rootDir + vs).c_str(), (rootDir + fs).c_str(), nullptr, { { "DEFERRED", "1" } });
+	//Depth pre-pass, the scene's own vertex shader with the defines of the lit pass so positions come out the same
+	Shader depthPrepassShader((rootDir + vs).c_str(), (rootDir + depth_fs).c_str(), nullptr, { { "MATERIAL_ARRAY", "1" } });
+	Shader instancedDepthPrepassShader((rootDir + vs).c_str(), (rootDir + depth_fs).c_str(), nullptr, { { "MATERIAL_ARRAY", "1" }, { "INSTANCED", "1" } });
+	//Dir Light Shadow Shader, drawn into each cascade
+	Shader cascadeDepthShader((rootDir + depth_vs).c_str(), (rootDir + depth_fs).c_str());
+	Shader instancedCascadeDepthShader((rootDir + depth_vs).c_str(), (rootDir + depth_fs).c_str(), nullptr, { { "INSTANCED", "1" } });
+	//Point Light Shadow Shader, a pair of programs for each PointShadowPath
+	Shader simpleDepthShader((rootDir + point_depth_vs).c_str(), (rootDir + point_depth_fs).c_str(), (rootDir + point_depth_gs).c_str(), { { "GEOMETRY_FACES", "1" } });
+	Shader instancedDepthShader((rootDir + point_depth_vs).c_str(), (rootDir + point_depth_fs).c_str(), (rootDir + point_depth_gs).c_str(), { { "GEOMETRY_FACES", "1" }, { "INSTANCED", "1" } });
+	Shader faceDepthShader((rootDir + point_depth_vs).c_str(), (rootDir + point_depth_fs).c_str());
+	Shader instancedFaceDepthShader((rootDir + point_depth_vs).c_str(), (rootDir + point_depth_fs).c_str(), nullptr, { { "INSTANCED", "1" } });
+	std::unique_ptr<Shader> layerDepthShader, instancedLayerDepthShader;
+	if (GLAD_GL_ARB_shader_viewport_layer_array)
+	{
+		layerDepthShader = std::make_unique<Shader>((rootDir + point_depth_vs).c_str(), (rootDir + point_depth_fs).c_str(), nullptr, ShaderDefines{ { "VERTEX_LAYER", "1" } });
+		instancedLayerDepthShader = std::make_unique<Shader>((rootDir + point_depth_vs).c_str(), (rootDir + point_depth_fs).c_str(), nullptr, ShaderDefines{ { "VERTEX_LAYER", "1" }, { "INSTANCED", "1" } });
+		pointShadowPath = POINT_SHADOW_VERTEX_LAYER;
+	}
 
-	mainShader.setInt("num_pointLights", 0);
-	Texture textures[]
+	double shaderTime = (glfwGetTime() - shaderStartTime) * 1000.0;
+	const char* startKind = ShaderCache::Hits == 0 ? "cold" : (ShaderCache::Misses == 0 ? "warm" : "partially warm");
+	std::cout << "Shaders: " << startKind << " start, "
+		<< ShaderCache::Hits << " from cache, " << ShaderCache::Misses << " submitted in " << shaderTime << " ms" << std::endl;
+	bool shadersReported = false;
+
+	InitUniformHandles();
+	const Uniform<glm::vec3> lightPosUniform("lightPos");
+	const Uniform<int> shadowSlotUniform("shadowSlot");
+	const Uniform<glm::mat4> lightSpaceMatrixUniform("lightSpaceMatrix");
+	const Uniform<int> dirShadowCascadesUniform("dirShadowCascades");
+	const Uniform<glm::mat4> inverseViewProjectionUniform("inverseViewProjection");
+
+	//Material parameters and the light list units never change, set them once as soon as the program has linked
+	auto setConstants = [](Shader& shader)
 	{
-		Texture(textureDirectory, "planks.png", "diffuse", 0, GL_UNSIGNED_BYTE),
-		Texture(textureDirectory, "planksSpec.png", "specular", 1, GL_UNSIGNED_BYTE)
+		shader.setFloat("material.shininess", 32.0f);
+		MaterialLibrary::SetSamplers(shader);
+		LightClusters::SetSamplers(shader);
 	};
+	sceneShaders.OnCreate(setConstants);
+	instancedSceneShaders.OnCreate(setConstants);
+	deferredLightingShaders.OnCreate([&setConstants](Shader& shader)
+		{
+			setConstants(shader);
+			GBuffer::SetSamplers(shader);
+		});
+	gBufferShader.OnReady(MaterialLibrary::SetSamplers);
+	instancedGBufferShader.OnReady(MaterialLibrary::SetSamplers);
+#pragma endregion
+
+#pragma region Uniform Buffers
+	//Camera and light data are written once per frame and shared by every program
+	FrameBlock frameData = {};
+	LightBlock lightData = {};
+	UBO frameUBO(sizeof(FrameBlock), FRAME_BLOCK_BINDING);
+	UBO lightUBO(sizeof(LightBlock), LIGHT_BLOCK_BINDING);
+#pragma endregion
+
+#pragma region Texture Streaming
+	//Images decode in parallel on worker threads and stream into their textures a few MB per frame,
+	//meshes draw with a placeholder colour until then
+	ThreadPool workerPool;
+	TextureStreamer textureStreamer(workerPool);
+	TextureManager::SetStreamer(&textureStreamer);
+	double textureStartTime = glfwGetTime();
+	bool texturesReported = false;
+
+	//Plank and cube maps become layers of texture arrays, a draw only switches the layer index
+	//unless the next material lives in a different array. The maps decode on the workers and their
+	//layers stream in through the same pixel buffers, materials show a placeholder layer until then
+	MaterialLibrary materials(&workerPool, &textureStreamer);
+	unsigned int plankMaterial = materials.Add(textureDirectory, "planks.png", "planksSpec.png");
+	unsigned int containerMaterial = materials.Add(textureDirectory, "container2.png", "container2_specular.png");
+	sceneMaterials = &materials;
+#pragma endregion
+
+#pragma region Light Clusters
+	//Point lights are binned into froxels on the workers while the shadow maps are drawn
+	LightClusters clusters(workerPool);
+	lightClusters = &clusters;
+	std::vector<glm::vec4> lightSpheres;
+	std::vector<PointLightData> pointLightData;
+#pragma endregion
+
+#pragma region Deferred
+	//Surfaces of the deferred path, sized to the window like the rest of the passes
+	GBuffer gBuffer(framebufferWidth, framebufferHeight);
+	sceneGBuffer = &gBuffer;
+	PassQuery sceneQuery;
+	scenePassQuery = &sceneQuery;
+	PassQuery lightingQuery;
+	lightingPassQuery = &lightingQuery;
+	PassQuery prepassQuery;
+	depthPrepassQuery = &prepassQuery;
+	//The camera passes queue their draws and bind in sort key order
+	RenderQueue renderQueue;
+	sceneRenderQueue = &renderQueue;
+#pragma endregion
+
+#pragma region Plank
 
 	// Store mesh data in vectors for the mesh
 	std::vector <Vertex> verts(vertices, vertices + sizeof(vertices) / sizeof(Vertex));
 	std::vector <GLuint> ind(indices, indices + sizeof(indices) / sizeof(GLuint));
-	std::vector <Texture> tex(textures, textures + sizeof(textures) / sizeof(Texture));
 	
-	Mesh plank(verts, ind, tex);
+	Mesh plank(verts, ind, std::vector<Texture>());
+	plank.SetMaterial(&materials, plankMaterial);
 
 	plank.UpdateBoundingBoxScale(plankScale);
 
@@ -286,21 +575,23 @@ int main()
 
 #pragma region Instanced Cube
 
-	Texture instancedTextures[]
-	{
-		Texture(textureDirectory, "container2.png", "diffuse", 0, GL_UNSIGNED_BYTE),
-		Texture(textureDirectory, "container2_specular.png", "specular", 1, GL_UNSIGNED_BYTE)
-	};
-
 	// Store mesh data in vectors for the mesh
 	std::vector <Vertex> cubeVerts(instancedVertices, instancedVertices + sizeof(instancedVertices) / sizeof(Vertex));	
 	std::vector <GLuint> cubeInd(instancedIndices, instancedIndices + sizeof(instancedIndices) / sizeof(GLuint));
-	std::vector <Texture> cubeTex(instancedTextures, instancedTextures + sizeof(instancedTextures) / sizeof(Texture));
 
-	Mesh cube(cubeVerts, cubeInd, cubeTex);
+	Mesh cube(cubeVerts, cubeInd, std::vector<Texture>());
+	cube.SetMaterial(&materials, containerMaterial);
 
 	cube.UpdateBoundingBoxScale(cubeScale);
 
+	//Every cube is drawn in one call, placed by a per-instance model matrix. The shadow pass draws all of them,
+	//the camera pass only the ones that survive frustum culling, compacted into a second buffer each frame
+	VBO cubeInstanceVBO(sizeof(glm::mat4));
+	VBO visibleCubeInstanceVBO(sizeof(glm::mat4));
+	//A shadow cube's cubes sorted by face, refilled for every light drawn without the geometry shader
+	VBO shadowCubeInstanceVBO(sizeof(glm::mat4));
+	cube.SetInstanceBuffer(cubeInstanceVBO);
+
 #pragma endregion
 
 #pragma region Light Cube
@@ -312,71 +603,61 @@ int main()
 
 	
 
-	Mesh lightCube(lightVerts, lightInd, lightTex);
+	//The light shader only reads positions
+	Mesh lightCube(lightVerts, lightInd, std::move(lightTex), VertexLayout::PositionOnly());
 
 	lightCube.UpdateBoundingBoxScale(lightScale);
 
 #pragma endregion	
 
-#pragma region Directional Shadow Map
-	//GLuint depthMapFBO;
-	//glGenFramebuffers(1, &depthMapFBO);
-
-	//
-
-	//GLuint shadowMap;
-	//glGenTextures(1, &shadowMap);
-	//glBindTexture(GL_TEXTURE_2D, shadowMap);
-	//glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	//glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	//glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowMap, 0);
-	//glDrawBuffer(GL_NONE);
-	//glReadBuffer(GL_NONE);
+	//The material maps have been decoding while the meshes were set up, allocate their arrays now
+	materials.Build();
 
-	//// Always check that our framebuffer is ok
-	//if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	//	return false;
+#pragma region Model
 
-
-	//glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	
-
-#pragma endregion
-
-#pragma region Point Light Shadow Map
-	// Framebuffer for Cubemap Shadow Map
-	std::vector<GLuint> pointShadowMapFBOs(MAX_POINTLIGHTS);
-	std::vector<GLuint> depthCubemaps(MAX_POINTLIGHTS);
-
-	for (unsigned int i = 0; i < MAX_POINTLIGHTS; ++i) 
+	//A model given on the command line, otherwise Sponza when it is in the models folder
+	std::string modelPath = !modelArgument.empty() ? modelArgument : modelDirectory + "\\sponza\\sponza.obj";
+	std::unique_ptr<Model> model;
+	if (VirtualFileSystem::Exists(modelPath) || VirtualFileSystem::Exists(MeshFile::CachePath(modelPath)))
 	{
-		glGenFramebuffers(1, &pointShadowMapFBOs[i]);
-		// Texture for Cubemap Shadow Map FBO
-		glGenTextures(1, &depthCubemaps[i]);
-
-		glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemaps[i]);
-		for (unsigned int i = 0; i < 6; ++i)
+		model = std::make_unique<Model>(modelPath, workerPool, materials);
+		if (model->Empty())
+			model.reset();
+	}
+	sceneModel = model.get();
+	//Shadow casting needs the box around every mesh at the model's origin, the placement goes on top each frame
+	BoundingBox modelBounds;
+	if (model)
+	{
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		for (Mesh& mesh : model->meshes)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+			BoundingBox box = mesh.GetMeshBoundingBox();
+			boundsMin = glm::min(boundsMin, glm::vec3(box.getMinX(), box.getMinY(), box.getMinZ()));
+			boundsMax = glm::max(boundsMax, glm::vec3(box.getMaxX(), box.getMaxY(), box.getMaxZ()));
 		}
+		modelBounds = BoundingBox((boundsMin + boundsMax) * 0.5f, boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z,
+			boundsMin.x, boundsMin.y, boundsMin.z, boundsMax.x, boundsMax.y, boundsMax.z);
+	}
+
+#pragma endregion
 
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+#pragma region Directional Shadow Map
+	//Cascades of the directional light, one layer each of a depth array, fitted to the view every frame
+	CascadedShadowMap sunShadows(SHADOW_CASCADE_SIZE, (unsigned int)shadowCascadeCount);
+	//The cubes that land in a cascade, refilled for each one
+	VBO cascadeCubeInstanceVBO(sizeof(glm::mat4));
+#pragma endregion
 
-		glBindFramebuffer(GL_FRAMEBUFFER, pointShadowMapFBOs[i]);
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemaps[i], 0);
-		glDrawBuffer(GL_NONE);
-		glReadBuffer(GL_NONE);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	}
+#pragma region Point Light Shadow Map
+	std::unique_ptr<PointShadowAtlas> shadowAtlas;
+	if (PointShadowAtlas::Supported())
+		shadowAtlas = std::make_unique<PointShadowAtlas>(POINT_SHADOW_TIERS);
+	else
+		std::cout << "ERROR::SHADOW::NO_CUBE_MAP_ARRAYS point lights are drawn without shadows" << std::endl;
+	pointShadowAtlas = shadowAtlas.get();
+	PassQuery shadowQuery;
+	pointShadowQuery = &shadowQuery;
 	
 #pragma endregion
 	
@@ -388,6 +669,11 @@ int main()
 	//ImGui
 	InitImGui(window);
 
+	//Scene and deferred lighting defines with their permutation keys, rebuilt only when a setting they depend on changes
+	ShaderDefines sceneDefines, deferredDefines;
+	std::string sceneKey, deferredKey;
+	int sceneSettings = -1;
+
 	//Render Loop
 	while (!glfwWindowShouldClose(window))
 	{
@@ -404,184 +690,318 @@ int main()
 
 		ImGuiNewFrame();		
 
+		materials.BeginFrame();
+
+		textureStreamer.Update();
+		if (!texturesReported && textureStreamer.Pending() == 0)
+		{
+			std::cout << "Textures: all resident after " << (glfwGetTime() - textureStartTime) * 1000.0 << " ms on "
+				<< workerPool.Size() << " decode threads" << std::endl;
+			texturesReported = true;
+		}
+
 
 		//Setup lights
 
-		mainShader.setInt("num_pointLights", pointLights.size());
-		SetupLights(mainShader, camera);
-
-		for (unsigned int i = 0; i < pointLights.size(); ++i)
-		{
-			mainShader.Activate();
-			mainShader.setInt("depthMap[" + std::to_string(i) + "]", 2);
-
-			// 0. create depth cubemap transformation matrices
-			// -----------------------------------------------
-			float near_plane = 1.0f;
-			float far_plane = 25.0f;
-			glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, near_plane, far_plane);
-			std::vector<glm::mat4> shadowTransforms;
-			shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].Position, pointLights[0].Position + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-			shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].Position, pointLights[0].Position + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-			shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].Position, pointLights[0].Position + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-			shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].Position, pointLights[0].Position + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
-			shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].Position, pointLights[0].Position + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-			shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].Position, pointLights[0].Position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-
-			// 1. render scene to depth cubemap
-			// --------------------------------
-			glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-			glBindFramebuffer(GL_FRAMEBUFFER, pointShadowMapFBOs[i]);
-			glClear(GL_DEPTH_BUFFER_BIT);
-			simpleDepthShader.Activate();
-			for (unsigned int j = 0; j < 6; ++j)
-			{ 
-				simpleDepthShader.setMat4("shadowMatrices[" + std::to_string(j) + "]", shadowTransforms[j]); 
-			}				
-			simpleDepthShader.setFloat("far_plane", far_plane);
-			simpleDepthShader.setVec3("lightPos", pointLights[i].Position);
-			//simpleDepthShader.setVec3("pointLights[" + std::to_string(0) + "].position", pointLights[0].Position);
-
-			RenderScene(simpleDepthShader, plank, cube);
-			RenderLightObj(simpleDepthShader, lightCube);
+		camera.UpdateCameraMatrix(frameData);
+		frameData.farPlane = POINT_SHADOW_FAR;
+		frameUBO.Update(&frameData, sizeof(FrameBlock));
+
+		int settings = (spotLightEnabled ? 1 : 0) | (cascadedShadows ? 2 : 0) | (pointShadowQuality << 2);
+		if (settings != sceneSettings)
+		{
+			sceneDefines = SceneShaderDefines();
+			sceneKey = ShaderPermutations::Key(sceneDefines);
+			deferredDefines = sceneDefines;
+			deferredDefines.erase("MATERIAL_ARRAY");
+			deferredKey = ShaderPermutations::Key(deferredDefines);
+			sceneSettings = settings;
+		}
+		Shader& mainShader = sceneShaders.Get(sceneDefines, sceneKey);
+		Shader& instancedShader = instancedSceneShaders.Get(sceneDefines, sceneKey);
+		//The lighting pass reads its surfaces from the G-buffer, the material arrays are only sampled in the geometry pass
+		Shader* deferredShader = nullptr;
+		if (rendererMode == RENDERER_DEFERRED)
+		{
+			deferredShader = &deferredLightingShaders.Get(deferredDefines, deferredKey);
+		}
+		//Until all three deferred programs have linked the frame is drawn forward
+		bool deferred = deferredShader != nullptr && deferredShader->IsReady() && gBufferShader.IsReady() && instancedGBufferShader.IsReady();
+		//Every program that shades with the lights and reads the shadow maps
+		std::vector<Shader*> litShaders = { &mainShader, &instancedShader };
+		if (deferred)
+			litShaders.push_back(deferredShader);
+
+		if (cubeInstancesDirty)
+			UpdateCubeInstances(cubeInstanceVBO, cube);
+
+		//Cull against the camera, only what survives is submitted in the main pass
+		Frustum cameraFrustum(camera.GetProjectionMatrix() * camera.GetViewMatrix());
+		cullStats = CullStats();
+		bool plankVisible = CullMesh(cameraFrustum, plank, plankPosition, plankRotation);
+		GLsizei visibleCubeCount = CullCubes(cameraFrustum, visibleCubeInstanceVBO, depthPrepass ? &camera.Position : nullptr);
+
+		if (!shadersReported && mainShader.IsReady() && instancedShader.IsReady() && lightShader.IsReady()
+			&& cascadeDepthShader.IsReady() && instancedCascadeDepthShader.IsReady()
+			&& simpleDepthShader.IsReady() && instancedDepthShader.IsReady() && faceDepthShader.IsReady() && instancedFaceDepthShader.IsReady()
+			&& (!layerDepthShader || (layerDepthShader->IsReady() && instancedLayerDepthShader->IsReady())))
+		{
+			std::cout << "Shaders: all programs linked after " << (glfwGetTime() - shaderStartTime) * 1000.0 << " ms" << std::endl;
+			shadersReported = true;
+		}
+
+		//Binning only needs where the lights reach, the shadow slots go up with the rest of the light data
+		lightSpheres.resize(pointLights.size());
+		for (size_t i = 0; i < pointLights.size(); ++i)
+			lightSpheres[i] = glm::vec4(pointLights[i].Position, PointLightRange(pointLights[i]));
+		clusters.Bin(camera, lightSpheres);
+
+		GatherShadowCasters(plank, lightCube, modelBounds);
+		shadowStats = ShadowStats();
+		if (pointShadowPath == POINT_SHADOW_VERTEX_LAYER && !layerDepthShader)
+			pointShadowPath = POINT_SHADOW_SIX_PASSES;
+		ShadowDraw shadowDraw = {};
+		shadowDraw.path = (PointShadowPath)pointShadowPath;
+		shadowDraw.shader = shadowDraw.path == POINT_SHADOW_GEOMETRY_SHADER ? &simpleDepthShader
+			: (shadowDraw.path == POINT_SHADOW_VERTEX_LAYER ? layerDepthShader.get() : &faceDepthShader);
+		shadowDraw.instancedShader = shadowDraw.path == POINT_SHADOW_GEOMETRY_SHADER ? &instancedDepthShader
+			: (shadowDraw.path == POINT_SHADOW_VERTEX_LAYER ? instancedLayerDepthShader.get() : &instancedFaceDepthShader);
+		shadowDraw.cubeInstances = shadowDraw.path == POINT_SHADOW_GEOMETRY_SHADER ? &cubeInstanceVBO : &shadowCubeInstanceVBO;
+		bool pointDepthReady = shadowDraw.shader->IsReady() && shadowDraw.instancedShader->IsReady();
+		pointShadowMaps.resize(pointLights.size());
+
+		if (shadowAtlas)
+		{
+			//The lights that cover the most of the screen get the largest cubes
+			std::vector<float> importance(pointLights.size());
+			for (size_t i = 0; i < pointLights.size(); ++i)
+				importance[i] = PointLightImportance(pointLights[i], cameraFrustum);
+			shadowAtlas->Assign(pointShadowMaps, importance);
+
+			// 1. render scene to the depth cubemaps that changed, as many as the budget allows
+			// --------------------------------------------------------------------------------
+			//Maps that were never drawn come first, the light is unshadowed until then, the rest by importance
+			bool splitLayers = PointShadowMap::SplitLayers(shadowCasters, pointShadowSplit);
+			std::vector<std::pair<unsigned int, unsigned int>> staleMaps;
+			for (unsigned int i = 0; i < pointLights.size(); ++i)
+			{
+				PointShadowMap& shadowMap = pointShadowMaps[i];
+				if (shadowMap.Slot < 0)
+					continue;
+				if (!pointShadowCaching)
+					shadowMap.Invalidate();
+				unsigned int staleLayers = shadowMap.Stale(pointLights[i].Position, POINT_SHADOW_FAR, shadowCasters, splitLayers);
+				if (staleLayers == 0)
+					shadowStats.Cached++;
+				else
+					staleMaps.push_back({ i, staleLayers });
+			}
+			std::stable_sort(staleMaps.begin(), staleMaps.end(), [&importance](const std::pair<unsigned int, unsigned int>& a, const std::pair<unsigned int, unsigned int>& b)
+				{
+					if (pointShadowMaps[a.first].Drawn() != pointShadowMaps[b.first].Drawn())
+						return !pointShadowMaps[a.first].Drawn();
+					return importance[a.first] > importance[b.first];
+				});
+
+			//The placeholder has no cubemap layering, the maps stay undrawn until the real program links
+			float spent = 0.0f;
+			shadowQuery.Begin();
+			for (size_t k = 0; k < staleMaps.size() && pointDepthReady; ++k)
+			{
+				unsigned int i = staleMaps[k].first;
+				unsigned int staleLayers = staleMaps[k].second;
+				PointShadowMap& shadowMap = pointShadowMaps[i];
+				float cost = shadowAtlas->Cost(shadowMap.Tier);
+				if (spent > 0.0f && spent + cost > pointShadowBudget)
+				{
+					shadowStats.Deferred++;
+					continue;
+				}
+				spent += cost;
+
+				// 0. create depth cubemap transformation matrices
+				// -----------------------------------------------
+				const glm::vec3& lightPosition = pointLights[i].Position;
+				glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, POINT_SHADOW_NEAR, POINT_SHADOW_FAR);
+				glm::mat4 shadowTransforms[6];
+				shadowTransforms[0] = shadowProj * glm::lookAt(lightPosition, lightPosition + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+				shadowTransforms[1] = shadowProj * glm::lookAt(lightPosition, lightPosition + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+				shadowTransforms[2] = shadowProj * glm::lookAt(lightPosition, lightPosition + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+				shadowTransforms[3] = shadowProj * glm::lookAt(lightPosition, lightPosition + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+				shadowTransforms[4] = shadowProj * glm::lookAt(lightPosition, lightPosition + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+				shadowTransforms[5] = shadowProj * glm::lookAt(lightPosition, lightPosition + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+
+				Shader* pointDepthShaders[] = { shadowDraw.shader, shadowDraw.instancedShader };
+				for (Shader* pointDepthShader : pointDepthShaders)
+				{
+					pointDepthShader->Activate();
+					for (unsigned int j = 0; j < 6; ++j)
+					{ 
+						pointDepthShader->setUniform(shadowMatrixUniforms[j], shadowTransforms[j]); 
+					}				
+					pointDepthShader->setUniform(lightPosUniform, lightPosition);
+					pointDepthShader->setUniform(shadowSlotUniform, shadowMap.Slot);
+				}
+
+				shadowDraw.map = &shadowMap;
+				shadowDraw.split = splitLayers;
+				CubeFrustum lightFaces(shadowTransforms);
+				shadowDraw.faces = nullptr;
+				if (shadowDraw.path != POINT_SHADOW_GEOMETRY_SHADER)
+				{
+					shadowDraw.faces = &lightFaces;
+					CullShadowCubes(lightFaces, shadowCubeInstanceVBO, shadowDraw);
+				}
+
+				if (staleLayers & POINT_SHADOW_STATIC_LAYER)
+				{
+					shadowAtlas->BeginStaticLayer(shadowMap, splitLayers);
+					RenderShadowCasters(shadowDraw, plank, cube, lightCube, model.get(), false);
+					shadowStats.Redrawn++;
+				}
+				if (staleLayers & POINT_SHADOW_DYNAMIC_LAYER)
+				{
+					shadowAtlas->BeginDynamicLayer(shadowMap);
+					RenderShadowCasters(shadowDraw, plank, cube, lightCube, model.get(), true);
+					shadowStats.Composited++;
+				}
+				shadowMap.MarkDrawn(lightPosition, POINT_SHADOW_FAR, shadowCasters, splitLayers);
+			}
+			shadowQuery.End();
 
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, framebufferWidth, framebufferHeight);
+
+			//A variant only has one of the two sampler sets, whichever filter it was built for
+			shadowAtlas->Bind(2);
+			int compareUnit = 2 + (int)shadowAtlas->TierCount();
+			for (Shader* shader : litShaders)
+			{
+				shader->Activate();
+				for (unsigned int t = 0; t < shadowAtlas->TierCount(); ++t)
+				{
+					shader->setUniform(pointShadowTierUniforms[t], 2 + (int)t);
+					shader->setUniform(pointShadowCompareTierUniforms[t], compareUnit + (int)t);
+				}
+			}
+		}
 
-			// 2. render scene as normal 
-			// -------------------------
-			glViewport(0, 0, SCR_WIDTH, SCR_LENGTH);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			mainShader.Activate();
-			glm::mat4 projection = camera.GetProjectionMatrix();
-			glm::mat4 view = camera.GetViewMatrix();
-			mainShader.setMat4("projection", projection);
-			mainShader.setMat4("view", view);
-			// set lighting uniforms
-			//mainShader.setVec3("lightPos", pointLights[0].Position);
-			mainShader.setVec3("pointLights[" + std::to_string(i) + "].position", pointLights[i].Position);
-			mainShader.setVec3("viewPos", camera.Position);
-			//shader.setInt("shadows", shadows); // enable/disable shadows by pressing 'SPACE'
-			mainShader.setFloat("far_plane", far_plane);
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemaps[i]);
-			//renderScene(shader);
-		}
-
-		//Render Scene
-		RenderScene(mainShader, plank, cube);
-		RenderLightObj(lightShader, lightCube);
-
-//		// 1. render depth of scene to texture (from light's perspective)
-//		// --------------------------------------------------------------
-//		glm::mat4 lightProjection, lightView;
-//		glm::mat4 lightSpaceMatrix;
-//		float near_plane = 1.0f, far_plane = 25.0f;
-//		//lightProjection = glm::perspective(glm::radians(45.0f), (GLfloat)SHADOW_WIDTH / (GLfloat)SHADOW_HEIGHT, near_plane, far_plane); // note that if you use a perspective projection matrix you'll have to change the light position as the current light position isn't enough to reflect the whole scene
-//		lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-//		lightView = glm::lookAt(lightPos, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-//		lightSpaceMatrix = lightProjection * lightView;
-//		// render scene from light's point of view
-//		depthShader.Activate();
-//		depthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-//
-//		glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-//		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-//		glClear(GL_DEPTH_BUFFER_BIT);
-//
-//#pragma region Scene Objects
-//#pragma region Plank Draw
-//
-//		plank.SetMeshProperties(depthShader, camera, plankPosition, plankRotation, plankScale);
-//		plank.Draw(depthShader);
-//
-//		/*cube.SetMeshProperties(mainShader, camera, cubePos, cubeRotation, cubeScale);
-//		cube.Draw(mainShader);*/
-//
-//#pragma endregion 
-//
-//#pragma region Light Cube draw
-//
-//
-//		mainShader.setInt("num_pointLights", pointLights.size());
-//		for (unsigned int i = 0; i < pointLights.size(); i++)
-//		{
-//			glm::mat4 lightModel = glm::mat4(1.0f);
-//
-//			/*pointLightPositions[i].x = radius * cos(speed * currentFrame);
-//			pointLightPositions[i].y = radius * sin(speed * currentFrame);*/
-//			lightCube.SetMeshProperties(lightShader, camera, pointLights[i].Position, lightRotation, lightScale);
-//			lightShader.setVec3("lightColor", pointLights[i].Color);
-//			lightCube.Draw(lightShader);
-//		}
-//
-//#pragma endregion
-//
-//#pragma region Instanced Cube Draw
-//
-//		for (int i = 0; i < cubePositions.size(); i++)
-//		{
-//			cube.SetMeshProperties(depthShader, camera, cubePositions[i], cubeRotation, cubeScale);
-//			cube.Draw(depthShader);
-//		}
-//
-//#pragma endregion 
-//#pragma endregion
-//
-//		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-//
-//		// reset viewport
-//		glViewport(0, 0, SCR_WIDTH, SCR_LENGTH);
-//		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-//
-//		// 2. render scene as normal using the generated depth/shadow map  
-//		// --------------------------------------------------------------
-//		mainShader.Activate();		
-//		mainShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-//
-//		mainShader.Activate();
-//		glActiveTexture(GL_TEXTURE0 + 2);
-//		glBindTexture(GL_TEXTURE_2D, shadowMap);
-//		mainShader.setInt("shadowMap", 2);
-//
-//#pragma region Scene Objects
-//#pragma region Plank Draw
-//
-//		plank.SetMeshProperties(mainShader, camera, plankPosition, plankRotation, plankScale);
-//		plank.Draw(mainShader);
-//
-//		/*cube.SetMeshProperties(mainShader, camera, cubePos, cubeRotation, cubeScale);
-//		cube.Draw(mainShader);*/
-//
-//#pragma endregion 
-//
-//#pragma region Light Cube draw
-//
-//
-//		mainShader.setInt("num_pointLights", pointLights.size());
-//		for (unsigned int i = 0; i < pointLights.size(); i++)
-//		{
-//			glm::mat4 lightModel = glm::mat4(1.0f);
-//
-//			/*pointLightPositions[i].x = radius * cos(speed * currentFrame);
-//			pointLightPositions[i].y = radius * sin(speed * currentFrame);*/
-//			lightCube.SetMeshProperties(lightShader, camera, pointLights[i].Position, lightRotation, lightScale);
-//			lightShader.setVec3("lightColor", pointLights[i].Color);
-//			lightCube.Draw(lightShader);
-//		}
-//
-//#pragma endregion
-//
-//#pragma region Instanced Cube Draw
-//
-//		for (int i = 0; i < cubePositions.size(); i++)
-//		{
-//			cube.SetMeshProperties(mainShader, camera, cubePositions[i], cubeRotation, cubeScale);
-//			cube.Draw(mainShader);
-//		}
-//
-//#pragma endregion 
-//#pragma endregion
-//		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		// 1b. render the casters into each directional shadow cascade
+		// -----------------------------------------------------------
+		//Until their programs link the cascades are left out of the scene shader and the sun is unshadowed
+		bool cascadesDrawn = cascadedShadows && cascadeDepthShader.IsReady() && instancedCascadeDepthShader.IsReady();
+		for (CullStats& stats : cascadeCullStats)
+			stats = CullStats();
+		if (cascadesDrawn)
+		{
+			//Depth only has to reach back as far as the casters
+			glm::vec3 castersMin(FLT_MAX), castersMax(-FLT_MAX);
+			for (ShadowCasterIndex caster : { SHADOW_CASTER_PLANK, SHADOW_CASTER_CUBES, SHADOW_CASTER_MODEL })
+			{
+				if (shadowCasters[caster].extent.x < 0.0f)
+					continue;
+				castersMin = glm::min(castersMin, shadowCasters[caster].center - shadowCasters[caster].extent);
+				castersMax = glm::max(castersMax, shadowCasters[caster].center + shadowCasters[caster].extent);
+			}
+
+			sunShadows.Count = (unsigned int)shadowCascadeCount;
+			sunShadows.Update(camera, ambientDir, shadowCascadeDistance, shadowCascadeLambda, (castersMin + castersMax) * 0.5f, (castersMax - castersMin) * 0.5f);
+
+			//Slope scaled offset on top of the shader's normal offset, for the surfaces facing away from the light
+			glEnable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(2.0f, 4.0f);
+			for (unsigned int c = 0; c < sunShadows.Count; ++c)
+			{
+				sunShadows.BeginCascade(c);
+				cascadeDepthShader.Activate();
+				cascadeDepthShader.setUniform(lightSpaceMatrixUniform, sunShadows.Matrices[c]);
+				instancedCascadeDepthShader.Activate();
+				instancedCascadeDepthShader.setUniform(lightSpaceMatrixUniform, sunShadows.Matrices[c]);
+				RenderCascadeCasters(cascadeDepthShader, instancedCascadeDepthShader, plank, cube, cascadeCubeInstanceVBO, model.get(),
+					Frustum(sunShadows.Matrices[c]), cascadeCullStats[c]);
+			}
+			glDisable(GL_POLYGON_OFFSET_FILL);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, framebufferWidth, framebufferHeight);
+		}
+		//Bound even when nothing was drawn, a variant still reading the cascades would otherwise sample unit 0 as a shadow array
+		sunShadows.Bind(8);
+		for (Shader* shader : litShaders)
+		{
+			shader->Activate();
+			shader->setUniform(dirShadowCascadesUniform, 8);
+		}
+
+		//The lights carry their shadow slots and the cascades, so they go up once the maps are settled
+		SetupLights(lightData, pointLightData, camera);
+		clusters.Upload(pointLightData);
+		clusters.Bind();
+		clusters.FillBlock(lightData);
+		lightData.numCascades = cascadesDrawn ? (GLint)sunShadows.Count : 0;
+		for (unsigned int c = 0; c < MAX_SHADOW_CASCADES; ++c)
+		{
+			lightData.cascadeMatrices[c] = sunShadows.Matrices[c];
+			lightData.cascadeSplits[c] = sunShadows.Splits[c];
+			lightData.cascadeTexelSizes[c] = sunShadows.TexelSizes[c];
+		}
+		lightUBO.Update(&lightData, sizeof(LightBlock));
+
+		// 2. render scene as normal 
+		// -------------------------
+		//Render Scene, straight into the window or into the G-buffer with the opaque geometry lit afterwards
+		Shader& sceneShader = deferred ? gBufferShader : mainShader;
+		Shader& instancedSceneShader = deferred ? instancedGBufferShader : instancedShader;
+		bool prepass = depthPrepass && depthPrepassShader.IsReady() && instancedDepthPrepassShader.IsReady();
+		renderQueue.Begin(camera.Position, camera.FarPlane);
+		if (prepass)
+			SubmitScene(renderQueue, RENDER_PASS_DEPTH_PREPASS, depthPrepassShader, instancedDepthPrepassShader, plank, cube, plankVisible,
+				visibleCubeInstanceVBO, visibleCubeCount, model.get(), cameraFrustum, false);
+		unsigned int modelDrawn = SubmitScene(renderQueue, RENDER_PASS_OPAQUE, sceneShader, instancedSceneShader, plank, cube, plankVisible,
+			visibleCubeInstanceVBO, visibleCubeCount, model.get(), cameraFrustum, true);
+		if (model)
+		{
+			cullStats.Submitted += modelDrawn;
+			cullStats.Culled += (unsigned int)model->meshes.size() - modelDrawn;
+		}
+		SubmitLightObj(renderQueue, lightShader, lightCube, cameraFrustum);
+
+		if (deferred)
+		{
+			//Depth is blitted 1:1 into the default framebuffer, so the targets follow its size
+			gBuffer.Resize(framebufferWidth, framebufferHeight);
+			gBuffer.BeginGeometry();
+		}
+		if (prepass)
+		{
+			prepassQuery.Begin();
+			renderQueue.Execute(RENDER_PASS_DEPTH_PREPASS);
+			prepassQuery.End();
+			//Only the nearest surface of each pixel matches, depth is final already
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
+		sceneQuery.Begin();
+		renderQueue.Execute(RENDER_PASS_OPAQUE);
+		sceneQuery.End();
+		if (prepass)
+		{
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+		}
+		if (deferred)
+		{
+			//Every covered pixel is lit once from its froxel's lights, the depth test is off so nothing is written to depth
+			lightingQuery.Begin();
+			gBuffer.BeginLighting();
+			deferredShader->Activate();
+			deferredShader->setUniform(inverseViewProjectionUniform, glm::inverse(camera.GetProjectionMatrix() * camera.GetViewMatrix()));
+			glDisable(GL_DEPTH_TEST);
+			gBuffer.DrawFullscreen(*deferredShader);
+			glEnable(GL_DEPTH_TEST);
+			lightingQuery.End();
+		}
+		//Unlit, drawn forward on top either way against the depth the G-buffer handed back
+		renderQueue.Execute(RENDER_PASS_UNLIT);
 
 		DrawImGuiWindow();
 
@@ -593,9 +1013,60 @@ int main()
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
 
-	mainShader.Delete();
+	sceneShaders.Delete();
+	instancedSceneShaders.Delete();
 	lightShader.Delete();
-	depthShader.Delete();
+	gBufferShader.Delete();
+	instancedGBufferShader.Delete();
+	depthPrepassShader.Delete();
+	instancedDepthPrepassShader.Delete();
+	deferredLightingShaders.Delete();
+	cascadeDepthShader.Delete();
+	instancedCascadeDepthShader.Delete();
+	placeholderShader.Delete();
+	simpleDepthShader.Delete();
+	instancedDepthShader.Delete();
+	faceDepthShader.Delete();
+	instancedFaceDepthShader.Delete();
+	if (layerDepthShader)
+	{
+		layerDepthShader->Delete();
+		instancedLayerDepthShader->Delete();
+	}
+	if (shadowAtlas)
+		shadowAtlas->Delete();
+	pointShadowAtlas = nullptr;
+	shadowQuery.Delete();
+	pointShadowQuery = nullptr;
+	sunShadows.Delete();
+	cascadeCubeInstanceVBO.Delete();
+	clusters.Delete();
+	gBuffer.Delete();
+	sceneGBuffer = nullptr;
+	sceneQuery.Delete();
+	scenePassQuery = nullptr;
+	lightingQuery.Delete();
+	lightingPassQuery = nullptr;
+	prepassQuery.Delete();
+	depthPrepassQuery = nullptr;
+	sceneRenderQueue = nullptr;
+	lightClusters = nullptr;
+	cubeInstanceVBO.Delete();
+	visibleCubeInstanceVBO.Delete();
+	shadowCubeInstanceVBO.Delete();
+	//GPU objects are released explicitly while the context is still alive, their destructors then have nothing left to do
+	plank.Delete();
+	cube.Delete();
+	lightCube.Delete();
+	if (model)
+		model->Delete();
+	sceneModel = nullptr;
+	materials.Delete();
+	sceneMaterials = nullptr;
+	textureStreamer.Delete();
+	TextureManager::SetStreamer(nullptr);
+	frameUBO.Delete();
+	lightUBO.Delete();
 
 	DestroyImGuiWindow();
 
@@ -624,6 +1095,11 @@ int InitGlad()
 
 void Framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+	//A minimized window reports 0 x 0, keep rendering at the last real size
+	if (width == 0 || height == 0)
+		return;
+	framebufferWidth = width;
+	framebufferHeight = height;
 	glViewport(0, 0, width, height);
 	camera.SetScreenDimensions(width, height);
 }
@@ -671,6 +1147,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 		}
 
 		cubePositions.push_back(finalPos);
+		cubeInstancesDirty = true;
 	}
 
 	if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
@@ -704,6 +1181,9 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 		// Add the new position to the deque and maintain the max capacity
 		if (pointLights.size() >= MAX_POINTLIGHTS) {
 			pointLights.pop_front();
+			//Shadow maps follow their light's index
+			if (!pointShadowMaps.empty())
+				pointShadowMaps.erase(pointShadowMaps.begin());
 		}
 
 		PointLight p;
@@ -776,83 +1256,562 @@ void ProcessInput(GLFWwindow* window)
 		camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
-void SetupLights(Shader& shader, Camera& camera)
+//Feature set of the scene shader for the current lights and settings
+ShaderDefines SceneShaderDefines()
 {
-	shader.Activate();
+	ShaderDefines defines;
+	if (PointShadowAtlas::Supported())
+		defines["POINT_SHADOWS"] = "1";
+	defines["DIR_LIGHT"] = "1";
+	if (cascadedShadows)
+		defines["DIR_LIGHT_SHADOW"] = "1";
+	defines["MATERIAL_ARRAY"] = "1";
+	if (spotLightEnabled)
+		defines["SPOT_LIGHT"] = "1";
+	if (POINT_SHADOW_QUALITY_TAPS[pointShadowQuality] > 0)
+		defines["POINT_SHADOW_TAPS"] = std::to_string(POINT_SHADOW_QUALITY_TAPS[pointShadowQuality]);
+	else if (pointShadowQuality == POINT_SHADOW_GRID_20)
+		defines["POINT_SHADOW_GRID"] = "1";
+	return defines;
+}
 
-	//ourShader.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-	shader.setFloat("material.shininess", 32.0f);
+//Rebuilds every cube's model matrix and world bounds and uploads the matrices to the instance buffer
+void UpdateCubeInstances(VBO& instanceVBO, Mesh& cube)
+{
+	//The mesh bounding box already carries cubeScale, so bounds only need position and rotation
+	BoundingBox localBounds = cube.GetMeshBoundingBox();
+	cubeInstances.resize(cubePositions.size());
+	cubeBounds.Clear();
+	cubeBounds.Reserve(cubePositions.size());
+	glm::vec3 setMin(FLT_MAX), setMax(-FLT_MAX);
+	for (size_t i = 0; i < cubePositions.size(); ++i)
+	{
+		cubeInstances[i] = Mesh::ModelMatrix(cubePositions[i], cubeRotation, cubeScale);
 
+		glm::vec3 center, extent;
+		Frustum::TransformBounds(localBounds, Mesh::ModelMatrix(cubePositions[i], cubeRotation, glm::vec3(1.0f)), center, extent);
+		cubeBounds.Add(center, extent);
+		setMin = glm::min(setMin, center - extent);
+		setMax = glm::max(setMax, center + extent);
+	}
+	//An empty set gets a negative extent, which no light reaches
+	cubeSetCenter = cubePositions.empty() ? glm::vec3(0.0f) : (setMin + setMax) * 0.5f;
+	cubeSetExtent = cubePositions.empty() ? glm::vec3(-1.0f) : (setMax - setMin) * 0.5f;
+
+	if (!cubeInstances.empty())
+		instanceVBO.Update(cubeInstances.data(), cubeInstances.size() * sizeof(glm::mat4));
+	cubeInstancesDirty = false;
+	cubeInstancesVersion++;
+}
+
+//Tests every cube against the frustum and uploads the survivors' matrices, returns how many there are
+GLsizei CullCubes(const Frustum& frustum, VBO& visibleInstanceVBO, const glm::vec3* viewPosition)
+{
+	visibleCubes.clear();
+	frustum.Cull(cubeBounds, visibleCubes);
+
+	//Nearest first, so the instances lay their depth down front to back
+	if (viewPosition != nullptr)
+	{
+		cubeDistances.resize(cubePositions.size());
+		for (uint32_t index : visibleCubes)
+		{
+			glm::vec3 offset = cubePositions[index] - *viewPosition;
+			cubeDistances[index] = glm::dot(offset, offset);
+		}
+		std::sort(visibleCubes.begin(), visibleCubes.end(), [](uint32_t a, uint32_t b) { return cubeDistances[a] < cubeDistances[b]; });
+	}
+
+	visibleCubeInstances.resize(visibleCubes.size());
+	for (size_t i = 0; i < visibleCubes.size(); ++i)
+		visibleCubeInstances[i] = cubeInstances[visibleCubes[i]];
+	if (!visibleCubeInstances.empty())
+		visibleInstanceVBO.Update(visibleCubeInstances.data(), visibleCubeInstances.size() * sizeof(glm::mat4));
+
+	cullStats.Submitted += (unsigned int)visibleCubes.size();
+	cullStats.Culled += (unsigned int)(cubeBounds.Size() - visibleCubes.size());
+	return (GLsizei)visibleCubes.size();
+}
+
+//Tests a single mesh placed at position/rotation, its bounding box already carries the scale
+bool CullMesh(const Frustum& frustum, Mesh& mesh, const glm::vec3& position, const glm::vec3& rotation)
+{
+	BoundingBox localBounds = mesh.GetMeshBoundingBox();
+	glm::vec3 center, extent;
+	Frustum::TransformBounds(localBounds, Mesh::ModelMatrix(position, rotation, glm::vec3(1.0f)), center, extent);
+
+	bool visible = frustum.IsVisible(center, extent);
+	if (visible)
+		cullStats.Submitted++;
+	else
+		cullStats.Culled++;
+	return visible;
+}
+
+//Spawns cubes at random over the scene, for testing large instance counts
+void ScatterCubes(int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		float x = ((float)rand() / RAND_MAX) * 40.0f - 20.0f;
+		float y = ((float)rand() / RAND_MAX) * 10.0f + 0.5f;
+		float z = ((float)rand() / RAND_MAX) * 40.0f - 20.0f;
+
+		if (cubePositions.size() >= MAX_CUBES)
+			cubePositions.pop_front();
+		cubePositions.push_back(glm::vec3(x, y, z));
+	}
+	cubeInstancesDirty = true;
+}
+
+//Spawns point lights of random colour in the box around center, over the whole scene by default, for testing many
+//shadowed lights. They reach about 5 units, so a scene full of them still only puts a handful in each froxel
+void ScatterLights(int count, const glm::vec3& center, const glm::vec3& extent)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		PointLight light;
+		light.linear = 1.4f;
+		light.quadratic = 7.2f;
+		glm::vec3 offset((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+		light.Position = center + (offset * 2.0f - 1.0f) * extent;
+		light.Color = glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX) * 0.5f + 0.25f;
+
+		if (pointLights.size() >= MAX_POINTLIGHTS)
+		{
+			pointLights.pop_front();
+			if (!pointShadowMaps.empty())
+				pointShadowMaps.erase(pointShadowMaps.begin());
+		}
+		pointLights.push_back(light);
+	}
+}
+
+//Replaces the cubes and point lights with one of the renderer comparison scenes, a block of cubes standing on the
+//plank with the lights scattered through it
+void LoadBenchmarkScene(BenchmarkScene scene)
+{
+	//The grid step sets how many cubes line up behind each other on screen, the cubes are 0.2 wide
+	int side = scene == BENCHMARK_OVERDRAW ? 24 : 4;
+	float step = scene == BENCHMARK_OVERDRAW ? 0.4f : 2.0f;
+	float half = (side - 1) * step * 0.5f;
+	cubePositions.clear();
+	for (int x = 0; x < side; ++x)
+		for (int y = 0; y < side; ++y)
+			for (int z = 0; z < side; ++z)
+				cubePositions.push_back(glm::vec3(x * step - half, y * step + 0.5f, z * step - half));
+	cubeInstancesDirty = true;
+
+	pointLights.clear();
+	pointShadowMaps.clear();
+	glm::vec3 extent = glm::vec3(half + step, half + 0.5f * step, half + step);
+	ScatterLights(scene == BENCHMARK_OVERDRAW ? 512 : 8, glm::vec3(0.0f, half + 0.5f, 0.0f), extent);
+}
+
+//Where the attenuation brings the brightest channel below 1/256, the radius a light is binned and cut off at.
+//Without any falloff it reaches as far as the camera sees
+float PointLightRange(const PointLight& light)
+{
+	float brightest = glm::max(light.Color.r, glm::max(light.Color.g, light.Color.b));
+	float threshold = 256.0f * brightest - light.constant;
+	if (threshold <= 0.0f)
+		return 0.0f;
+	if (light.quadratic > 0.0f)
+		return (-light.linear + glm::sqrt(light.linear * light.linear + 4.0f * light.quadratic * threshold)) / (2.0f * light.quadratic);
+	if (light.linear > 0.0f)
+		return threshold / light.linear;
+	return FAR_PLANE;
+}
+
+//How much a light's shadow matters on screen: the size of its lit sphere over its distance to the camera,
+//0 when the sphere is outside the frustum
+float PointLightImportance(const PointLight& light, const Frustum& frustum)
+{
+	//Never further than the shadow map reaches
+	float radius = glm::min(PointLightRange(light), POINT_SHADOW_FAR);
+	if (radius <= 0.0f)
+		return 0.0f;
+
+	if (!frustum.IsVisible(light.Position, glm::vec3(radius)))
+		return 0.0f;
+	float distance = glm::length(light.Position - camera.Position);
+	return radius / glm::max(distance, 1.0f);
+}
+
+void InitUniformHandles()
+{
+	for (size_t t = 0; t < POINT_SHADOW_TIERS.size(); ++t)
+	{
+		pointShadowTierUniforms.push_back(Uniform<int>("pointShadowTier" + std::to_string(t)));
+		pointShadowCompareTierUniforms.push_back(Uniform<int>("pointShadowCompareTier" + std::to_string(t)));
+	}
+
+	for (int j = 0; j < 6; ++j)
+	{
+		shadowMatrixUniforms.push_back(Uniform<glm::mat4>("shadowMatrices[" + std::to_string(j) + "]"));
+		shadowFacesUniforms.push_back(Uniform<int>("shadowFaces[" + std::to_string(j) + "]"));
+	}
+}
+
+void SetupLights(LightBlock& lights, std::vector<PointLightData>& pointLightData, Camera& camera)
+{
 	//Directional Light
-	shader.setVec3("dirLight.direction", ambientDir);
-	shader.setVec3("dirLight.ambient", 0.5f, 0.5f, 0.5f);
-	shader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-	shader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+	lights.dirLight.direction = ambientDir;
+	lights.dirLight.ambient = glm::vec3(0.5f, 0.5f, 0.5f);
+	lights.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+	lights.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
 
-	for (int i = 0; i < pointLights.size(); ++i) 
+	pointLightData.resize(pointLights.size());
+	for (size_t i = 0; i < pointLights.size(); ++i)
 	{
-		shader.setVec3("pointLights[" + std::to_string(i) + "].position", pointLights[i].Position);
-		shader.setVec3("pointLights[" + std::to_string(i) + "].ambient", 0.05f, 0.05f, 0.05f);
-		shader.setVec3("pointLights[" + std::to_string(i) + "].diffuse", pointLights[i].Color);
-		shader.setVec3("pointLights[" + std::to_string(i) + "].specular", 0.5f, 0.5f, 0.5f);
-		shader.setFloat("pointLights[" + std::to_string(i) + "].constant", pointLights[i].constant);
-		shader.setFloat("pointLights[" + std::to_string(i) + "].linear", pointLights[i].linear);
-		shader.setFloat("pointLights[" + std::to_string(i) + "].quadratic", pointLights[i].quadratic);
+		PointLightData& light = pointLightData[i];
+		light.position = pointLights[i].Position;
+		light.radius = PointLightRange(pointLights[i]);
+		light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+		light.diffuse = pointLights[i].Color;
+		light.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+		light.constant = pointLights[i].constant;
+		light.linear = pointLights[i].linear;
+		light.quadratic = pointLights[i].quadratic;
+		//Lights whose map hasn't been drawn into its slot yet go unshadowed
+		const PointShadowMap* shadowMap = i < pointShadowMaps.size() ? &pointShadowMaps[i] : nullptr;
+		light.shadow = shadowMap != nullptr && shadowMap->Slot >= 0 && shadowMap->Drawn() ? (float)(shadowMap->Tier + 4 * shadowMap->Slot) : -1.0f;
 	}
 
 	// spotLight
-	shader.setVec3("spotLight.position", camera.Position);
-	shader.setVec3("spotLight.direction", camera.Front);
-	shader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-	shader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-	shader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-	shader.setFloat("spotLight.constant", 1.0f);
-	shader.setFloat("spotLight.linear", 0.09f);
-	shader.setFloat("spotLight.quadratic", 0.032f);
-	shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-	shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+	lights.spotLight.position = camera.Position;
+	lights.spotLight.direction = camera.Front;
+	lights.spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+	lights.spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.spotLight.constant = 1.0f;
+	lights.spotLight.linear = 0.09f;
+	lights.spotLight.quadratic = 0.032f;
+	lights.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+	lights.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
 }
 
-void RenderScene(Shader& shader, Mesh plank, Mesh cube) 
+void RenderScene(Shader& shader, Shader& instancedShader, Mesh& plank, Mesh& cube, bool drawPlank, VBO& cubeInstanceVBO, GLsizei cubeCount) 
 {
 
 #pragma region Plank Draw
 
-	plank.SetMeshProperties(shader, camera, plankPosition, plankRotation, plankScale);
-	plank.Draw(shader);
+	if (drawPlank)
+	{
+		plank.SetMeshProperties(shader, plankPosition, plankRotation, plankScale);
+		plank.Draw(shader);
+	}
 
 #pragma endregion 
 
 #pragma region Instanced Cube Draw
 
-	for (int i = 0; i < cubePositions.size(); i++)
+	if (cubeCount > 0)
 	{
-		cube.SetMeshProperties(shader, camera, cubePositions[i], cubeRotation, cubeScale);
-		cube.Draw(shader);
+		cube.SetInstanceBuffer(cubeInstanceVBO);
+		cube.DrawInstanced(instancedShader, cubeCount);
 	}
 
 #pragma endregion 
 
 }
 
-void RenderLightObj(Shader& lightShader, Mesh lightCube) 
+void RenderLightObj(Shader& lightShader, Mesh& lightCube, const Frustum* frustum) 
 {
+	static const Uniform<glm::vec3> lightColorUniform("lightColor");
+
 #pragma region Light Cube draw
 	
 	for (unsigned int i = 0; i < pointLights.size(); i++)
 	{
-		glm::mat4 lightModel = glm::mat4(1.0f);
+		if (frustum != nullptr && !CullMesh(*frustum, lightCube, pointLights[i].Position, lightRotation))
+			continue;
 
 		/*pointLightPositions[i].x = radius * cos(speed * currentFrame);
 		pointLightPositions[i].y = radius * sin(speed * currentFrame);*/
-		lightCube.SetMeshProperties(lightShader, camera, pointLights[i].Position, lightRotation, lightScale);
-		lightShader.setVec3("lightColor", pointLights[i].Color);
+		lightCube.SetMeshProperties(lightShader, pointLights[i].Position, lightRotation, lightScale);
+		lightShader.setUniform(lightColorUniform, pointLights[i].Color);
 		lightCube.Draw(lightShader);
 	}
 
 #pragma endregion
 }
 
+//Where every shadow caster is now, in ShadowCasterIndex order
+void GatherShadowCasters(Mesh& plank, Mesh& lightCube, BoundingBox& modelBounds)
+{
+	shadowCasters.resize(SHADOW_CASTER_LIGHTS + pointLights.size());
+
+	ShadowCaster& plankCaster = shadowCasters[SHADOW_CASTER_PLANK];
+	BoundingBox plankBounds = plank.GetMeshBoundingBox();
+	Frustum::TransformBounds(plankBounds, Mesh::ModelMatrix(plankPosition, plankRotation, glm::vec3(1.0f)), plankCaster.center, plankCaster.extent);
+	plankCaster.transform = Mesh::ModelMatrix(plankPosition, plankRotation, plankScale);
+	plankCaster.version = 0;
+	plankCaster.dynamic = false;
+
+	ShadowCaster& cubeCaster = shadowCasters[SHADOW_CASTER_CUBES];
+	cubeCaster.center = cubeSetCenter;
+	cubeCaster.extent = cubeSetExtent;
+	cubeCaster.transform = Mesh::ModelMatrix(glm::vec3(0.0f), cubeRotation, cubeScale);
+	cubeCaster.version = cubeInstancesVersion;
+	cubeCaster.dynamic = true;
+
+	ShadowCaster& modelCaster = shadowCasters[SHADOW_CASTER_MODEL];
+	modelCaster.transform = Mesh::ModelMatrix(modelPosition, modelRotation, modelScale);
+	modelCaster.version = sceneModel != nullptr ? sceneModel->Lod : 0;
+	modelCaster.dynamic = false;
+	if (sceneModel != nullptr)
+		Frustum::TransformBounds(modelBounds, modelCaster.transform, modelCaster.center, modelCaster.extent);
+	else
+	{
+		modelCaster.center = glm::vec3(0.0f);
+		modelCaster.extent = glm::vec3(-1.0f);
+	}
+
+	BoundingBox lightBounds = lightCube.GetMeshBoundingBox();
+	for (size_t i = 0; i < pointLights.size(); ++i)
+	{
+		ShadowCaster& lightCaster = shadowCasters[SHADOW_CASTER_LIGHTS + i];
+		Frustum::TransformBounds(lightBounds, Mesh::ModelMatrix(pointLights[i].Position, lightRotation, glm::vec3(1.0f)), lightCaster.center, lightCaster.extent);
+		lightCaster.transform = Mesh::ModelMatrix(pointLights[i].Position, lightRotation, lightScale);
+		lightCaster.version = 0;
+		lightCaster.dynamic = false;
+	}
+}
+
+//Sorts the cubes by the faces of the light they land on, each face's matrices one run of faceInstanceVBO
+void CullShadowCubes(const CubeFrustum& faces, VBO& faceInstanceVBO, ShadowDraw& draw)
+{
+	shadowFaceCubeInstances.clear();
+	for (std::vector<uint32_t>& visible : shadowFaceCubes)
+		visible.clear();
+	//Most lights see none of the cubes, the box around all of them says so without testing each
+	const ShadowCaster& cubeCaster = shadowCasters[SHADOW_CASTER_CUBES];
+	if (cubeCaster.extent.x >= 0.0f && faces.FaceMask(cubeCaster.center, cubeCaster.extent) != 0)
+		faces.Cull(cubeBounds, shadowFaceCubes);
+
+	for (int face = 0; face < 6; ++face)
+	{
+		draw.cubeOffsets[face] = (GLintptr)(shadowFaceCubeInstances.size() * sizeof(glm::mat4));
+		draw.cubeCounts[face] = (GLsizei)shadowFaceCubes[face].size();
+		for (uint32_t index : shadowFaceCubes[face])
+			shadowFaceCubeInstances.push_back(cubeInstances[index]);
+	}
+	if (!shadowFaceCubeInstances.empty())
+		faceInstanceVBO.Update(shadowFaceCubeInstances.data(), shadowFaceCubeInstances.size() * sizeof(glm::mat4));
+}
+
+//Draws the casters of one shadow map layer with the point depth programs of draw's path, set up for the light.
+//Unless the map splits its layers everything is in the static one
+void RenderShadowCasters(const ShadowDraw& draw, Mesh& plank, Mesh& cube, Mesh& lightCube, Model* model, bool dynamicLayer)
+{
+	static const Uniform<glm::mat4> modelUniform("model");
+	static const Uniform<int> shadowFaceUniform("shadowFace");
+	auto inLayer = [dynamicLayer](ShadowCasterIndex caster) { return (pointShadowSplit && shadowCasters[caster].dynamic) == dynamicLayer; };
+	Shader& shader = *draw.shader;
+	Shader& instancedShader = *draw.instancedShader;
+
+	if (draw.path == POINT_SHADOW_GEOMETRY_SHADER)
+	{
+		RenderScene(shader, instancedShader, plank, cube, inLayer(SHADOW_CASTER_PLANK), *draw.cubeInstances,
+			inLayer(SHADOW_CASTER_CUBES) ? (GLsizei)cubePositions.size() : 0);
+		if (inLayer(SHADOW_CASTER_LIGHTS))
+			RenderLightObj(shader, lightCube);
+		if (model && inLayer(SHADOW_CASTER_MODEL))
+			model->Draw(shader, Mesh::ModelMatrix(modelPosition, modelRotation, modelScale));
+		return;
+	}
+
+	//Every mesh of the layer with the faces it lands on, the ones landing on none are dropped here
+	shadowFaceCasters.clear();
+	auto addCaster = [&draw](Mesh& mesh, const glm::mat4& transform, const glm::vec3& center, const glm::vec3& extent)
+	{
+		unsigned int faceMask = draw.faces->FaceMask(center, extent);
+		unsigned int faceCount = 0;
+		for (int face = 0; face < 6; ++face)
+			faceCount += (faceMask >> face) & 1u;
+		shadowStats.FaceDraws += faceCount;
+		shadowStats.FacesCulled += 6 - faceCount;
+		if (faceMask != 0)
+			shadowFaceCasters.push_back({ &mesh, transform, faceMask });
+	};
+	if (inLayer(SHADOW_CASTER_PLANK))
+	{
+		const ShadowCaster& caster = shadowCasters[SHADOW_CASTER_PLANK];
+		addCaster(plank, caster.transform, caster.center, caster.extent);
+	}
+	if (inLayer(SHADOW_CASTER_LIGHTS))
+	{
+		for (size_t i = 0; i < pointLights.size(); ++i)
+		{
+			const ShadowCaster& caster = shadowCasters[SHADOW_CASTER_LIGHTS + i];
+			addCaster(lightCube, caster.transform, caster.center, caster.extent);
+		}
+	}
+	if (model && inLayer(SHADOW_CASTER_MODEL))
+	{
+		const glm::mat4& transform = shadowCasters[SHADOW_CASTER_MODEL].transform;
+		for (Mesh& mesh : model->meshes)
+		{
+			BoundingBox bounds = mesh.GetMeshBoundingBox();
+			glm::vec3 center, extent;
+			Frustum::TransformBounds(bounds, transform, center, extent);
+			mesh.SetLod(model->Lod);
+			addCaster(mesh, transform, center, extent);
+		}
+	}
+	bool drawCubes = inLayer(SHADOW_CASTER_CUBES);
+	if (drawCubes)
+	{
+		for (int face = 0; face < 6; ++face)
+		{
+			shadowStats.FaceDraws += (unsigned int)draw.cubeCounts[face];
+			shadowStats.FacesCulled += (unsigned int)(cubeBounds.Size() - draw.cubeCounts[face]);
+		}
+	}
+
+	if (draw.path == POINT_SHADOW_VERTEX_LAYER)
+	{
+		//A mesh goes out once with an instance per face it lands on, the vertex shader sends each instance to its layer
+		for (const ShadowFaceCaster& caster : shadowFaceCasters)
+		{
+			shader.Activate();
+			shader.setUniform(modelUniform, caster.transform);
+			GLsizei faceCount = 0;
+			for (int face = 0; face < 6; ++face)
+			{
+				if (caster.faceMask & (1u << face))
+					shader.setUniform(shadowFacesUniforms[faceCount++], face);
+			}
+			caster.mesh->DrawInstanced(shader, faceCount);
+		}
+		//The cubes are already instanced, so one draw per face with the face's run of the instance buffer
+		for (int face = 0; face < 6 && drawCubes; ++face)
+		{
+			if (draw.cubeCounts[face] == 0)
+				continue;
+			instancedShader.Activate();
+			instancedShader.setUniform(shadowFaceUniform, face);
+			cube.SetInstanceBuffer(*draw.cubeInstances, 4, draw.cubeOffsets[face]);
+			cube.DrawInstanced(instancedShader, draw.cubeCounts[face]);
+		}
+		return;
+	}
+
+	//Without gl_Layer in the vertex shader the faces are attached and drawn one after another
+	for (int face = 0; face < 6; ++face)
+	{
+		pointShadowAtlas->BindFace(*draw.map, face, draw.split && !dynamicLayer);
+		shader.Activate();
+		shader.setUniform(shadowFaceUniform, face);
+		for (const ShadowFaceCaster& caster : shadowFaceCasters)
+		{
+			if ((caster.faceMask & (1u << face)) == 0)
+				continue;
+			shader.setUniform(modelUniform, caster.transform);
+			caster.mesh->Draw(shader);
+		}
+		if (drawCubes && draw.cubeCounts[face] > 0)
+		{
+			instancedShader.Activate();
+			instancedShader.setUniform(shadowFaceUniform, face);
+			cube.SetInstanceBuffer(*draw.cubeInstances, 4, draw.cubeOffsets[face]);
+			cube.DrawInstanced(instancedShader, draw.cubeCounts[face]);
+		}
+	}
+}
+
+//Draws the directional shadow casters that land in one cascade, the cubes through the cascade's own instance buffer
+void RenderCascadeCasters(Shader& shader, Shader& instancedShader, Mesh& plank, Mesh& cube, VBO& cubeInstanceVBO, Model* model,
+	const Frustum& frustum, CullStats& stats)
+{
+	static const Uniform<glm::mat4> modelUniform("model");
+	auto inCascade = [&frustum, &stats](const glm::vec3& center, const glm::vec3& extent)
+	{
+		bool visible = extent.x >= 0.0f && frustum.IsVisible(center, extent);
+		if (visible)
+			stats.Submitted++;
+		else
+			stats.Culled++;
+		return visible;
+	};
+
+	shader.Activate();
+	const ShadowCaster& plankCaster = shadowCasters[SHADOW_CASTER_PLANK];
+	if (inCascade(plankCaster.center, plankCaster.extent))
+	{
+		shader.setUniform(modelUniform, plankCaster.transform);
+		plank.Draw(shader);
+	}
+	if (model)
+	{
+		unsigned int drawn = model->Draw(shader, shadowCasters[SHADOW_CASTER_MODEL].transform, &frustum);
+		stats.Submitted += drawn;
+		stats.Culled += (unsigned int)model->meshes.size() - drawn;
+	}
+
+	visibleCubes.clear();
+	frustum.Cull(cubeBounds, visibleCubes);
+	stats.Submitted += (unsigned int)visibleCubes.size();
+	stats.Culled += (unsigned int)(cubeBounds.Size() - visibleCubes.size());
+	if (visibleCubes.empty())
+		return;
+	visibleCubeInstances.resize(visibleCubes.size());
+	for (size_t i = 0; i < visibleCubes.size(); ++i)
+		visibleCubeInstances[i] = cubeInstances[visibleCubes[i]];
+	cubeInstanceVBO.Update(visibleCubeInstances.data(), visibleCubeInstances.size() * sizeof(glm::mat4));
+	cube.SetInstanceBuffer(cubeInstanceVBO);
+	cube.DrawInstanced(instancedShader, (GLsizei)visibleCubes.size());
+}
+
+//Queues what RenderScene and the model draw for pass, material off for the depth only programs. The queue sorts
+//depth only draws nearest first, the cubes within their draw come sorted from CullCubes. Returns the model meshes queued
+unsigned int SubmitScene(RenderQueue& queue, RenderPass pass, Shader& shader, Shader& instancedShader, Mesh& plank, Mesh& cube, bool drawPlank,
+	VBO& cubeInstanceVBO, GLsizei cubeCount, Model* model, const Frustum& frustum, bool material)
+{
+	if (drawPlank)
+	{
+		DrawItem item;
+		item.shader = &shader;
+		item.mesh = &plank;
+		item.model = Mesh::ModelMatrix(plankPosition, plankRotation, plankScale);
+		item.material = material;
+		queue.Submit(pass, item, shadowCasters[SHADOW_CASTER_PLANK].center);
+	}
+	if (cubeCount > 0)
+	{
+		DrawItem item;
+		item.shader = &instancedShader;
+		item.mesh = &cube;
+		item.instances = &cubeInstanceVBO;
+		item.instanceCount = cubeCount;
+		item.material = material;
+		queue.Submit(pass, item, cubeSetCenter);
+	}
+	if (model == nullptr)
+		return 0;
+	return model->Submit(queue, pass, shader, Mesh::ModelMatrix(modelPosition, modelRotation, modelScale), &frustum, material);
+}
+
+//Queues the light cubes inside frustum, each in its light's colour
+void SubmitLightObj(RenderQueue& queue, Shader& lightShader, Mesh& lightCube, const Frustum& frustum)
+{
+	static const Uniform<glm::vec3> lightColorUniform("lightColor");
+
+	DrawItem item;
+	item.shader = &lightShader;
+	item.mesh = &lightCube;
+	item.colorUniform = lightColorUniform;
+	for (const PointLight& light : pointLights)
+	{
+		if (!CullMesh(frustum, lightCube, light.Position, lightRotation))
+			continue;
+		item.model = Mesh::ModelMatrix(light.Position, lightRotation, lightScale);
+		item.color = light.Color;
+		queue.Submit(RENDER_PASS_UNLIT, item, light.Position);
+	}
+}
+
 #pragma region ImGUI
 void InitImGui(GLFWwindow* window)
 {
@@ -880,21 +1839,193 @@ void DrawImGuiWindow()
 	ImGui::DragFloat3("Ambient light Dir", &ambientDir[0], 0.1f);
 	ImGui::DragFloat3("Ambient light Pos", &lightPos[0], 0.1f);
 
-	for (int i = 0; i < pointLights.size(); ++i) 
+	if (ImGui::CollapsingHeader("Point Lights"))
 	{
-		std::string label = "Point Light " + std::to_string(i + 1);	
+		ImGui::Text("Lights: %d / %d", (int)pointLights.size(), MAX_POINTLIGHTS);
+		if (lightClusters != nullptr)
+		{
+			unsigned int clusterCount = LightClusters::CLUSTER_COUNT;
+			ImGui::Text("Froxels: %u x %u x %u", LightClusters::GRID_X, LightClusters::GRID_Y, LightClusters::GRID_Z);
+			ImGui::Text("References: %u  Average: %.2f  Longest: %u", lightClusters->References,
+				(float)lightClusters->References / clusterCount, lightClusters->LongestList);
+			if (lightClusters->Dropped > 0)
+				ImGui::Text("Dropped: %u", lightClusters->Dropped);
+			ImGui::Text("Binning wait: %.3f ms", lightClusters->BinMilliseconds);
+		}
+		if (ImGui::Button("Scatter 1024 Lights"))
+			ScatterLights(1024);
+		ImGui::SameLine();
+		if (ImGui::Button("Clear Lights"))
+		{
+			pointLights.clear();
+			pointShadowMaps.clear();
+		}
 
-		if (ImGui::CollapsingHeader(label.c_str())) 
+		for (int i = 0; i < pointLights.size(); ++i) 
 		{
-			PointLight& light = pointLights[i];
-			ImGui::PushID(i);
-			ImGui::SliderFloat3("Position", &light.Position.x, -10, 10);
-			ImGui::SliderFloat("Constant", &light.constant, 0, 2);
-			ImGui::SliderFloat("Linear", &light.linear, 0, 2);
-			ImGui::SliderFloat("Quadratic", &light.quadratic, 0, 2);
-			ImGui::ColorEdit3("Color", &light.Color.x);
-			ImGui::PopID();
-		}		
+			std::string label = "Point Light " + std::to_string(i + 1);	
+
+			if (ImGui::TreeNode(label.c_str())) 
+			{
+				PointLight& light = pointLights[i];
+				ImGui::SliderFloat3("Position", &light.Position.x, -10, 10);
+				ImGui::SliderFloat("Constant", &light.constant, 0, 2);
+				ImGui::SliderFloat("Linear", &light.linear, 0, 2);
+				ImGui::SliderFloat("Quadratic", &light.quadratic, 0, 2);
+				ImGui::ColorEdit3("Color", &light.Color.x);
+				ImGui::TreePop();
+			}		
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Renderer"))
+	{
+		ImGui::RadioButton("Forward", &rendererMode, RENDERER_FORWARD);
+		ImGui::SameLine();
+		ImGui::RadioButton("Deferred", &rendererMode, RENDERER_DEFERRED);
+		ImGui::Checkbox("Depth Pre-pass", &depthPrepass);
+		//Samples per pixel of the window, 1 when every pixel is covered and shaded once
+		double pixels = (double)framebufferWidth * framebufferHeight;
+		if (depthPrepass && depthPrepassQuery != nullptr)
+			ImGui::Text("Pre-pass: %.3f ms, %.2f samples per pixel", depthPrepassQuery->Milliseconds, depthPrepassQuery->Samples / pixels);
+		if (scenePassQuery != nullptr)
+			ImGui::Text("Scene pass: %.3f ms, %.2f samples shaded per pixel", scenePassQuery->Milliseconds, scenePassQuery->Samples / pixels);
+		if (rendererMode == RENDERER_DEFERRED && lightingPassQuery != nullptr)
+			ImGui::Text("Lighting pass: %.3f ms", lightingPassQuery->Milliseconds);
+		if (sceneGBuffer != nullptr)
+			ImGui::Text("G-buffer: %d x %d, %.2f MB", sceneGBuffer->Width, sceneGBuffer->Height, sceneGBuffer->ResidentBytes() / (1024.0 * 1024.0));
+		if (ImGui::Button("Overdraw Scene"))
+			LoadBenchmarkScene(BENCHMARK_OVERDRAW);
+		ImGui::SameLine();
+		if (ImGui::Button("Sparse Scene"))
+			LoadBenchmarkScene(BENCHMARK_SPARSE);
+	}
+
+	if (ImGui::CollapsingHeader("Shading"))
+	{
+		ImGui::Checkbox("Spot Light", &spotLightEnabled);
+		ImGui::Combo("Point Shadow Filter", &pointShadowQuality, POINT_SHADOW_QUALITY_NAMES, IM_ARRAYSIZE(POINT_SHADOW_QUALITY_NAMES));
+	}
+
+	if (ImGui::CollapsingHeader("Shadows"))
+	{
+		ImGui::Checkbox("Cache Point Shadows", &pointShadowCaching);
+		ImGui::Checkbox("Cubes In Per-Frame Layer", &pointShadowSplit);
+		ImGui::SliderFloat("Update Budget (1024 cubes)", &pointShadowBudget, 0.25f, 16.0f);
+		ImGui::Text("Redrawn: %u  Composited: %u  Cached: %u  Deferred: %u", shadowStats.Redrawn, shadowStats.Composited,
+			shadowStats.Cached, shadowStats.Deferred);
+		ImGui::RadioButton("Geometry Shader", &pointShadowPath, POINT_SHADOW_GEOMETRY_SHADER);
+		if (GLAD_GL_ARB_shader_viewport_layer_array)
+		{
+			ImGui::SameLine();
+			ImGui::RadioButton("Vertex Layer", &pointShadowPath, POINT_SHADOW_VERTEX_LAYER);
+		}
+		ImGui::SameLine();
+		ImGui::RadioButton("Six Passes", &pointShadowPath, POINT_SHADOW_SIX_PASSES);
+		if (pointShadowPath != POINT_SHADOW_GEOMETRY_SHADER)
+			ImGui::Text("Caster faces drawn: %u  culled: %u", shadowStats.FaceDraws, shadowStats.FacesCulled);
+		if (pointShadowQuery != nullptr)
+		{
+			//Triangles leaving the vertex stages, which the geometry shader path counts six times over
+			ImGui::Text("Pass: %.3f ms, %llu triangles", pointShadowQuery->Milliseconds, (unsigned long long)pointShadowQuery->Primitives);
+			if (pointShadowQuery->Milliseconds > 0.0)
+				ImGui::Text("%.1f M triangles/s", pointShadowQuery->Primitives / (pointShadowQuery->Milliseconds * 1000.0));
+		}
+		if (pointShadowAtlas != nullptr)
+		{
+			for (unsigned int t = 0; t < pointShadowAtlas->TierCount(); ++t)
+			{
+				unsigned int assigned = 0;
+				for (const PointShadowMap& shadowMap : pointShadowMaps)
+					assigned += shadowMap.Tier == (int)t ? 1 : 0;
+				ImGui::Text("%d px: %u / %u", pointShadowAtlas->Tier(t).size, assigned, pointShadowAtlas->Tier(t).slots);
+			}
+			ImGui::Text("Atlas: %.2f MB", pointShadowAtlas->ResidentBytes() / (1024.0 * 1024.0));
+		}
+		if (ImGui::Button("Scatter 64 Lights"))
+			ScatterLights(64);
+	}
+
+	if (ImGui::CollapsingHeader("Sun Shadows"))
+	{
+		ImGui::Checkbox("Cascaded Shadows", &cascadedShadows);
+		ImGui::SliderInt("Cascades", &shadowCascadeCount, 2, (int)MAX_SHADOW_CASCADES);
+		ImGui::SliderFloat("Shadow Distance", &shadowCascadeDistance, 10.0f, FAR_PLANE);
+		ImGui::SliderFloat("Split Lambda", &shadowCascadeLambda, 0.0f, 1.0f);
+		for (int c = 0; c < shadowCascadeCount && cascadedShadows; ++c)
+		{
+			ImGui::Text("Cascade %d: drawn %u  culled %u", c, cascadeCullStats[c].Submitted, cascadeCullStats[c].Culled);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Culling"))
+	{
+		ImGui::Text("Submitted: %u", cullStats.Submitted);
+		ImGui::Text("Culled: %u", cullStats.Culled);
+	}
+
+	if (sceneRenderQueue != nullptr && ImGui::CollapsingHeader("Render Queue"))
+	{
+		//Submission order through Mesh::Draw against sort key order with redundant binds skipped
+		const RenderQueueStats& before = sceneRenderQueue->Immediate;
+		const RenderQueueStats& after = sceneRenderQueue->Sorted;
+		ImGui::Text("Draws: %u", after.Draws);
+		ImGui::Text("Program switches: %u -> %u", before.Programs, after.Programs);
+		ImGui::Text("Texture binds: %u -> %u", before.Textures, after.Textures);
+		ImGui::Text("Vertex array binds: %u -> %u", before.VertexArrays, after.VertexArrays);
+	}
+
+	if (ImGui::CollapsingHeader("Textures"))
+	{
+		//Scene maps all live in the material arrays, standalone textures only show up when something loads one
+		if (TextureManager::Count() > 0)
+		{
+			ImGui::Text("Loaded: %u", TextureManager::Count());
+			ImGui::Text("Hits: %u  Misses: %u", TextureManager::Hits, TextureManager::Misses);
+			ImGui::Text("Resident: %.2f MB", TextureManager::ResidentBytes() / (1024.0 * 1024.0));
+		}
+		ImGui::Text("Files: %u from the archive, %u loose", VirtualFileSystem::ArchiveReads.load(), VirtualFileSystem::LooseReads.load());
+		if (sceneMaterials != nullptr)
+		{
+			ImGui::Text("Materials: %u in %u arrays, %.2f MB", sceneMaterials->Count(), sceneMaterials->ArrayCount(),
+				sceneMaterials->ResidentBytes() / (1024.0 * 1024.0));
+			ImGui::Text("Hits: %u  Misses: %u", sceneMaterials->Hits, sceneMaterials->Misses);
+			ImGui::Text("Streaming: %u materials", sceneMaterials->Streaming());
+			ImGui::Text("Array binds: %u", sceneMaterials->Binds);
+		}
+		if (TextureStreamer* streamer = TextureManager::Streamer())
+			ImGui::Text("Uploads: %u pending, %.2f MB last frame", streamer->Pending(), streamer->UploadedLastFrame / (1024.0 * 1024.0));
+	}
+
+	if (sceneModel != nullptr && ImGui::CollapsingHeader("Model"))
+	{
+		const ModelImportStats& stats = sceneModel->Stats;
+		ImGui::Text("Meshes: %u  Materials: %u", stats.meshes, stats.materials);
+		ImGui::Text("Vertices: %u  Triangles: %u", stats.vertices, stats.triangles);
+		if (stats.fromCache)
+			ImGui::Text("Mapped %.2f MB cache in %.1f ms, upload %.1f ms", stats.fileBytes / (1024.0 * 1024.0), stats.readMs, stats.uploadMs);
+		else
+			ImGui::Text("Read %.1f ms, process %.1f ms, upload %.1f ms", stats.readMs, stats.processMs, stats.uploadMs);
+		ImGui::Text("Scene: %.2f MB  Peak: %.2f MB", stats.sceneBytes / (1024.0 * 1024.0), stats.peakBytesAfter / (1024.0 * 1024.0));
+		int lod = (int)sceneModel->Lod;
+		if (ImGui::SliderInt("LOD", &lod, 0, MESH_FILE_MAX_LODS - 1))
+			sceneModel->Lod = (unsigned int)lod;
+		ImGui::DragFloat3("Position", &modelPosition.x, 0.1f);
+		ImGui::DragFloat3("Rotation", &modelRotation.x, 1.0f);
+		ImGui::DragFloat3("Scale", &modelScale.x, 0.001f);
+	}
+
+	if (ImGui::CollapsingHeader("Cubes"))
+	{
+		ImGui::Text("Instances: %d / %d", (int)cubePositions.size(), MAX_CUBES);
+		if (ImGui::Button("Scatter 10000 Cubes"))
+			ScatterCubes(10000);
+		ImGui::SameLine();
+		if (ImGui::Button("Clear"))
+		{
+			cubePositions.clear();
+			cubeInstancesDirty = true;
+		}
 	}
 
 	ImGui::End();
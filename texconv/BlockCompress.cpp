@@ -0,0 +1,393 @@
+#include "BlockCompress.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Mean and direction of largest variance of the 16 texels over the first channels components.
+	// Endpoints placed on that line fit a block far better than its per channel min and max
+	void principalAxis(const uint8_t texels[64], int channels, float mean[4], float axis[4])
+	{
+		for (int c = 0; c < 4; ++c)
+			mean[c] = axis[c] = 0.0f;
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < channels; ++c)
+				mean[c] += texels[i * 4 + c] / 16.0f;
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+			for (int a = 0; a < channels; ++a)
+				for (int b = 0; b < channels; ++b)
+					covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+
+		// power iteration, a handful of steps is plenty for 16 points
+		for (int c = 0; c < channels; ++c)
+			axis[c] = 1.0f;
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			for (int a = 0; a < channels; ++a)
+				for (int b = 0; b < channels; ++b)
+					next[a] += covariance[a][b] * axis[b];
+			float length = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				length = std::max(length, std::fabs(next[c]));
+			if (length == 0.0f)
+				return;
+			for (int c = 0; c < channels; ++c)
+				axis[c] = next[c] / length;
+		}
+	}
+
+	// The two ends of the texels' extent along the principal axis
+	void lineEndpoints(const uint8_t texels[64], int channels, float first[4], float second[4])
+	{
+		float mean[4], axis[4];
+		principalAxis(texels, channels, mean, axis);
+
+		float lowest = 0.0f, highest = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				t += (texels[i * 4 + c] - mean[c]) * axis[c];
+			lowest = std::min(lowest, t);
+			highest = std::max(highest, t);
+		}
+		float length = 0.0f;
+		for (int c = 0; c < channels; ++c)
+			length += axis[c] * axis[c];
+		if (length > 0.0f)
+		{
+			lowest /= length;
+			highest /= length;
+		}
+		for (int c = 0; c < channels; ++c)
+		{
+			first[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * highest));
+			second[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * lowest));
+		}
+	}
+
+	uint16_t pack565(const float colour[3])
+	{
+		int r = (int)std::lround(colour[0] * 31.0f / 255.0f);
+		int g = (int)std::lround(colour[1] * 63.0f / 255.0f);
+		int b = (int)std::lround(colour[2] * 31.0f / 255.0f);
+		return (uint16_t)((std::min(r, 31) << 11) | (std::min(g, 63) << 5) | std::min(b, 31));
+	}
+
+	void unpack565(uint16_t packed, int colour[3])
+	{
+		int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+		colour[0] = (r << 3) | (r >> 2);
+		colour[1] = (g << 2) | (g >> 4);
+		colour[2] = (b << 3) | (b >> 2);
+	}
+
+	// Picks the nearest of the four palette colours per texel, returns the summed squared error
+	int bc1Indices(const uint8_t texels[64], uint16_t colour0, uint16_t colour1, uint32_t& indices)
+	{
+		int palette[4][3];
+		unpack565(colour0, palette[0]);
+		unpack565(colour1, palette[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		int error = 0;
+		indices = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 0, bestError = INT32_MAX;
+			for (int p = 0; p < 4; ++p)
+			{
+				int d = 0;
+				for (int c = 0; c < 3; ++c)
+				{
+					int diff = texels[i * 4 + c] - palette[p][c];
+					d += diff * diff;
+				}
+				if (d < bestError)
+				{
+					bestError = d;
+					best = p;
+				}
+			}
+			indices |= (uint32_t)best << (i * 2);
+			error += bestError;
+		}
+		return error;
+	}
+
+	// Least squares endpoints for a fixed set of indices
+	bool refitBC1(const uint8_t texels[64], uint32_t indices, float first[3], float second[3])
+	{
+		static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[3] = {}, bx[3] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			float a = weights[(indices >> (i * 2)) & 3];
+			float b = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < 3; ++c)
+			{
+				ax[c] += a * texels[i * 4 + c];
+				bx[c] += b * texels[i * 4 + c];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+			return false;
+		for (int c = 0; c < 3; ++c)
+		{
+			first[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / determinant));
+			second[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / determinant));
+		}
+		return true;
+	}
+
+	void writeBC1(uint16_t colour0, uint16_t colour1, uint32_t indices, uint8_t block[8])
+	{
+		block[0] = colour0 & 0xFF;
+		block[1] = colour0 >> 8;
+		block[2] = colour1 & 0xFF;
+		block[3] = colour1 >> 8;
+		for (int i = 0; i < 4; ++i)
+			block[4 + i] = (indices >> (i * 8)) & 0xFF;
+	}
+
+	// Endpoint pair in the order the four colour mode needs, colour0 > colour1
+	void orderedEndpoints(const float first[3], const float second[3], uint16_t& colour0, uint16_t& colour1)
+	{
+		colour0 = pack565(first);
+		colour1 = pack565(second);
+		if (colour0 < colour1)
+			std::swap(colour0, colour1);
+	}
+
+	struct BitWriter
+	{
+		uint8_t* out;
+		int position = 0;
+
+		void Put(uint32_t value, int bits)
+		{
+			for (int i = 0; i < bits; ++i, ++position)
+				if ((value >> i) & 1)
+					out[position >> 3] |= (uint8_t)(1 << (position & 7));
+		}
+	};
+}
+
+void BlockCompress::EncodeBC1(const uint8_t texels[64], uint8_t block[8])
+{
+	float first[4], second[4];
+	lineEndpoints(texels, 3, first, second);
+
+	uint16_t colour0, colour1;
+	orderedEndpoints(first, second, colour0, colour1);
+	if (colour0 == colour1)
+	{
+		// a flat block, every texel is colour0
+		writeBC1(colour0, colour1, 0, block);
+		return;
+	}
+	uint32_t indices;
+	int error = bc1Indices(texels, colour0, colour1, indices);
+
+	// the range fit leaves the endpoints at the extremes, a refit pulls them toward the texels
+	if (refitBC1(texels, indices, first, second))
+	{
+		uint16_t refit0, refit1;
+		orderedEndpoints(first, second, refit0, refit1);
+		uint32_t refitIndices;
+		if (refit0 != refit1)
+		{
+			int refitError = bc1Indices(texels, refit0, refit1, refitIndices);
+			if (refitError < error)
+			{
+				colour0 = refit0;
+				colour1 = refit1;
+				indices = refitIndices;
+			}
+		}
+	}
+	writeBC1(colour0, colour1, indices, block);
+}
+
+void BlockCompress::EncodeBC4(const uint8_t texels[64], int channel, uint8_t block[8])
+{
+	int lowest = 255, highest = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		lowest = std::min(lowest, (int)texels[i * 4 + channel]);
+		highest = std::max(highest, (int)texels[i * 4 + channel]);
+	}
+	memset(block, 0, 8);
+	block[0] = (uint8_t)highest;
+	block[1] = (uint8_t)lowest;
+	if (highest == lowest)
+		return;
+
+	// red0 > red1 selects eight values: the endpoints and six evenly spaced between them
+	int palette[8] = { highest, lowest };
+	for (int p = 2; p < 8; ++p)
+		palette[p] = ((8 - p) * highest + (p - 1) * lowest) / 7;
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int value = texels[i * 4 + channel];
+		int best = 0;
+		for (int p = 1; p < 8; ++p)
+			if (std::abs(value - palette[p]) < std::abs(value - palette[best]))
+				best = p;
+		indices |= (uint64_t)best << (i * 3);
+	}
+	for (int i = 0; i < 6; ++i)
+		block[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+void BlockCompress::EncodeBC3(const uint8_t texels[64], uint8_t block[16])
+{
+	EncodeBC4(texels, 3, block);
+	EncodeBC1(texels, block + 8);
+}
+
+void BlockCompress::EncodeBC5(const uint8_t texels[64], uint8_t block[16])
+{
+	EncodeBC4(texels, 0, block);
+	EncodeBC4(texels, 1, block + 8);
+}
+
+void BlockCompress::EncodeBC7(const uint8_t texels[64], uint8_t block[16])
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float ends[2][4];
+	lineEndpoints(texels, 4, ends[0], ends[1]);
+
+	// 7 bit endpoints plus a shared low bit each, pick the low bit that lands closest
+	int quantized[2][4];
+	int pbits[2];
+	int colours[2][4];
+	for (int e = 0; e < 2; ++e)
+	{
+		float bestError = 1e30f;
+		for (int p = 0; p < 2; ++p)
+		{
+			int q[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				q[c] = std::min(127, std::max(0, (int)std::lround((ends[e][c] - p) / 2.0f)));
+				float diff = (float)((q[c] << 1) | p) - ends[e][c];
+				error += diff * diff;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pbits[e] = p;
+				for (int c = 0; c < 4; ++c)
+				{
+					quantized[e][c] = q[c];
+					colours[e][c] = (q[c] << 1) | p;
+				}
+			}
+		}
+	}
+
+	int palette[16][4];
+	for (int k = 0; k < 16; ++k)
+		for (int c = 0; c < 4; ++c)
+			palette[k][c] = ((64 - weights[k]) * colours[0][c] + weights[k] * colours[1][c] + 32) >> 6;
+
+	int indices[16];
+	for (int i = 0; i < 16; ++i)
+	{
+		int best = 0, bestError = INT32_MAX;
+		for (int k = 0; k < 16; ++k)
+		{
+			int d = 0;
+			for (int c = 0; c < 4; ++c)
+			{
+				int diff = texels[i * 4 + c] - palette[k][c];
+				d += diff * diff;
+			}
+			if (d < bestError)
+			{
+				bestError = d;
+				best = k;
+			}
+		}
+		indices[i] = best;
+	}
+
+	// the first index is stored without its top bit, so it has to be in the lower half
+	if (indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; ++c)
+			std::swap(quantized[0][c], quantized[1][c]);
+		std::swap(pbits[0], pbits[1]);
+		for (int i = 0; i < 16; ++i)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(block, 0, 16);
+	BitWriter bits{ block };
+	bits.Put(1 << 6, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		bits.Put(quantized[0][c], 7);
+		bits.Put(quantized[1][c], 7);
+	}
+	bits.Put(pbits[0], 1);
+	bits.Put(pbits[1], 1);
+	bits.Put(indices[0], 3);
+	for (int i = 1; i < 16; ++i)
+		bits.Put(indices[i], 4);
+}
+
+std::vector<uint8_t> BlockCompress::EncodeImage(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	size_t blockBytes = DDSImage::BlockBytes(format);
+	std::vector<uint8_t> blocks(blocksX * blocksY * blockBytes);
+
+	uint8_t texels[64];
+	for (uint32_t by = 0; by < blocksY; ++by)
+	{
+		for (uint32_t bx = 0; bx < blocksX; ++bx)
+		{
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				uint32_t row = std::min(by * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; ++x)
+				{
+					uint32_t column = std::min(bx * 4 + x, width - 1);
+					memcpy(&texels[(y * 4 + x) * 4], &rgba[((size_t)row * width + column) * 4], 4);
+				}
+			}
+
+			uint8_t* block = &blocks[(by * blocksX + bx) * blockBytes];
+			switch (format)
+			{
+				case BlockFormat::BC1: EncodeBC1(texels, block); break;
+				case BlockFormat::BC3: EncodeBC3(texels, block); break;
+				case BlockFormat::BC4: EncodeBC4(texels, 0, block); break;
+				case BlockFormat::BC5: EncodeBC5(texels, block); break;
+				case BlockFormat::BC7: EncodeBC7(texels, block); break;
+			}
+		}
+	}
+	return blocks;
+}
@@ -0,0 +1,26 @@
+#ifndef BLOCK_COMPRESS_CLASS_H
+#define BLOCK_COMPRESS_CLASS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "DDSFile.h"
+
+// Encoders for single 4x4 blocks. texels holds 16 RGBA8 texels, row by row
+namespace BlockCompress
+{
+	// 8 bytes, always the four colour mode so the block is also valid as the colour half of BC3
+	void EncodeBC1(const uint8_t texels[64], uint8_t block[8]);
+	// 16 bytes, BC4 alpha followed by BC1 colour
+	void EncodeBC3(const uint8_t texels[64], uint8_t block[16]);
+	// 8 bytes from the given channel
+	void EncodeBC4(const uint8_t texels[64], int channel, uint8_t block[8]);
+	// 16 bytes, red then green as two BC4 blocks
+	void EncodeBC5(const uint8_t texels[64], uint8_t block[16]);
+	// 16 bytes using mode 6 only: one RGBA line with 4 bit indices
+	void EncodeBC7(const uint8_t texels[64], uint8_t block[16]);
+
+	// Compresses a whole RGBA8 image, edge blocks repeat the last row and column
+	std::vector<uint8_t> EncodeImage(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height);
+}
+#endif
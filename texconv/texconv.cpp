@@ -0,0 +1,192 @@
+// texconv: transcodes PNG/JPG/TGA/BMP images into block compressed DDS files with a full mip chain.
+// The .dds lands next to its source and the engine loads it in place of the image, skipping the decode.
+//
+// usage: texconv [-f auto|bc1|bc3|bc4|bc5|bc7] [--force] <image or directory>...
+//   auto picks BC4 for one channel, BC5 for two, BC1 for opaque colour and BC3 when there is alpha.
+//   Files whose .dds is newer than the source are skipped unless --force is given.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "stb_image.h"
+#include "DDSFile.h"
+#include "BlockCompress.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	struct Options
+	{
+		bool automatic = true;
+		BlockFormat format = BlockFormat::BC1;
+		bool force = false;
+	};
+
+	bool isImage(const fs::path& path)
+	{
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+	}
+
+	bool parseFormat(const std::string& name, Options& options)
+	{
+		static const struct { const char* name; BlockFormat format; } formats[] =
+		{
+			{ "bc1", BlockFormat::BC1 }, { "bc3", BlockFormat::BC3 }, { "bc4", BlockFormat::BC4 },
+			{ "bc5", BlockFormat::BC5 }, { "bc7", BlockFormat::BC7 }
+		};
+		if (name == "auto")
+		{
+			options.automatic = true;
+			return true;
+		}
+		for (auto& entry : formats)
+		{
+			if (name == entry.name)
+			{
+				options.automatic = false;
+				options.format = entry.format;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	BlockFormat pickFormat(int channels, const std::vector<uint8_t>& rgba)
+	{
+		if (channels == 1)
+			return BlockFormat::BC4;
+		if (channels == 2)
+			return BlockFormat::BC5;
+		if (channels == 4)
+			for (size_t i = 3; i < rgba.size(); i += 4)
+				if (rgba[i] != 255)
+					return BlockFormat::BC3;
+		return BlockFormat::BC1;
+	}
+
+	// Halves an RGBA8 image with a box filter, odd edges reuse their last row or column
+	std::vector<uint8_t> downsample(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, uint32_t& newWidth, uint32_t& newHeight)
+	{
+		newWidth = std::max(1u, width / 2);
+		newHeight = std::max(1u, height / 2);
+		std::vector<uint8_t> result((size_t)newWidth * newHeight * 4);
+		for (uint32_t y = 0; y < newHeight; ++y)
+		{
+			uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			for (uint32_t x = 0; x < newWidth; ++x)
+			{
+				uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; ++c)
+				{
+					int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+						rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+					result[((size_t)y * newWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+				}
+			}
+		}
+		return result;
+	}
+
+	bool transcode(const fs::path& source, const Options& options)
+	{
+		fs::path target = fs::path(source).replace_extension(".dds");
+		std::error_code error;
+		if (!options.force && fs::exists(target, error) && fs::last_write_time(target, error) >= fs::last_write_time(source, error))
+		{
+			std::cout << source.string() << ": up to date" << std::endl;
+			return true;
+		}
+
+		// stored bottom-up like every texture the engine uploads
+		int width, height, channels;
+		stbi_set_flip_vertically_on_load(true);
+		unsigned char* pixels = stbi_load(source.string().c_str(), &width, &height, &channels, 4);
+		if (!pixels)
+		{
+			std::cout << "ERROR::TEXCONV::CANNOT_LOAD " << source.string() << ": " << stbi_failure_reason() << std::endl;
+			return false;
+		}
+		std::vector<uint8_t> level(pixels, pixels + (size_t)width * height * 4);
+		stbi_image_free(pixels);
+
+		auto start = std::chrono::steady_clock::now();
+		DDSImage image;
+		image.format = options.automatic ? pickFormat(channels, level) : options.format;
+		// stb expands grey+alpha to (L,L,L,A), the engine uploads those images as GL_RG (L,A)
+		// and BC5 keeps the first two channels, so move alpha into the second one
+		if (channels == 2 && image.format == BlockFormat::BC5)
+			for (size_t i = 0; i < level.size(); i += 4)
+				level[i + 1] = level[i + 3];
+		image.width = (uint32_t)width;
+		image.height = (uint32_t)height;
+
+		uint32_t levelWidth = image.width, levelHeight = image.height;
+		for (;;)
+		{
+			image.AddLevel(levelWidth, levelHeight, BlockCompress::EncodeImage(image.format, level.data(), levelWidth, levelHeight));
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+			level = downsample(level, levelWidth, levelHeight, levelWidth, levelHeight);
+		}
+
+		if (!SaveDDS(target.string(), image))
+			return false;
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		size_t uncompressed = (size_t)width * height * 4 * 4 / 3;
+		std::cout << source.string() << " -> " << target.filename().string() << ": " << DDSImage::Name(image.format) << " "
+			<< width << "x" << height << ", " << image.levels.size() << " levels, " << uncompressed / 1024 << " KB -> "
+			<< image.data.size() / 1024 << " KB in " << ms << " ms" << std::endl;
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	std::vector<fs::path> inputs;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (argument == "-f" && i + 1 < argc)
+		{
+			if (!parseFormat(argv[++i], options))
+			{
+				std::cout << "ERROR::TEXCONV::UNKNOWN_FORMAT " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (argument == "--force")
+			options.force = true;
+		else
+			inputs.push_back(argument);
+	}
+
+	if (inputs.empty())
+	{
+		std::cout << "usage: texconv [-f auto|bc1|bc3|bc4|bc5|bc7] [--force] <image or directory>..." << std::endl;
+		return 1;
+	}
+
+	bool ok = true;
+	for (const fs::path& input : inputs)
+	{
+		if (fs::is_directory(input))
+		{
+			for (const fs::directory_entry& entry : fs::recursive_directory_iterator(input))
+				if (entry.is_regular_file() && isImage(entry.path()))
+					ok &= transcode(entry.path(), options);
+		}
+		else
+			ok &= transcode(input, options);
+	}
+	return ok ? 0 : 1;
+}